@@ -3,13 +3,383 @@ Fft.cpp
 Evan Newman
 */
 
-#include <fftw3.h>
-#include <eigen3/Eigen/Core>
-
 #include "Fft.h"
 
-namespace OptimizationTests::Fft {
+// System
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Local
+#include "FftKernels.h"
+
+namespace OptimizationTests {
+    namespace Fft {
+
+        namespace {
+
+            constexpr double pi = 3.14159265358979323846;
+
+            // the cache is dropped when it grows past this many plans, so a stream of distinct sizes can't grow it forever
+            constexpr size_t plan_cache_max = 256;
+
+            /** x*y without the checks for infinite and nan parts std::complex's operator* does,
+             *  which would make every multiply by the chirp a library call
+             */
+            inline Complex Multiply(Complex x, Complex y) {
+                return {x.real()*y.real() - x.imag()*y.imag(), x.real()*y.imag() + x.imag()*y.real()};
+            }
+
+            // only the factors the stages have dedicated butterflies for, 2^a 3^b 5^c
+            bool IsSmooth(size_t n) {
+                for (size_t factor : {2, 3, 5}) {
+                    while (n % factor == 0) n /= factor;
+                }
+                return n == 1;
+            }
+
+            /** the plans of fft(), rfft() and irfft(), keyed by the size and direction
+             */
+            template <class P>
+            class PlanCache {
+            public:
+                static PlanCache& Instance() {
+                    static PlanCache cache;
+                    return cache;
+                }
+
+                std::shared_ptr<const P> Get(size_t n, Direction direction) {
+                    const Key key(n, direction);
+
+                    std::lock_guard<std::mutex> lock(_mutex);
+
+                    auto entry = _plans.find(key);
+                    if (entry != _plans.end()) return entry->second;
+
+                    if (_plans.size() >= plan_cache_max) _plans.clear();
+
+                    auto plan = std::make_shared<const P>(n, direction);
+                    _plans.emplace(key, plan);
+                    return plan;
+                }
+
+            private:
+                using Key = std::pair<size_t, Direction>;
+
+                std::map<Key, std::shared_ptr<const P>> _plans;
+                std::mutex _mutex;
+            };
+
+        } // namespace
+
+        Plan::Plan(size_t n, Direction direction) : _n(n), _direction(direction) {
+            if (n == 0) throw std::invalid_argument("fft size can't be 0");
+            if (n > (size_t(1) << 31)) throw std::invalid_argument("fft size " + std::to_string(n) + " is too large");
+
+            size_t rest = n;
+            std::vector<int> odd;
+            for (int radix : {3, 5, 7, 11, 13}) {
+                while (rest % radix == 0) {
+                    odd.push_back(radix);
+                    rest /= radix;
+                }
+            }
+
+            int twos = 0;
+            while (rest % 2 == 0) {
+                twos++;
+                rest /= 2;
+            }
+
+            if (rest != 1) {
+                PlanBluestein();
+                return;
+            }
+
+            /* as many radix 8 stages as fit with a 4 or 2 for what's left. the first stage has no
+             * twiddles and runs one point per lane, so the small radices go first and the 8s,
+             * which do the most work per twiddle, last
+             */
+            std::vector<int> radices;
+            if (twos % 3 == 1) radices.push_back(2);
+            if (twos % 3 == 2) radices.push_back(4);
+            radices.insert(radices.end(), odd.begin(), odd.end());
+            for (int i = 0; i < twos/3; i++) radices.push_back(8);
+
+            PlanStages(radices);
+        }
+
+        void Plan::PlanStages(const std::vector<int>& radices) {
+            const double sign = _direction == Direction::Forward ? -1.0 : 1.0;
+
+            // every twiddle and root from its own exact angle, a recurrence would pile up rounding error along the table
+            size_t m = 1;
+            for (int radix : radices) {
+                const size_t length = m*radix;
+                _stages.push_back({radix, m, _twiddles.size(), _roots.size()});
+
+                for (int q = 1; q < radix; q++) {
+                    for (size_t j = 0; j < m; j++) {
+                        const double angle = sign*2.0*pi*static_cast<double>(q*j % length)/static_cast<double>(length);
+                        _twiddles.emplace_back(std::cos(angle), std::sin(angle));
+                    }
+                }
+
+                // the root of every output and input of the butterfly, so the generic one never reduces k*q mod radix
+                for (int k = 0; k < radix; k++) {
+                    for (int q = 0; q < radix; q++) {
+                        const double angle = sign*2.0*pi*static_cast<double>(k*q % radix)/static_cast<double>(radix);
+                        _roots.emplace_back(std::cos(angle), std::sin(angle));
+                    }
+                }
+
+                m = length;
+            }
+
+            /* the last stage combines the transforms of the points congruent to q mod its radix,
+             * each stored contiguously, and so on down to the first stage
+             */
+            _permutation.resize(_n);
+            struct Builder {
+                const std::vector<int>& radices;
+                std::vector<uint32_t>& permutation;
+
+                void Build(size_t first, size_t stride, size_t position, size_t length, size_t stage) {
+                    if (length == 1) {
+                        permutation[position] = static_cast<uint32_t>(first);
+                        return;
+                    }
+
+                    const size_t radix = radices[stage - 1];
+                    const size_t sub_length = length/radix;
+                    for (size_t q = 0; q < radix; q++) Build(first + q*stride, stride*radix, position + q*sub_length, sub_length, stage - 1);
+                }
+            };
+            Builder{radices, _permutation}.Build(0, 1, 0, _n, radices.size());
+
+            std::vector<bool> visited(_n, false);
+            for (size_t start = 0; start < _n; start++) {
+                if (visited[start]) continue;
+
+                size_t p = start;
+                while (!visited[p]) {
+                    visited[p] = true;
+                    p = _permutation[p];
+                }
+
+                if (_permutation[start] != start) _cycles.push_back(static_cast<uint32_t>(start));
+            }
+        }
+
+        void Plan::PlanBluestein() {
+            const double sign = _direction == Direction::Forward ? -1.0 : 1.0;
+
+            // j*k = (j^2 + k^2 - (k - j)^2)/2, so the transform is a convolution with the chirp between two multiplies by it
+            _chirp.resize(_n);
+            for (size_t j = 0; j < _n; j++) {
+                const uint64_t square = static_cast<uint64_t>(j)*j % (2*static_cast<uint64_t>(_n));
+                const double angle = sign*pi*static_cast<double>(square)/static_cast<double>(_n);
+                _chirp[j] = {std::cos(angle), std::sin(angle)};
+            }
+
+            // the convolution is circular, so it needs at least 2n - 1 points to not wrap around
+            size_t length = 2*_n - 1;
+            while (!IsSmooth(length)) length++;
+
+            _inner_forward = std::make_shared<const Plan>(length, Direction::Forward);
+            _inner_inverse = std::make_shared<const Plan>(length, Direction::Inverse);
+
+            // the chirp's conjugate at the offsets -(n - 1)..(n - 1), with the inverse transform's 1/length folded in
+            _chirp_spectrum.assign(length, Complex(0.0, 0.0));
+            const double scale = 1.0/static_cast<double>(length);
+            for (size_t j = 0; j < _n; j++) {
+                _chirp_spectrum[j] = std::conj(_chirp[j])*scale;
+                if (j > 0) _chirp_spectrum[length - j] = _chirp_spectrum[j];
+            }
+
+            _inner_forward->Execute(_chirp_spectrum.data(), _chirp_spectrum.data());
+        }
+
+        void Plan::Execute(const Complex* in, Complex* out) const {
+            if (_inner_forward) ExecuteBluestein(in, out);
+            else ExecuteStages(in, out);
+        }
+
+        void Plan::ExecuteStages(const Complex* in, Complex* out) const {
+            if (in != out) {
+                for (size_t p = 0; p < _n; p++) out[p] = in[_permutation[p]];
+            } else {
+                for (uint32_t start : _cycles) {
+                    const Complex first = out[start];
+
+                    size_t p = start;
+                    while (_permutation[p] != start) {
+                        out[p] = out[_permutation[p]];
+                        p = _permutation[p];
+                    }
+                    out[p] = first;
+                }
+            }
+
+            const KernelTable& kernels = Kernels();
+            const bool inverse = _direction == Direction::Inverse;
+
+            double* data = reinterpret_cast<double*>(out);
+            for (const Stage& stage : _stages) {
+                kernels.stage(data, _n, stage.m, stage.radix,
+                              reinterpret_cast<const double*>(_twiddles.data() + stage.twiddles),
+                              reinterpret_cast<const double*>(_roots.data() + stage.roots),
+                              inverse);
+            }
+        }
+
+        void Plan::ExecuteBluestein(const Complex* in, Complex* out) const {
+            const size_t length = _inner_forward->Size();
+
+            /* the inner plans never use Bluestein's algorithm themselves, so they don't touch these.
+             * the inner transforms go back and forth between the two so neither runs in place, the
+             * digit reversal of an out of place transform is a gather instead of following cycles
+             */
+            static thread_local std::vector<Complex> scratch;
+            static thread_local std::vector<Complex> spectrum;
+            if (scratch.size() < length) {
+                scratch.resize(length);
+                spectrum.resize(length);
+            }
+
+            for (size_t j = 0; j < _n; j++) scratch[j] = Multiply(in[j], _chirp[j]);
+            for (size_t j = _n; j < length; j++) scratch[j] = {0.0, 0.0};
+
+            _inner_forward->Execute(scratch.data(), spectrum.data());
+            Kernels().multiply(reinterpret_cast<double*>(spectrum.data()), reinterpret_cast<const double*>(_chirp_spectrum.data()), length);
+            _inner_inverse->Execute(spectrum.data(), scratch.data());
+
+            for (size_t k = 0; k < _n; k++) out[k] = Multiply(scratch[k], _chirp[k]);
+        }
+
+        RealPlan::RealPlan(size_t n, Direction direction)
+            : _n(n), _direction(direction), _complex(n % 2 == 0 ? n/2 : n, direction) {
+
+            if (n % 2 != 0) return;
+
+            const size_t quarter = n/4;
+            _twiddles.resize(quarter + 1);
+            for (size_t k = 0; k <= quarter; k++) {
+                const double angle = -2.0*pi*static_cast<double>(k)/static_cast<double>(n);
+                _twiddles[k] = {std::cos(angle), std::sin(angle)};
+            }
+        }
+
+        void RealPlan::Execute(const double* in, Complex* out) const {
+            if (_direction != Direction::Forward) throw std::logic_error("real fft plan is an inverse, it transforms complex bins to reals");
+
+            if (_n % 2 != 0) {
+                // out of place, an in place transform follows the digit reversal's cycles
+                static thread_local std::vector<Complex> scratch;
+                static thread_local std::vector<Complex> spectrum;
+                scratch.resize(_n);
+                spectrum.resize(_n);
+
+                for (size_t j = 0; j < _n; j++) scratch[j] = {in[j], 0.0};
+                _complex.Execute(scratch.data(), spectrum.data());
+                for (size_t k = 0; k <= _n/2; k++) out[k] = spectrum[k];
+                return;
+            }
+
+            // z[j] = in[2j] + i*in[2j + 1] is just in, read as complex numbers
+            const size_t half = _n/2;
+            _complex.Execute(reinterpret_cast<const Complex*>(in), out);
+
+            /* with z's spectrum Z, the spectra of the even and odd samples are
+             * E[k] = (Z[k] + conj(Z[half - k]))/2 and O[k] = (Z[k] - conj(Z[half - k]))/2i and
+             * out[k] = E[k] + exp(-2 pi i k/n)*O[k]. the pair k, half - k is computed together from
+             * the same two bins, so it can be done in place
+             */
+            const Complex z0 = out[0];
+            out[0] = {z0.real() + z0.imag(), 0.0};
+            out[half] = {z0.real() - z0.imag(), 0.0};
+
+            for (size_t k = 1; 2*k <= half; k++) {
+                const Complex a = out[k];
+                const Complex b = std::conj(out[half - k]);
+
+                const Complex even = 0.5*(a + b);
+                const Complex diff = 0.5*(a - b);
+                const Complex odd = {diff.imag(), -diff.real()}; // diff/i
+                const Complex rotated = Multiply(_twiddles[k], odd);
+
+                out[k] = even + rotated;
+                out[half - k] = std::conj(even - rotated);
+            }
+        }
+
+        void RealPlan::Execute(const Complex* in, double* out) const {
+            if (_direction != Direction::Inverse) throw std::logic_error("real fft plan is forward, it transforms reals to complex bins");
+
+            if (_n % 2 != 0) {
+                static thread_local std::vector<Complex> scratch;
+                static thread_local std::vector<Complex> signal;
+                scratch.resize(_n);
+                signal.resize(_n);
+
+                // the upper bins are the conjugates of the lower ones
+                scratch[0] = {in[0].real(), 0.0};
+                for (size_t k = 1; k <= _n/2; k++) {
+                    scratch[k] = in[k];
+                    scratch[_n - k] = std::conj(in[k]);
+                }
+
+                _complex.Execute(scratch.data(), signal.data());
+                for (size_t j = 0; j < _n; j++) out[j] = signal[j].real();
+                return;
+            }
+
+            /* the forward separation run backwards, 2*E[k] = in[k] + conj(in[half - k]) and
+             * 2*O[k] = exp(2 pi i k/n)*(in[k] - conj(in[half - k])), and z's spectrum is
+             * 2*(E[k] + i*O[k]). the factor 2 makes the inverse of half the length come out at the
+             * scale of the unnormalized inverse of n points
+             */
+            const size_t half = _n/2;
+            Complex* z = reinterpret_cast<Complex*>(out);
+
+            const double first = in[0].real();
+            const double last = in[half].real();
+
+            for (size_t k = 1; 2*k <= half; k++) {
+                const Complex a = in[k];
+                const Complex b = std::conj(in[half - k]);
+
+                const Complex even = a + b;
+                const Complex odd = Multiply(std::conj(_twiddles[k]), a - b);
+                const Complex rotated = {-odd.imag(), odd.real()}; // i*odd
+
+                z[k] = even + rotated;
+                z[half - k] = std::conj(even) + Complex(odd.imag(), odd.real()); // conj(even) + i*conj(odd)
+            }
+
+            z[0] = {first + last, first - last};
+
+            _complex.Execute(z, z);
+        }
+
+        void fft(const Complex* in, Complex* out, size_t n, Direction direction) {
+            PlanCache<Plan>::Instance().Get(n, direction)->Execute(in, out);
+        }
+
+        void rfft(const double* in, Complex* out, size_t n) {
+            PlanCache<RealPlan>::Instance().Get(n, Direction::Forward)->Execute(in, out);
+        }
 
-    void fft(double* in, double* out) {}
+        void irfft(const Complex* in, double* out, size_t n) {
+            PlanCache<RealPlan>::Instance().Get(n, Direction::Inverse)->Execute(in, out);
+        }
 
-}
\ No newline at end of file
+    } // namespace Fft
+} // namespace OptimizationTests
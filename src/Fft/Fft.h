@@ -3,9 +3,153 @@ Fft.h
 Evan Newman
 */
 
-#include <eigen3/Eigen/Core>
+#ifndef FFT_H
+#define FFT_H
 
-namespace OptimizationTests::Fft {
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
 
-    void fft(double* in, double* out);
-}
\ No newline at end of file
+namespace OptimizationTests {
+    namespace Fft {
+
+        using Complex = std::complex<double>;
+
+        /** the sign of the exponent, like FFTW_FORWARD and FFTW_BACKWARD
+         */
+        enum class Direction {
+            Forward, // out[k] = sum_j in[j]*exp(-2 pi i j k/n)
+            Inverse  // out[k] = sum_j in[j]*exp(+2 pi i j k/n), not divided by n
+        };
+
+        /** everything a transform of one size and direction needs, computed once so executing it
+         *  does no trigonometry and no allocation. a plan is never changed after it is made, so
+         *  one plan can be executed from any number of threads at once
+         *
+         *  n is split into radix 8, 4, 2, 3, 5 stages with their own butterflies and 7, 11, 13
+         *  stages through a generic one. a length with any larger prime factor is computed as a
+         *  convolution of two transforms of a smooth length (Bluestein's algorithm), so every n
+         *  takes O(n log n)
+         */
+        class Plan {
+        public:
+            /** plans a transform of n points
+             *
+             * \param n the length, any n from 1 to 2^31. throws std::invalid_argument for anything else
+             */
+            explicit Plan(size_t n, Direction direction = Direction::Forward);
+
+            size_t Size() const { return _n; }
+            Direction GetDirection() const { return _direction; }
+
+            /** transforms the n points at in into out, in and out may be the same array
+             */
+            void Execute(const Complex* in, Complex* out) const;
+
+        private:
+            /** one decimation in time stage, radix transforms of length m combined into
+             *  transforms of length m*radix
+             */
+            struct Stage {
+                int radix;
+                size_t m;
+                size_t twiddles; // where this stage's (radix - 1)*m twiddles start in _twiddles
+                size_t roots;    // where this stage's radix x radix table of roots of unity starts in _roots
+            };
+
+            void PlanStages(const std::vector<int>& radices);
+            void PlanBluestein();
+
+            void ExecuteStages(const Complex* in, Complex* out) const;
+            void ExecuteBluestein(const Complex* in, Complex* out) const;
+
+            size_t _n;
+            Direction _direction;
+
+            std::vector<Stage> _stages;
+
+            /* the twiddles of every stage back to back, a stage with radix r over m points
+             * reads exp(-+2 pi i q j/(m*r)) at [(q - 1)*m + j] so a column reads them in order
+             */
+            std::vector<Complex> _twiddles;
+            std::vector<Complex> _roots;
+
+            // the digit reversal the stages need, out[p] = in[_permutation[p]]
+            std::vector<uint32_t> _permutation;
+
+            // the first point of every cycle of _permutation, for applying it in place
+            std::vector<uint32_t> _cycles;
+
+            /* Bluestein's algorithm, the chirp exp(-+pi i j^2/n), the spectrum of the chirp's
+             * conjugate padded to the smooth length divided by that length, and transforms of it
+             */
+            std::vector<Complex> _chirp;
+            std::vector<Complex> _chirp_spectrum;
+            std::shared_ptr<const Plan> _inner_forward;
+            std::shared_ptr<const Plan> _inner_inverse;
+        };
+
+        /** a transform of n real points, which only computes the n/2 + 1 bins up to the nyquist
+         *  frequency since the rest are their conjugates. an even n is packed into n/2 complex
+         *  points, even samples in the real parts and odd ones in the imaginary parts, and the
+         *  spectrum of the two halves is separated out after a complex transform of half the
+         *  length, so it takes half the work and memory of a complex transform of n points. an
+         *  odd n goes through a complex transform of n points
+         */
+        class RealPlan {
+        public:
+            /** plans a transform of n points, forward from n reals to n/2 + 1 complex bins or
+             *  inverse from n/2 + 1 bins of a hermitian spectrum back to n reals
+             *
+             * \param n the length, any n from 1 to 2^31. throws std::invalid_argument for anything else
+             */
+            explicit RealPlan(size_t n, Direction direction = Direction::Forward);
+
+            size_t Size() const { return _n; }
+            Direction GetDirection() const { return _direction; }
+
+            /** the forward transform of the n reals at in into the n/2 + 1 bins at out. for an
+             *  even n in and out may be the same array if it has room for the bins. throws
+             *  std::logic_error on an inverse plan
+             */
+            void Execute(const double* in, Complex* out) const;
+
+            /** the inverse transform of the n/2 + 1 bins at in into the n reals at out, not divided
+             *  by n. the imaginary parts of the first bin and, for an even n, the last are ignored.
+             *  for an even n in and out may be the same array. throws std::logic_error on a
+             *  forward plan
+             */
+            void Execute(const Complex* in, double* out) const;
+
+        private:
+            size_t _n;
+            Direction _direction;
+
+            // n/2 points for an even n, n for an odd n
+            Plan _complex;
+
+            // exp(-2 pi i k/n) for k <= n/4, separating the spectra of the even and odd samples
+            std::vector<Complex> _twiddles;
+        };
+
+        /** transforms the n points at in into out through a plan cached for n and the direction,
+         *  the first call for a size pays for planning. in and out may be the same array
+         */
+        void fft(const Complex* in, Complex* out, size_t n, Direction direction = Direction::Forward);
+
+        /** the forward transform of the n reals at in into the n/2 + 1 bins at out through a
+         *  cached plan
+         */
+        void rfft(const double* in, Complex* out, size_t n);
+
+        /** the inverse transform of the n/2 + 1 bins at in into n reals at out through a cached
+         *  plan, not divided by n
+         */
+        void irfft(const Complex* in, double* out, size_t n);
+
+    } // namespace Fft
+} // namespace OptimizationTests
+
+#endif // FFT_H
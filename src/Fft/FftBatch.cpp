@@ -0,0 +1,128 @@
+/*
+FftBatch.cpp
+Evan Newman
+*/
+
+#include "FftBatch.h"
+
+// System
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+// Local
+#include "Fft.h"
+
+#include "Util/ThreadPool.h"
+#include "Util/Trace.h"
+
+namespace OptimizationTests {
+    namespace Fft {
+
+        namespace {
+
+            // strided arrays are gathered this many at a time, 8 complex doubles are two cache lines of a row of adjacent arrays
+            constexpr size_t block_arrays = 8;
+
+            // blocks are handed out in this many tasks per thread, enough to even out the load without a task per block
+            constexpr size_t tasks_per_thread = 4;
+
+            /** runs plan on groups*howmany arrays, point j of array i of group g is at
+             *  g*group_distance + i*distance + j*stride in both in and out
+             */
+            void Pass(const Plan& plan, const Complex* in, Complex* out,
+                      size_t groups, size_t group_distance,
+                      size_t howmany, size_t stride, size_t distance,
+                      Util::ThreadPool& pool) {
+
+                const size_t n = plan.Size();
+                const size_t blocks_per_group = (howmany + block_arrays - 1)/block_arrays;
+                const size_t blocks = groups*blocks_per_group;
+                if (blocks == 0) return;
+
+                const size_t tasks = std::min(blocks, static_cast<size_t>(pool.NumThreads())*tasks_per_thread);
+
+                pool.ParallelFor(tasks, [&](size_t task) {
+                    TRACE_ZONE("fft blocks");
+
+                    static thread_local std::vector<Complex> scratch;
+                    if (stride != 1 && scratch.size() < block_arrays*n) scratch.resize(block_arrays*n);
+
+                    const size_t first_block = blocks*task/tasks;
+                    const size_t last_block = blocks*(task + 1)/tasks;
+
+                    for (size_t block = first_block; block < last_block; block++) {
+                        const size_t first_array = block%blocks_per_group*block_arrays;
+                        const size_t count = std::min(block_arrays, howmany - first_array);
+                        const size_t offset = block/blocks_per_group*group_distance + first_array*distance;
+
+                        if (stride == 1) {
+                            for (size_t b = 0; b < count; b++) plan.Execute(in + offset + b*distance, out + offset + b*distance);
+                            continue;
+                        }
+
+                        // transpose the block into count contiguous arrays a row of points at a time, and back after
+                        for (size_t j = 0; j < n; j++) {
+                            const Complex* row = in + offset + j*stride;
+                            for (size_t b = 0; b < count; b++) scratch[b*n + j] = row[b*distance];
+                        }
+
+                        for (size_t b = 0; b < count; b++) plan.Execute(scratch.data() + b*n, scratch.data() + b*n);
+
+                        for (size_t j = 0; j < n; j++) {
+                            Complex* row = out + offset + j*stride;
+                            for (size_t b = 0; b < count; b++) row[b*distance] = scratch[b*n + j];
+                        }
+                    }
+                });
+            }
+
+        } // namespace
+
+        void ExecuteBatch(const Plan& plan, const Complex* in, Complex* out,
+                          size_t howmany, size_t stride, size_t distance,
+                          Util::ThreadPool& pool) {
+            Pass(plan, in, out, 1, 0, howmany, stride, distance, pool);
+        }
+
+        MultiDimPlan::MultiDimPlan(const std::vector<size_t>& dims, Direction direction)
+            : _dims(dims), _size(1), _direction(direction) {
+
+            if (dims.empty()) throw std::invalid_argument("fft needs at least one dimension");
+
+            for (size_t n : dims) {
+                _plans.emplace_back(n, direction);
+                _size *= n;
+            }
+        }
+
+        void MultiDimPlan::Execute(const Complex* in, Complex* out, Util::ThreadPool& pool) const {
+            TRACE_ZONE("MultiDimPlan");
+
+            // the contiguous rows first, reading in, then every other dimension in place in out
+            const Complex* source = in;
+
+            size_t inner = 1; // the points in one step along the current dimension
+            for (size_t d = _dims.size(); d-- > 0;) {
+                const size_t n = _dims[d];
+                const size_t outer = _size/(n*inner);
+
+                if (inner == 1) Pass(_plans[d], source, out, 1, 0, outer, 1, n, pool);
+                else Pass(_plans[d], source, out, outer, n*inner, inner, inner, 1, pool);
+
+                source = out;
+                inner *= n;
+            }
+        }
+
+        void fft2d(const Complex* in, Complex* out, size_t rows, size_t cols, Direction direction) {
+            MultiDimPlan({rows, cols}, direction).Execute(in, out, Util::ThreadPool::Default());
+        }
+
+        void fft3d(const Complex* in, Complex* out, size_t n0, size_t n1, size_t n2, Direction direction) {
+            MultiDimPlan({n0, n1, n2}, direction).Execute(in, out, Util::ThreadPool::Default());
+        }
+
+    } // namespace Fft
+} // namespace OptimizationTests
@@ -0,0 +1,74 @@
+/*
+FftBatch.h batches of transforms and multidimensional transforms over a thread pool
+Evan Newman
+*/
+
+#ifndef FFT_BATCH_H
+#define FFT_BATCH_H
+
+#include <cstddef>
+#include <vector>
+
+#include "Fft.h"
+
+#include "Util/ThreadPool.h"
+
+namespace OptimizationTests {
+    namespace Fft {
+
+        /** runs plan on howmany arrays, point j of array i is at in[i*distance + j*stride] and
+         *  goes to out[i*distance + j*stride]. contiguous arrays are transformed where they are,
+         *  strided ones are gathered a block at a time into contiguous scratch with a blocked
+         *  transpose, so adjacent arrays (distance 1) share the cache lines they're read through.
+         *  the blocks are spread over pool. in and out may be the same array
+         *
+         * \param plan the transform of each array
+         * \param howmany the number of arrays
+         * \param stride the distance between two points of an array
+         * \param distance the distance between the first points of two arrays
+         */
+        void ExecuteBatch(const Plan& plan, const Complex* in, Complex* out,
+                          size_t howmany, size_t stride, size_t distance,
+                          Util::ThreadPool& pool);
+
+        /** a transform over every dimension of a row major array, the last dimension contiguous.
+         *  it is one pass of one dimensional transforms per dimension, the last one over
+         *  contiguous rows and the others over columns, which ExecuteBatch gathers with blocked
+         *  transposes instead of striding through memory a point at a time
+         */
+        class MultiDimPlan {
+        public:
+            /** \param dims the size of every dimension, outermost first. throws
+             *              std::invalid_argument if there are none or any is 0
+             */
+            explicit MultiDimPlan(const std::vector<size_t>& dims, Direction direction = Direction::Forward);
+
+            const std::vector<size_t>& Dims() const { return _dims; }
+            size_t Size() const { return _size; }
+            Direction GetDirection() const { return _direction; }
+
+            /** transforms the Size() points at in into out, in and out may be the same array
+             */
+            void Execute(const Complex* in, Complex* out, Util::ThreadPool& pool) const;
+
+        private:
+            std::vector<size_t> _dims;
+            size_t _size;
+            Direction _direction;
+
+            std::vector<Plan> _plans; // one per dimension
+        };
+
+        /** the transform of a rows x cols row major array on the shared pool, planned on every call
+         */
+        void fft2d(const Complex* in, Complex* out, size_t rows, size_t cols, Direction direction = Direction::Forward);
+
+        /** the transform of a n0 x n1 x n2 row major array on the shared pool, n2 contiguous,
+         *  planned on every call
+         */
+        void fft3d(const Complex* in, Complex* out, size_t n0, size_t n1, size_t n2, Direction direction = Direction::Forward);
+
+    } // namespace Fft
+} // namespace OptimizationTests
+
+#endif // FFT_BATCH_H
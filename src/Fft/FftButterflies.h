@@ -0,0 +1,442 @@
+/*
+FftButterflies.h the fft stages and butterflies, compiled once per instruction set
+Evan Newman
+*/
+
+/* only included by the FftKernels*.cpp files, which define FFT_ISA to the namespace of their
+ * instruction set first. like MatrixMultiplyGemmKernel.h nothing in here may call an inline
+ * function from another header, std::complex included, since the linker keeps one copy of it
+ * for the whole program and it could be the one compiled for avx2. complex numbers are
+ * handled as interleaved doubles instead
+ */
+
+#ifndef FFT_BUTTERFLIES_H
+#define FFT_BUTTERFLIES_H
+
+#ifndef FFT_ISA
+#error "define FFT_ISA before including FftButterflies.h"
+#endif
+
+#include <cstddef>
+
+#if defined(__SSE3__)
+#include <immintrin.h>
+#endif
+
+#include "FftKernels.h"
+
+namespace OptimizationTests {
+    namespace Fft {
+        namespace FFT_ISA {
+
+            namespace {
+
+                /* a number of complex numbers handled together, lanes of them at consecutive
+                 * addresses. every butterfly is written once against these
+                 */
+                struct Scalar {
+                    struct Type {
+                        double re;
+                        double im;
+                    };
+
+                    static constexpr size_t lanes = 1;
+
+                    static Type Load(const double* p) { return {p[0], p[1]}; }
+                    static void Store(double* p, Type x) { p[0] = x.re; p[1] = x.im; }
+                    static Type LoadSplit(const double* p, size_t) { return Load(p); }
+                    static void StoreSplit(double* p, size_t, Type x) { Store(p, x); }
+                    static Type Set(double re, double im) { return {re, im}; }
+                    static Type Add(Type x, Type y) { return {x.re + y.re, x.im + y.im}; }
+                    static Type Sub(Type x, Type y) { return {x.re - y.re, x.im - y.im}; }
+                    static Type Scale(Type x, double s) { return {x.re*s, x.im*s}; }
+                    static Type MulAdd(Type acc, Type x, double s) { return {acc.re + x.re*s, acc.im + x.im*s}; }
+                    static Type Mul(Type x, Type y) { return {x.re*y.re - x.im*y.im, x.re*y.im + x.im*y.re}; }
+                    static Type MulI(Type x) { return {-x.im, x.re}; }
+                    static Type MulNegI(Type x) { return {x.im, -x.re}; }
+                };
+
+#if defined(__AVX512F__)
+                // four complex numbers, (re0, im0, re1, im1, re2, im2, re3, im3)
+                struct Vector {
+                    using Type = __m512d;
+
+                    static constexpr size_t lanes = 4;
+
+                    static Type Load(const double* p) { return _mm512_loadu_pd(p); }
+                    static void Store(double* p, Type x) { _mm512_storeu_pd(p, x); }
+
+                    // the lanes at p, p + offset, p + 2*offset and p + 3*offset doubles
+                    static Type LoadSplit(const double* p, size_t offset) {
+                        const __m256d low = _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_loadu_pd(p)), _mm_loadu_pd(p + offset), 1);
+                        const __m256d high = _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_loadu_pd(p + 2*offset)), _mm_loadu_pd(p + 3*offset), 1);
+                        return _mm512_insertf64x4(_mm512_castpd256_pd512(low), high, 1);
+                    }
+
+                    static void StoreSplit(double* p, size_t offset, Type x) {
+                        const __m256d low = _mm512_castpd512_pd256(x);
+                        const __m256d high = _mm512_extractf64x4_pd(x, 1);
+                        _mm_storeu_pd(p, _mm256_castpd256_pd128(low));
+                        _mm_storeu_pd(p + offset, _mm256_extractf128_pd(low, 1));
+                        _mm_storeu_pd(p + 2*offset, _mm256_castpd256_pd128(high));
+                        _mm_storeu_pd(p + 3*offset, _mm256_extractf128_pd(high, 1));
+                    }
+                    static Type Set(double re, double im) { return _mm512_setr_pd(re, im, re, im, re, im, re, im); }
+                    static Type Add(Type x, Type y) { return _mm512_add_pd(x, y); }
+                    static Type Sub(Type x, Type y) { return _mm512_sub_pd(x, y); }
+                    static Type Scale(Type x, double s) { return _mm512_mul_pd(x, _mm512_set1_pd(s)); }
+                    static Type MulAdd(Type acc, Type x, double s) { return _mm512_fmadd_pd(x, _mm512_set1_pd(s), acc); }
+
+                    // as Vector::Mul of avx2, on four complex numbers
+                    static Type Mul(Type x, Type y) {
+                        const Type y_re = _mm512_movedup_pd(y);
+                        const Type y_im = _mm512_permute_pd(y, 0xff);
+                        const Type x_swapped = _mm512_permute_pd(x, 0x55);
+                        return _mm512_fmaddsub_pd(x, y_re, _mm512_mul_pd(x_swapped, y_im));
+                    }
+
+                    // swap the parts and negate the real or imaginary lanes, avx512f has no xor of doubles
+                    static Type MulI(Type x) {
+                        const Type swapped = _mm512_permute_pd(x, 0x55);
+                        return _mm512_mask_sub_pd(swapped, 0x55, _mm512_setzero_pd(), swapped);
+                    }
+                    static Type MulNegI(Type x) {
+                        const Type swapped = _mm512_permute_pd(x, 0x55);
+                        return _mm512_mask_sub_pd(swapped, 0xaa, _mm512_setzero_pd(), swapped);
+                    }
+                };
+#elif defined(__AVX2__) && defined(__FMA__)
+                // two complex numbers, (re0, im0, re1, im1)
+                struct Vector {
+                    using Type = __m256d;
+
+                    static constexpr size_t lanes = 2;
+
+                    static Type Load(const double* p) { return _mm256_loadu_pd(p); }
+                    static void Store(double* p, Type x) { _mm256_storeu_pd(p, x); }
+
+                    // the lanes at p and p + offset doubles
+                    static Type LoadSplit(const double* p, size_t offset) {
+                        return _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_loadu_pd(p)), _mm_loadu_pd(p + offset), 1);
+                    }
+
+                    static void StoreSplit(double* p, size_t offset, Type x) {
+                        _mm_storeu_pd(p, _mm256_castpd256_pd128(x));
+                        _mm_storeu_pd(p + offset, _mm256_extractf128_pd(x, 1));
+                    }
+                    static Type Set(double re, double im) { return _mm256_setr_pd(re, im, re, im); }
+                    static Type Add(Type x, Type y) { return _mm256_add_pd(x, y); }
+                    static Type Sub(Type x, Type y) { return _mm256_sub_pd(x, y); }
+                    static Type Scale(Type x, double s) { return _mm256_mul_pd(x, _mm256_set1_pd(s)); }
+                    static Type MulAdd(Type acc, Type x, double s) { return _mm256_fmadd_pd(x, _mm256_set1_pd(s), acc); }
+
+                    // (xr*yr - xi*yi, xi*yr + xr*yi) with the real and imaginary parts of y broadcast
+                    static Type Mul(Type x, Type y) {
+                        const Type y_re = _mm256_movedup_pd(y);
+                        const Type y_im = _mm256_permute_pd(y, 0xf);
+                        const Type x_swapped = _mm256_permute_pd(x, 0x5);
+                        return _mm256_fmaddsub_pd(x, y_re, _mm256_mul_pd(x_swapped, y_im));
+                    }
+
+                    // swap the parts and flip the sign of one
+                    static Type MulI(Type x) { return _mm256_xor_pd(_mm256_permute_pd(x, 0x5), _mm256_setr_pd(-0.0, 0.0, -0.0, 0.0)); }
+                    static Type MulNegI(Type x) { return _mm256_xor_pd(_mm256_permute_pd(x, 0x5), _mm256_setr_pd(0.0, -0.0, 0.0, -0.0)); }
+                };
+#elif defined(__SSE3__)
+                // one complex number in a register, the multiply uses the addsub of sse3
+                struct Vector {
+                    using Type = __m128d;
+
+                    static constexpr size_t lanes = 1;
+
+                    static Type Load(const double* p) { return _mm_loadu_pd(p); }
+                    static void Store(double* p, Type x) { _mm_storeu_pd(p, x); }
+                    static Type LoadSplit(const double* p, size_t) { return Load(p); }
+                    static void StoreSplit(double* p, size_t, Type x) { Store(p, x); }
+                    static Type Set(double re, double im) { return _mm_setr_pd(re, im); }
+                    static Type Add(Type x, Type y) { return _mm_add_pd(x, y); }
+                    static Type Sub(Type x, Type y) { return _mm_sub_pd(x, y); }
+                    static Type Scale(Type x, double s) { return _mm_mul_pd(x, _mm_set1_pd(s)); }
+                    static Type MulAdd(Type acc, Type x, double s) { return _mm_add_pd(acc, _mm_mul_pd(x, _mm_set1_pd(s))); }
+
+                    static Type Mul(Type x, Type y) {
+                        const Type y_re = _mm_movedup_pd(y);
+                        const Type y_im = _mm_unpackhi_pd(y, y);
+                        const Type x_swapped = _mm_shuffle_pd(x, x, 1);
+                        return _mm_addsub_pd(_mm_mul_pd(x, y_re), _mm_mul_pd(x_swapped, y_im));
+                    }
+
+                    static Type MulI(Type x) { return _mm_xor_pd(_mm_shuffle_pd(x, x, 1), _mm_setr_pd(-0.0, 0.0)); }
+                    static Type MulNegI(Type x) { return _mm_xor_pd(_mm_shuffle_pd(x, x, 1), _mm_setr_pd(0.0, -0.0)); }
+                };
+#else
+                using Vector = Scalar;
+#endif
+
+                constexpr double sqrt_half = 0.70710678118654752440;
+                constexpr double sin_pi_3 = 0.86602540378443864676;   // sin(2 pi/3)
+                constexpr double cos_2pi_5 = 0.30901699437494742410;  // cos(2 pi/5)
+                constexpr double cos_4pi_5 = -0.80901699437494742410; // cos(4 pi/5)
+                constexpr double sin_2pi_5 = 0.95105651629515357212;  // sin(2 pi/5)
+                constexpr double sin_4pi_5 = 0.58778525229247312917;  // sin(4 pi/5)
+                constexpr double cos_2pi_7 = 0.62348980185873353053;  // cos(2 pi/7)
+                constexpr double cos_4pi_7 = -0.22252093395631440429; // cos(4 pi/7)
+                constexpr double cos_6pi_7 = -0.90096886790241912624; // cos(6 pi/7)
+                constexpr double sin_2pi_7 = 0.78183148246802980871;  // sin(2 pi/7)
+                constexpr double sin_4pi_7 = 0.97492791218182360702;  // sin(4 pi/7)
+                constexpr double sin_6pi_7 = 0.43388373911755812048;  // sin(6 pi/7)
+
+                /** x*(+-i), the root of unity exp(-+pi i/2) of the direction
+                 */
+                template <class V, bool Inverse>
+                typename V::Type MulSignI(typename V::Type x) {
+                    return Inverse ? V::MulI(x) : V::MulNegI(x);
+                }
+
+                /** the dfts of the points x[0..Radix) in place, exp(-2 pi i/Radix) forward. the
+                 *  dedicated radices are written out, the rest go through the table of roots
+                 */
+                template <class V, bool Inverse, int Radix>
+                struct Butterfly;
+
+                template <class V, bool Inverse>
+                struct Butterfly<V, Inverse, 2> {
+                    static void Run(typename V::Type* x, int, const double*) {
+                        const typename V::Type x0 = x[0];
+                        x[0] = V::Add(x0, x[1]);
+                        x[1] = V::Sub(x0, x[1]);
+                    }
+                };
+
+                template <class V, bool Inverse>
+                struct Butterfly<V, Inverse, 3> {
+                    static void Run(typename V::Type* x, int, const double*) {
+                        // y1, y2 = x0 - (x1 + x2)/2 +- i*sign*sin(2 pi/3)*(x1 - x2)
+                        const typename V::Type sum = V::Add(x[1], x[2]);
+                        const typename V::Type middle = V::Sub(x[0], V::Scale(sum, 0.5));
+                        const typename V::Type rotated = V::Scale(MulSignI<V, Inverse>(V::Sub(x[1], x[2])), sin_pi_3);
+
+                        x[0] = V::Add(x[0], sum);
+                        x[1] = V::Add(middle, rotated);
+                        x[2] = V::Sub(middle, rotated);
+                    }
+                };
+
+                template <class V, bool Inverse>
+                struct Butterfly<V, Inverse, 4> {
+                    static void Run(typename V::Type* x, int, const double*) {
+                        const typename V::Type a0 = V::Add(x[0], x[2]);
+                        const typename V::Type a1 = V::Sub(x[0], x[2]);
+                        const typename V::Type a2 = V::Add(x[1], x[3]);
+                        const typename V::Type a3 = MulSignI<V, Inverse>(V::Sub(x[1], x[3]));
+
+                        x[0] = V::Add(a0, a2);
+                        x[1] = V::Add(a1, a3);
+                        x[2] = V::Sub(a0, a2);
+                        x[3] = V::Sub(a1, a3);
+                    }
+                };
+
+                template <class V, bool Inverse>
+                struct Butterfly<V, Inverse, 5> {
+                    static void Run(typename V::Type* x, int, const double*) {
+                        // the pairs (1, 4) and (2, 3) share their cosines and negate their sines
+                        const typename V::Type a1 = V::Add(x[1], x[4]);
+                        const typename V::Type b1 = V::Sub(x[1], x[4]);
+                        const typename V::Type a2 = V::Add(x[2], x[3]);
+                        const typename V::Type b2 = V::Sub(x[2], x[3]);
+
+                        const typename V::Type real1 = V::Add(x[0], V::Add(V::Scale(a1, cos_2pi_5), V::Scale(a2, cos_4pi_5)));
+                        const typename V::Type real2 = V::Add(x[0], V::Add(V::Scale(a1, cos_4pi_5), V::Scale(a2, cos_2pi_5)));
+                        const typename V::Type imag1 = MulSignI<V, Inverse>(V::Add(V::Scale(b1, sin_2pi_5), V::Scale(b2, sin_4pi_5)));
+                        const typename V::Type imag2 = MulSignI<V, Inverse>(V::Sub(V::Scale(b1, sin_4pi_5), V::Scale(b2, sin_2pi_5)));
+
+                        x[0] = V::Add(x[0], V::Add(a1, a2));
+                        x[1] = V::Add(real1, imag1);
+                        x[4] = V::Sub(real1, imag1);
+                        x[2] = V::Add(real2, imag2);
+                        x[3] = V::Sub(real2, imag2);
+                    }
+                };
+
+                template <class V, bool Inverse>
+                struct Butterfly<V, Inverse, 7> {
+                    static void Run(typename V::Type* x, int, const double*) {
+                        // as radix 5, the pairs (1, 6), (2, 5) and (3, 4) share their cosines and negate their sines
+                        const typename V::Type a1 = V::Add(x[1], x[6]);
+                        const typename V::Type b1 = V::Sub(x[1], x[6]);
+                        const typename V::Type a2 = V::Add(x[2], x[5]);
+                        const typename V::Type b2 = V::Sub(x[2], x[5]);
+                        const typename V::Type a3 = V::Add(x[3], x[4]);
+                        const typename V::Type b3 = V::Sub(x[3], x[4]);
+
+                        const typename V::Type real1 = V::MulAdd(V::MulAdd(V::MulAdd(x[0], a1, cos_2pi_7), a2, cos_4pi_7), a3, cos_6pi_7);
+                        const typename V::Type real2 = V::MulAdd(V::MulAdd(V::MulAdd(x[0], a1, cos_4pi_7), a2, cos_6pi_7), a3, cos_2pi_7);
+                        const typename V::Type real3 = V::MulAdd(V::MulAdd(V::MulAdd(x[0], a1, cos_6pi_7), a2, cos_2pi_7), a3, cos_4pi_7);
+                        const typename V::Type imag1 = MulSignI<V, Inverse>(V::MulAdd(V::MulAdd(V::Scale(b1, sin_2pi_7), b2, sin_4pi_7), b3, sin_6pi_7));
+                        const typename V::Type imag2 = MulSignI<V, Inverse>(V::MulAdd(V::MulAdd(V::Scale(b1, sin_4pi_7), b2, -sin_6pi_7), b3, -sin_2pi_7));
+                        const typename V::Type imag3 = MulSignI<V, Inverse>(V::MulAdd(V::MulAdd(V::Scale(b1, sin_6pi_7), b2, -sin_2pi_7), b3, sin_4pi_7));
+
+                        x[0] = V::Add(x[0], V::Add(a1, V::Add(a2, a3)));
+                        x[1] = V::Add(real1, imag1);
+                        x[6] = V::Sub(real1, imag1);
+                        x[2] = V::Add(real2, imag2);
+                        x[5] = V::Sub(real2, imag2);
+                        x[3] = V::Add(real3, imag3);
+                        x[4] = V::Sub(real3, imag3);
+                    }
+                };
+
+                template <class V, bool Inverse>
+                struct Butterfly<V, Inverse, 8> {
+                    static void Run(typename V::Type* x, int, const double*) {
+                        // two radix 4 dfts of the even and odd points, combined with the powers of exp(-+2 pi i/8)
+                        typename V::Type even[4] = {x[0], x[2], x[4], x[6]};
+                        typename V::Type odd[4] = {x[1], x[3], x[5], x[7]};
+                        Butterfly<V, Inverse, 4>::Run(even, 4, nullptr);
+                        Butterfly<V, Inverse, 4>::Run(odd, 4, nullptr);
+
+                        const typename V::Type rotated1 = V::Scale(V::Add(odd[1], MulSignI<V, Inverse>(odd[1])), sqrt_half);
+                        const typename V::Type rotated2 = MulSignI<V, Inverse>(odd[2]);
+                        const typename V::Type rotated3 = V::Scale(V::Sub(MulSignI<V, Inverse>(odd[3]), odd[3]), sqrt_half);
+
+                        x[0] = V::Add(even[0], odd[0]);
+                        x[4] = V::Sub(even[0], odd[0]);
+                        x[1] = V::Add(even[1], rotated1);
+                        x[5] = V::Sub(even[1], rotated1);
+                        x[2] = V::Add(even[2], rotated2);
+                        x[6] = V::Sub(even[2], rotated2);
+                        x[3] = V::Add(even[3], rotated3);
+                        x[7] = V::Sub(even[3], rotated3);
+                    }
+                };
+
+                /* any other odd radix. roots[k*radix + q] = exp(-+2 pi i k*q/radix) = c + i*s and
+                 * the point radix - q has the conjugate root, so with a = x[q] + x[radix - q] and
+                 * b = x[q] - x[radix - q] each pair adds c*a + i*s*b to y[k] and c*a - i*s*b to
+                 * y[radix - k]. every output pair costs radix - 1 real multiplies per pair of inputs
+                 * instead of two complex ones
+                 */
+                template <class V, bool Inverse>
+                struct Butterfly<V, Inverse, 0> {
+                    static void Run(typename V::Type* x, int radix, const double* roots) {
+                        const int half = radix/2;
+
+                        typename V::Type sums[max_generic_radix/2 + 1];
+                        typename V::Type diffs[max_generic_radix/2 + 1];
+
+                        typename V::Type total = x[0];
+                        for (int q = 1; q <= half; q++) {
+                            sums[q] = V::Add(x[q], x[radix - q]);
+                            diffs[q] = V::Sub(x[q], x[radix - q]);
+                            total = V::Add(total, sums[q]);
+                        }
+
+                        for (int k = 1; k <= half; k++) {
+                            const double* row = roots + 2*k*radix;
+
+                            typename V::Type real = V::MulAdd(x[0], sums[1], row[2]);
+                            typename V::Type imag = V::Scale(diffs[1], row[3]);
+                            for (int q = 2; q <= half; q++) {
+                                real = V::MulAdd(real, sums[q], row[2*q]);
+                                imag = V::MulAdd(imag, diffs[q], row[2*q + 1]);
+                            }
+
+                            // the sign of the direction is in the roots
+                            const typename V::Type rotated = V::MulI(imag);
+                            x[k] = V::Add(real, rotated);
+                            x[radix - k] = V::Sub(real, rotated);
+                        }
+
+                        x[0] = total;
+                    }
+                };
+
+                /** twiddles and transforms the points j, j + m, ... j + (radix - 1)*m of a group,
+                 *  and the V::lanes - 1 columns after j with them
+                 */
+                template <class V, bool Inverse, int Radix>
+                void Column(double* group, size_t j, size_t m, int radix, const double* twiddles, const double* roots) {
+                    typename V::Type x[max_generic_radix];
+
+                    // known at compile time for the dedicated butterflies, so the loops unroll
+                    if (Radix != 0) radix = Radix;
+
+                    x[0] = V::Load(group + 2*j);
+                    for (int q = 1; q < radix; q++) {
+                        x[q] = V::Load(group + 2*(j + q*m));
+
+                        // the first stage's twiddles are all 1
+                        if (m > 1) x[q] = V::Mul(x[q], V::Load(twiddles + 2*((q - 1)*m + j)));
+                    }
+
+                    Butterfly<V, Inverse, Radix>::Run(x, radix, roots);
+
+                    for (int q = 0; q < radix; q++) V::Store(group + 2*(j + q*m), x[q]);
+                }
+
+                /** the first stage, m = 1 and no twiddles, with one group per lane since a group's
+                 *  points are next to each other
+                 */
+                template <class V, bool Inverse, int Radix>
+                void Groups(double* groups, int radix, const double* roots) {
+                    typename V::Type x[max_generic_radix];
+
+                    if (Radix != 0) radix = Radix;
+
+                    for (int q = 0; q < radix; q++) x[q] = V::LoadSplit(groups + 2*q, 2*radix);
+                    Butterfly<V, Inverse, Radix>::Run(x, radix, roots);
+                    for (int q = 0; q < radix; q++) V::StoreSplit(groups + 2*q, 2*radix, x[q]);
+                }
+
+                template <bool Inverse, int Radix>
+                void StageRadix(double* data, size_t n, size_t m, int radix, const double* twiddles, const double* roots) {
+                    const size_t span = m*radix;
+
+                    if (m == 1) {
+                        size_t start = 0;
+                        for (; start + Vector::lanes*span <= n; start += Vector::lanes*span) Groups<Vector, Inverse, Radix>(data + 2*start, radix, roots);
+                        for (; start < n; start += span) Groups<Scalar, Inverse, Radix>(data + 2*start, radix, roots);
+                        return;
+                    }
+
+                    for (size_t start = 0; start < n; start += span) {
+                        double* group = data + 2*start;
+
+                        size_t j = 0;
+                        for (; j + Vector::lanes <= m; j += Vector::lanes) Column<Vector, Inverse, Radix>(group, j, m, radix, twiddles, roots);
+                        for (; j < m; j++) Column<Scalar, Inverse, Radix>(group, j, m, radix, twiddles, roots);
+                    }
+                }
+
+                template <bool Inverse>
+                void StageDirection(double* data, size_t n, size_t m, int radix, const double* twiddles, const double* roots) {
+                    switch (radix) {
+                        case 2: StageRadix<Inverse, 2>(data, n, m, radix, twiddles, roots); break;
+                        case 3: StageRadix<Inverse, 3>(data, n, m, radix, twiddles, roots); break;
+                        case 4: StageRadix<Inverse, 4>(data, n, m, radix, twiddles, roots); break;
+                        case 5: StageRadix<Inverse, 5>(data, n, m, radix, twiddles, roots); break;
+                        case 7: StageRadix<Inverse, 7>(data, n, m, radix, twiddles, roots); break;
+                        case 8: StageRadix<Inverse, 8>(data, n, m, radix, twiddles, roots); break;
+                        default: StageRadix<Inverse, 0>(data, n, m, radix, twiddles, roots); break;
+                    }
+                }
+
+                void Stage(double* data, size_t n, size_t m, int radix, const double* twiddles, const double* roots, bool inverse) {
+                    if (inverse) StageDirection<true>(data, n, m, radix, twiddles, roots);
+                    else StageDirection<false>(data, n, m, radix, twiddles, roots);
+                }
+
+                void Multiply(double* x, const double* y, size_t n) {
+                    size_t i = 0;
+                    for (; i + Vector::lanes <= n; i += Vector::lanes) Vector::Store(x + 2*i, Vector::Mul(Vector::Load(x + 2*i), Vector::Load(y + 2*i)));
+                    for (; i < n; i++) Scalar::Store(x + 2*i, Scalar::Mul(Scalar::Load(x + 2*i), Scalar::Load(y + 2*i)));
+                }
+
+            } // namespace
+
+        } // namespace FFT_ISA
+    } // namespace Fft
+} // namespace OptimizationTests
+
+#endif // FFT_BUTTERFLIES_H
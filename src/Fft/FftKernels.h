@@ -0,0 +1,59 @@
+/*
+FftKernels.h the fft butterflies built once per instruction set
+Evan Newman
+*/
+
+#ifndef FFT_KERNELS_H
+#define FFT_KERNELS_H
+
+#include <cstddef>
+
+#include "Util/CpuInfo.h"
+
+namespace OptimizationTests {
+    namespace Fft {
+
+        /** the radices a stage can have a dedicated butterfly for, other odd primes up to
+         *  max_generic_radix go through the generic O(radix^2) one
+         */
+        constexpr int max_generic_radix = 13;
+
+        /** one build of the butterflies, complex numbers are interleaved (real, imaginary) doubles
+         */
+        struct KernelTable {
+            const char* name;
+
+            /** one decimation in time stage over all n points of data: every group of m*radix
+             *  points is radix transforms of length m combined into one of length m*radix. for
+             *  every j < m the points j + q*m of the group are multiplied by twiddles[(q - 1)*m + j]
+             *  (q >= 1) and then transformed with a radix point dft. roots holds the radix x radix
+             *  roots of unity exp(-+2 pi i k*q/radix) at [k*radix + q] for the generic butterfly,
+             *  which only takes odd radices. inverse flips the sign of the exponent
+             */
+            void (*stage)(double* data, size_t n, size_t m, int radix, const double* twiddles, const double* roots, bool inverse);
+
+            /** x[i] *= y[i] for n complex numbers
+             */
+            void (*multiply)(double* x, const double* y, size_t n);
+        };
+
+        namespace Generic { extern const KernelTable kernel_table; }
+        namespace Sse42 { extern const KernelTable kernel_table; }
+        namespace Avx2 { extern const KernelTable kernel_table; }
+        namespace Avx512 { extern const KernelTable kernel_table; }
+
+        /** the butterflies in use, the newest instruction set this processor supports
+         *  unless SelectKernels picked another build
+         */
+        const KernelTable& Kernels();
+
+        /** switches to the build of the butterflies for isa
+         *
+         * \return false, leaving the butterflies alone, if this processor doesn't support isa
+         */
+        bool SelectKernels(Util::Isa isa);
+
+    } // namespace Fft
+} // namespace OptimizationTests
+
+#endif // FFT_KERNELS_H
@@ -0,0 +1,23 @@
+/*
+FftKernelsAvx2.cpp the butterflies built for avx2 and fma, the compile flags are set in CMakeLists.txt
+Evan Newman
+*/
+
+#define FFT_ISA Avx2
+
+#include "FftKernels.h"
+#include "FftButterflies.h"
+
+namespace OptimizationTests {
+    namespace Fft {
+        namespace Avx2 {
+
+            const KernelTable kernel_table = {
+                "avx2",
+                Stage,
+                Multiply
+            };
+
+        } // namespace Avx2
+    } // namespace Fft
+} // namespace OptimizationTests
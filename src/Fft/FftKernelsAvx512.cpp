@@ -0,0 +1,23 @@
+/*
+FftKernelsAvx512.cpp the butterflies built for avx512f, the compile flags are set in CMakeLists.txt
+Evan Newman
+*/
+
+#define FFT_ISA Avx512
+
+#include "FftKernels.h"
+#include "FftButterflies.h"
+
+namespace OptimizationTests {
+    namespace Fft {
+        namespace Avx512 {
+
+            const KernelTable kernel_table = {
+                "avx512",
+                Stage,
+                Multiply
+            };
+
+        } // namespace Avx512
+    } // namespace Fft
+} // namespace OptimizationTests
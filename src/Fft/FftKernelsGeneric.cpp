@@ -0,0 +1,23 @@
+/*
+FftKernelsGeneric.cpp the butterflies built for the default target of the compiler, used when avx2 isn't supported
+Evan Newman
+*/
+
+#define FFT_ISA Generic
+
+#include "FftKernels.h"
+#include "FftButterflies.h"
+
+namespace OptimizationTests {
+    namespace Fft {
+        namespace Generic {
+
+            const KernelTable kernel_table = {
+                "generic",
+                Stage,
+                Multiply
+            };
+
+        } // namespace Generic
+    } // namespace Fft
+} // namespace OptimizationTests
@@ -0,0 +1,23 @@
+/*
+FftKernelsSse42.cpp the butterflies built for sse4.2, the compile flags are set in CMakeLists.txt
+Evan Newman
+*/
+
+#define FFT_ISA Sse42
+
+#include "FftKernels.h"
+#include "FftButterflies.h"
+
+namespace OptimizationTests {
+    namespace Fft {
+        namespace Sse42 {
+
+            const KernelTable kernel_table = {
+                "sse4.2",
+                Stage,
+                Multiply
+            };
+
+        } // namespace Sse42
+    } // namespace Fft
+} // namespace OptimizationTests
@@ -0,0 +1,470 @@
+/*
+FftTests.cpp
+Evan Newman
+*/
+
+#include "FftTests.h"
+
+// System
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Libraries
+#ifdef OPTIMIZATION_TESTS_FFTW
+#include <fftw3.h>
+#endif
+
+// Local
+#include "Fft.h"
+#include "FftBatch.h"
+#include "FftKernels.h"
+
+#include "Util/CpuInfo.h"
+#include "Util/ThreadPool.h"
+#include "Util/Timer.h"
+
+namespace OptimizationTests {
+    namespace Fft {
+
+        const char* const default_wisdom_file = "OptimizationTests.wisdom";
+
+        namespace {
+
+            using LongComplex = std::complex<long double>;
+
+            // every sample runs a transform enough times to cover this many points, so small sizes aren't all timer overhead
+            constexpr size_t points_per_sample = size_t(1) << 18;
+            constexpr int num_samples = 20;
+
+            // the bins checked against the long double dft, checking all of them would be O(n^2)
+            constexpr size_t checked_bins = 64;
+
+            // the largest relative error a transform can have and still count as correct
+            constexpr double tolerance = 1e-12;
+
+            struct TestSize {
+                size_t n;
+                const char* kind;
+            };
+
+            /** the forward dft of x at every step-th bin below bins, summed in long double
+             *  with the roots from a table so every one is exact to long double precision
+             */
+            std::vector<LongComplex> ReferenceDft(const std::vector<Complex>& x, size_t bins, size_t step) {
+                const size_t n = x.size();
+                const long double pi = 3.141592653589793238462643383279502884L;
+
+                std::vector<LongComplex> roots(n);
+                for (size_t j = 0; j < n; j++) {
+                    const long double angle = -2.0L*pi*static_cast<long double>(j)/static_cast<long double>(n);
+                    roots[j] = {std::cos(angle), std::sin(angle)};
+                }
+
+                std::vector<LongComplex> spectrum;
+                for (size_t k = 0; k < bins; k += step) {
+                    LongComplex sum = 0.0L;
+                    for (size_t j = 0; j < n; j++) {
+                        sum += LongComplex(x[j].real(), x[j].imag())*roots[static_cast<uint64_t>(j)*k % n];
+                    }
+                    spectrum.push_back(sum);
+                }
+
+                return spectrum;
+            }
+
+            // the rms error of the checked bins relative to the rms of the reference
+            double RelativeError(const Complex* y, const std::vector<LongComplex>& reference, size_t step) {
+                long double error = 0.0L;
+                long double norm = 0.0L;
+                for (size_t i = 0; i < reference.size(); i++) {
+                    const LongComplex bin(y[i*step].real(), y[i*step].imag());
+                    error += std::norm(bin - reference[i]);
+                    norm += std::norm(reference[i]);
+                }
+
+                return norm > 0.0L ? static_cast<double>(std::sqrt(error/norm)) : 0.0;
+            }
+
+            /** the rms error of y against n*x, relative to the rms of n*x, for a forward and an
+             *  unnormalized inverse transform that took x to y
+             */
+            template <typename T>
+            double RoundTripError(const std::vector<T>& x, const std::vector<T>& y) {
+                const double n = static_cast<double>(x.size());
+
+                long double error = 0.0L;
+                long double norm = 0.0L;
+                for (size_t j = 0; j < x.size(); j++) {
+                    error += std::norm(y[j] - n*x[j]);
+                    norm += std::norm(n*x[j]);
+                }
+
+                return norm > 0.0L ? static_cast<double>(std::sqrt(error/norm)) : 0.0;
+            }
+
+            // the rms of y - reference relative to the rms of reference
+            double RelativeDifference(const std::vector<Complex>& y, const std::vector<Complex>& reference) {
+                long double error = 0.0L;
+                long double norm = 0.0L;
+                for (size_t j = 0; j < y.size(); j++) {
+                    error += std::norm(y[j] - reference[j]);
+                    norm += std::norm(reference[j]);
+                }
+
+                return norm > 0.0L ? static_cast<double>(std::sqrt(error/norm)) : 0.0;
+            }
+
+            /** runs plan in place on howmany arrays at x the way ExecuteBatch lays them out,
+             *  gathering every array a point at a time
+             */
+            void NaiveBatch(const Plan& plan, Complex* x, size_t howmany, size_t stride, size_t distance) {
+                const size_t n = plan.Size();
+                std::vector<Complex> line(n);
+
+                for (size_t i = 0; i < howmany; i++) {
+                    Complex* first = x + i*distance;
+                    for (size_t j = 0; j < n; j++) line[j] = first[j*stride];
+                    plan.Execute(line.data(), line.data());
+                    for (size_t j = 0; j < n; j++) first[j*stride] = line[j];
+                }
+            }
+
+            /** the transform of the row major array x with dims, one dimension at a time through
+             *  one dimensional plans
+             */
+            std::vector<Complex> AxisByAxis(std::vector<Complex> x, const std::vector<size_t>& dims, Direction direction) {
+                size_t inner = 1;
+                for (size_t d = dims.size(); d-- > 0;) {
+                    const size_t n = dims[d];
+                    const size_t outer = x.size()/(n*inner);
+                    const Plan plan(n, direction);
+
+                    for (size_t o = 0; o < outer; o++) NaiveBatch(plan, x.data() + o*n*inner, inner, inner, 1);
+
+                    inner *= n;
+                }
+
+                return x;
+            }
+
+            std::string DimsString(const std::vector<size_t>& dims) {
+                std::string string;
+                for (size_t d = 0; d < dims.size(); d++) string += (d == 0 ? "" : "x") + std::to_string(dims[d]);
+                return string;
+            }
+
+        } // namespace
+
+        void RunFftTests(const std::string& wisdom_file) {
+            std::cout << "-------- Fft Tests --------" << std::endl
+                      << "Butterflies: " << Kernels().name << " (" << Util::CpuModelName() << ", supports "
+                      << Util::IsaName(Util::DetectIsa()) << ")" << std::endl;
+
+#ifdef OPTIMIZATION_TESTS_FFTW
+            const bool wisdom_loaded = fftw_import_wisdom_from_filename(wisdom_file.c_str()) != 0;
+            std::cout << "FFTW " << fftw_version << ", wisdom " << (wisdom_loaded ? "loaded from " + wisdom_file : "measured this run")
+                      << std::endl;
+#else
+            static_cast<void>(wisdom_file); // there's no fftw to plan
+
+            std::cout << "FFTW wasn't found at build time, only the native transforms are timed" << std::endl;
+#endif
+
+            // mflops counts 5 n log2(n) flops for a complex transform and half that for a real one, like fftw's benchmarks
+            std::cout << "Size, Kind, Transform, Plan (ms), Min (ns/point), Mean (ns/point), mflops, Relative Error, Result" << std::endl;
+
+            const std::vector<TestSize> sizes = {
+                {256, "power of two"}, {4096, "power of two"}, {65536, "power of two"}, {size_t(1) << 20, "power of two"},
+                {1000, "composite"}, {1536, "composite"}, {15015, "composite"}, {100000, "composite"},
+                {1009, "prime"}, {65537, "prime"}, {1000003, "prime"}
+            };
+
+            std::mt19937 generator(0);
+            std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+            Util::Timer timer;
+
+            for (const TestSize& size : sizes) {
+                const size_t n = size.n;
+                const size_t bins = n/2 + 1;
+                const size_t step = std::max<size_t>(1, bins/checked_bins);
+                const size_t repeats = std::max<size_t>(1, points_per_sample/n);
+
+                std::vector<Complex> x(n);
+                for (Complex& point : x) point = {distribution(generator), distribution(generator)};
+
+                std::vector<double> x_real(n);
+                std::vector<Complex> x_real_complex(n);
+                for (size_t j = 0; j < n; j++) {
+                    x_real[j] = x[j].real();
+                    x_real_complex[j] = x[j].real();
+                }
+
+                const std::vector<LongComplex> reference = ReferenceDft(x, bins, step);
+                const std::vector<LongComplex> reference_real = ReferenceDft(x_real_complex, bins, step);
+
+                /* times plan(), fills the input with fill() outside the timing, then times repeats
+                 * runs of run() per sample and checks the bins it left at result against reference
+                 */
+                auto RunTest = [&](const std::string& label, bool real, auto plan, auto fill, auto run, const Complex* result) {
+                    Util::Timer plan_timer;
+                    plan_timer.Start();
+                    plan();
+                    const double plan_ms = plan_timer.Stop();
+
+                    fill();
+
+                    run(); // warm up the caches and the plan
+
+                    timer.Reset();
+                    for (int sample = 0; sample < num_samples; sample++) {
+                        timer.Start();
+                        for (size_t i = 0; i < repeats; i++) run();
+                        timer.Stop();
+                    }
+
+                    double min, max, mean;
+                    timer.Stats(min, max, mean);
+
+                    const double points = static_cast<double>(n*repeats);
+                    const double flops = (real ? 2.5 : 5.0)*static_cast<double>(n)*std::log2(static_cast<double>(n));
+
+                    const double error = RelativeError(result, real ? reference_real : reference, step);
+
+                    std::cout << n << ", " << size.kind << ", " << label << ", " << plan_ms << ", "
+                              << min*1e6/points << ", " << mean*1e6/points << ", "
+                              << flops*repeats/(min*1e3) << ", "
+                              << error << ", " << (error <= tolerance ? "ok" : "error") << std::endl;
+                };
+
+                auto NoFill = []() {}; // the native transforms read x where it is
+
+                std::vector<Complex> y(n);
+
+                std::unique_ptr<Plan> plan;
+                RunTest("native", false,
+                        [&]() { plan = std::make_unique<Plan>(n); },
+                        NoFill,
+                        [&]() { plan->Execute(x.data(), y.data()); },
+                        y.data());
+
+                std::unique_ptr<RealPlan> real_plan;
+                RunTest("native real", true,
+                        [&]() { real_plan = std::make_unique<RealPlan>(n); },
+                        NoFill,
+                        [&]() { real_plan->Execute(x_real.data(), y.data()); },
+                        y.data());
+
+#ifdef OPTIMIZATION_TESTS_FFTW
+                // fftw's own allocations so it can use its aligned code paths, measuring a plan overwrites them
+                fftw_complex* fftw_in = fftw_alloc_complex(n);
+                fftw_complex* fftw_out = fftw_alloc_complex(n);
+                double* fftw_real_in = fftw_alloc_real(n);
+
+                fftw_plan fftw = nullptr;
+                RunTest("fftw", false,
+                        [&]() { fftw = fftw_plan_dft_1d(static_cast<int>(n), fftw_in, fftw_out, FFTW_FORWARD, FFTW_MEASURE); },
+                        [&]() { std::copy(x.begin(), x.end(), reinterpret_cast<Complex*>(fftw_in)); },
+                        [&]() { fftw_execute(fftw); },
+                        reinterpret_cast<const Complex*>(fftw_out));
+                fftw_destroy_plan(fftw);
+
+                fftw_plan fftw_real = nullptr;
+                RunTest("fftw real", true,
+                        [&]() { fftw_real = fftw_plan_dft_r2c_1d(static_cast<int>(n), fftw_real_in, fftw_out, FFTW_MEASURE); },
+                        [&]() { std::copy(x_real.begin(), x_real.end(), fftw_real_in); },
+                        [&]() { fftw_execute(fftw_real); },
+                        reinterpret_cast<const Complex*>(fftw_out));
+                fftw_destroy_plan(fftw_real);
+
+                fftw_free(fftw_in);
+                fftw_free(fftw_out);
+                fftw_free(fftw_real_in);
+#endif
+            }
+
+            /* the inverse transforms, run back on forward ones. the real transforms take a
+             * different path for each of these kinds of size
+             */
+            std::cout << "-------- Fft Round Trips --------" << std::endl
+                      << "Size, Kind, Transform, Relative Error, Result" << std::endl;
+
+            const std::vector<TestSize> round_trip_sizes = {
+                {4096, "n/2 even"}, {1000, "n/2 even"}, {4098, "n/2 odd"}, {30030, "n/2 odd"},
+                {1009, "odd"}, {15015, "odd"}, {65537, "odd"}
+            };
+
+            for (const TestSize& size : round_trip_sizes) {
+                const size_t n = size.n;
+
+                auto PrintRoundTrip = [&](const char* label, double error) {
+                    std::cout << n << ", " << size.kind << ", " << label << ", " << error << ", "
+                              << (error <= tolerance ? "ok" : "error") << std::endl;
+                };
+
+                std::vector<Complex> x(n);
+                for (Complex& point : x) point = {distribution(generator), distribution(generator)};
+
+                std::vector<Complex> spectrum(n);
+                std::vector<Complex> y(n);
+                fft(x.data(), spectrum.data(), n, Direction::Forward);
+                fft(spectrum.data(), y.data(), n, Direction::Inverse);
+                PrintRoundTrip("complex", RoundTripError(x, y));
+
+                std::vector<double> x_real(n);
+                for (size_t j = 0; j < n; j++) x_real[j] = x[j].real();
+
+                std::vector<double> y_real(n);
+                rfft(x_real.data(), spectrum.data(), n);
+                irfft(spectrum.data(), y_real.data(), n);
+                PrintRoundTrip("real", RoundTripError(x_real, y_real));
+            }
+
+            /* ----- Batches and multidimensional transforms against one dimensional plans run line by line ----- */
+            std::cout << "-------- Fft Multidimensional Tests --------" << std::endl
+                      << "Transform, Dims, Relative Error, Result" << std::endl;
+
+            auto RandomPoints = [&](size_t size) {
+                std::vector<Complex> points(size);
+                for (Complex& point : points) point = {distribution(generator), distribution(generator)};
+                return points;
+            };
+
+            auto PrintCheck = [&](const std::string& label, const std::vector<size_t>& dims,
+                                  const std::vector<Complex>& y, const std::vector<Complex>& reference) {
+                const double error = RelativeDifference(y, reference);
+                std::cout << label << ", " << DimsString(dims) << ", " << error << ", "
+                          << (error <= tolerance ? "ok" : "error") << std::endl;
+            };
+
+            Util::ThreadPool& pool = Util::ThreadPool::Default();
+
+            /* howmany arrays of n points, laid out contiguously, as the columns of a row major
+             * array, and interleaved with gaps. the points ExecuteBatch doesn't touch have to come
+             * through unchanged. 37 arrays leave a partial block of the gather
+             */
+            struct BatchLayout {
+                const char* label;
+                size_t n;
+                size_t howmany;
+                size_t stride;
+                size_t distance;
+                bool in_place;
+            };
+
+            const std::vector<BatchLayout> layouts = {
+                {"ExecuteBatch contiguous", 100, 37, 1, 100, false},
+                {"ExecuteBatch columns in place", 60, 37, 37, 1, true},
+                {"ExecuteBatch strided with gaps", 30, 20, 2*20 + 1, 2, false}
+            };
+
+            for (const BatchLayout& layout : layouts) {
+                const size_t size = (layout.howmany - 1)*layout.distance + (layout.n - 1)*layout.stride + 1;
+                const Plan plan(layout.n);
+
+                const std::vector<Complex> x = RandomPoints(size);
+
+                std::vector<Complex> reference = x;
+                NaiveBatch(plan, reference.data(), layout.howmany, layout.stride, layout.distance);
+
+                std::vector<Complex> y = x;
+                ExecuteBatch(plan, layout.in_place ? y.data() : x.data(), y.data(), layout.howmany, layout.stride, layout.distance, pool);
+
+                PrintCheck(layout.label, {layout.howmany, layout.n}, y, reference);
+            }
+
+            // the middle dimensions of the 3-D and 4-D arrays are gathered with whole planes on either side
+            {
+                const std::vector<size_t> dims = {48, 100};
+                const std::vector<Complex> x = RandomPoints(48*100);
+                std::vector<Complex> y(x.size());
+                fft2d(x.data(), y.data(), 48, 100);
+                PrintCheck("fft2d", dims, y, AxisByAxis(x, dims, Direction::Forward));
+            }
+
+            {
+                const std::vector<size_t> dims = {12, 18, 20};
+                const std::vector<Complex> x = RandomPoints(12*18*20);
+                std::vector<Complex> y(x.size());
+                fft3d(x.data(), y.data(), 12, 18, 20);
+                PrintCheck("fft3d", dims, y, AxisByAxis(x, dims, Direction::Forward));
+            }
+
+            {
+                const std::vector<size_t> dims = {10, 9, 16};
+                const std::vector<Complex> x = RandomPoints(10*9*16);
+                std::vector<Complex> y = x;
+                fft3d(y.data(), y.data(), 10, 9, 16, Direction::Inverse);
+                PrintCheck("fft3d inverse in place", dims, y, AxisByAxis(x, dims, Direction::Inverse));
+            }
+
+            {
+                const std::vector<size_t> dims = {6, 5, 7, 8};
+                const MultiDimPlan plan(dims);
+                const std::vector<Complex> x = RandomPoints(plan.Size());
+                std::vector<Complex> y(x.size());
+                plan.Execute(x.data(), y.data(), pool);
+                PrintCheck("MultiDimPlan", dims, y, AxisByAxis(x, dims, Direction::Forward));
+            }
+
+            /* ----- Thread scaling of the multidimensional transforms ----- */
+            // thread counts 1, 2, 4, ... up to the hardware concurrency
+            std::vector<unsigned> thread_counts;
+            const unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+            for (unsigned threads = 1; threads < max_threads; threads *= 2) thread_counts.push_back(threads);
+            thread_counts.push_back(max_threads);
+
+            std::cout << "-------- MultiDimPlan Scaling --------" << std::endl
+                      << "Dims, Threads, Mean (ms), Speedup, Efficiency" << std::endl;
+
+            for (const std::vector<size_t>& dims : {std::vector<size_t>{1024, 1024}, std::vector<size_t>{128, 128, 128}}) {
+                const MultiDimPlan plan(dims);
+                const std::vector<Complex> x = RandomPoints(plan.Size());
+                std::vector<Complex> y(x.size());
+
+                std::vector<std::pair<unsigned, double>> scaling; // (threads, mean ms)
+                for (unsigned threads : thread_counts) {
+                    Util::ThreadPool threads_pool(threads);
+
+                    plan.Execute(x.data(), y.data(), threads_pool); // warm up the pool's scratch
+
+                    timer.Reset();
+                    for (int sample = 0; sample < num_samples; sample++) {
+                        timer.Start();
+                        plan.Execute(x.data(), y.data(), threads_pool);
+                        timer.Stop();
+                    }
+
+                    double min, max, mean;
+                    timer.Stats(min, max, mean);
+                    scaling.emplace_back(threads, mean);
+                }
+
+                for (const auto& point : scaling) {
+                    const double speedup = scaling.front().second/point.second;
+                    std::cout << DimsString(dims) << ", " << point.first << ", " << point.second << ", "
+                              << speedup << ", " << speedup/point.first << std::endl;
+                }
+            }
+
+#ifdef OPTIMIZATION_TESTS_FFTW
+            if (fftw_export_wisdom_to_filename(wisdom_file.c_str()) != 0) {
+                std::cout << "saved fftw wisdom to " << wisdom_file << std::endl;
+            } else {
+                std::cout << "couldn't write " << wisdom_file << std::endl;
+            }
+#endif
+        }
+
+    } // namespace Fft
+} // namespace OptimizationTests
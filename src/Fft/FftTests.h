@@ -0,0 +1,30 @@
+/*
+FftTests.h is the header for the fft test
+Evan Newman
+*/
+
+#ifndef FFT_TESTS_H
+#define FFT_TESTS_H
+
+#include <string>
+
+namespace OptimizationTests {
+    namespace Fft {
+
+        /** the fftw wisdom file used when none is given on the command line
+         */
+        extern const char* const default_wisdom_file;
+
+        /** times the native complex and real transforms, and fftw's when it was found at build
+         *  time, on power of two, composite and prime sizes, and checks every result against a
+         *  long double dft
+         *
+         * \param wisdom_file fftw's plans are loaded from here before planning and saved back
+         *                    after, so later runs skip measuring them
+         */
+        void RunFftTests(const std::string& wisdom_file);
+
+    } // namespace Fft
+} // namespace OptimizationTests
+
+#endif // FFT_TESTS_H
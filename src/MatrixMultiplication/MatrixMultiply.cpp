@@ -9,6 +9,14 @@ Evan Newman
 #include <stdexcept>
 #include <iostream>
 #include <cstdint>
+#include <algorithm>
+#include <string>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <tuple>
+#include <filesystem>
 
 // Libraries
 #include <eigen3/Eigen/Core> // Eigen stuff
@@ -19,20 +27,58 @@ Evan Newman
 #include "MatrixMultiplyTiled.h"
 #include "MatrixMultiplyCacheOblivious.h"
 #include "MatrixMultiplyFastest.h"
+#include "MatrixMultiplyGemm.h"
+#include "MatrixMultiplyGemmContext.h"
+#include "MatrixMultiplyStrassen.h"
+#include "MatrixMultiplyBatched.h"
+#include "MatrixMultiplySparse.h"
+#include "MatrixMultiplyOutOfCore.h"
+#include "MatrixMultiplyKernels.h"
+#include "MatrixMultiplyNuma.h"
+#include "MatrixMultiplyPlanner.h"
+#include "MatrixMultiplyRoofline.h"
+#include "MatrixMultiplyVerify.h"
 
+#include "Util/CpuInfo.h"
+#include "Util/Numa.h"
 #include "Util/Timer.h"
+#include "Util/ThreadPool.h"
 
 namespace OptimizationTests {
     namespace MatrixMultiply {
 
         void RunMatrixMultiplyTests() {
             std::cout << "-------- MatrixMultiply Tests --------" << std::endl
-                      << "Function Name, Min (ms), Mean (ms), Max (ms)" << std::endl;
+                      << "Kernels: " << Kernels().name << " (" << Util::CpuModelName() << ", supports "
+                      << Util::IsaName(Util::DetectIsa()) << ")" << std::endl;
 
             uint64_t dim1 = 750; // rows of c and a
             uint64_t dim2 = 750; // columns of c and b
             uint64_t dim3 = 750; // columns of a and rows of b
 
+            // the machine's ceilings, measured before anything else runs
+            const Roofline roofline = MeasureRoofline();
+            const double intensity = ArithmeticIntensity(dim1, dim2, dim3);
+
+            std::cout << "Roofline: peak " << roofline.peak_gflops_thread << " GFLOP/s, bandwidth " << roofline.bandwidth_gbs_thread
+                      << " GB/s on one thread, peak " << roofline.peak_gflops << " GFLOP/s, bandwidth " << roofline.bandwidth_gbs
+                      << " GB/s on " << roofline.threads << " threads, " << intensity << " flops per byte at "
+                      << dim1 << "x" << dim2 << "x" << dim3 << std::endl
+                      << "Function Name, Min (ms), Mean (ms), Max (ms), GFLOP/s (of the attainable), Result" << std::endl;
+
+            // the best run's GFLOP/s and its share of what the roofline allows, parallel kernels against the whole machine
+            auto RoofString = [&](Util::Timer& timer, bool parallel) {
+                double min, max, mean;
+                timer.Stats(min, max, mean);
+
+                const double gflops = 2.0*dim1*dim2*dim3/(min*1e6);
+                const double attainable = roofline.Attainable(intensity, parallel);
+
+                std::ostringstream out;
+                out << gflops << " GFLOP/s (" << 100.0*gflops/attainable << "%)";
+                return out.str();
+            };
+
             const int num_iter = 50;
 
             Eigen::MatrixXf a(dim1, dim3);
@@ -45,17 +91,28 @@ namespace OptimizationTests {
 
             Util::Timer timer;
 
-            // run and time eigen
+            // every result is checked with Freivalds' algorithm, so nothing waits on a full reference product
+            auto ResultString = [&](const Eigen::Ref<const Eigen::MatrixXf> c) {
+                const Verification verification = VerifyFreivalds(a, b, c);
+
+                // the relative error shows how far off approximate algorithms like Strassen are
+                std::ostringstream out;
+                out << (verification.ok ? "ok" : "error!") << ", relative error " << verification.relative_error;
+                return out.str();
+            };
+
+            // run and time eigen, only as a kernel to compare against
             Eigen::MatrixXf c_eigen(dim1, dim2);
 
             for (int i = 0; i < num_iter; i++) {
                 timer.Start();
-                c_eigen = (a*b).eval();
+                c_eigen.noalias() = a*b;
                 timer.Stop();
             }
-            std::cout << "Eigen: " << timer.StatsString() << std::endl;
+            std::cout << "Eigen: " << timer.StatsString() << ", " << RoofString(timer, false) << ", result "
+                      << ResultString(c_eigen) << std::endl;
 
-            auto RunTest = [&](auto func, std::string label) {
+            auto RunTest = [&](auto func, std::string label, bool parallel = false) {
                 c.setZero();
 
                 double min = std::numeric_limits<double>::max();
@@ -69,29 +126,400 @@ namespace OptimizationTests {
                     timer.Stop();
                 }
 
-                std::cout << label << ": " << timer.StatsString() << ", result ";
+                std::cout << label << ": " << timer.StatsString() << ", " << RoofString(timer, parallel) << ", result "
+                          << ResultString(c) << std::endl;
+            };
+
+            /* ----- Test the functions ----- */
+            RunTest([](const auto& a, const auto& b, auto& c) { MatMultSimple(a, b, c); }, "MatMultSimple");
+            RunTest([](const auto& a, const auto& b, auto& c) { MatMultSimpleOptimized(a, b, c); }, "MatMultSimpleOptimized");
+
+            RunTest([](const auto& a, const auto& b, auto& c) { MatMultTiled(a, b, c); }, "MatMultTiled");
+            RunTest([](const auto& a, const auto& b, auto& c) { MatMultTiledOptimized(a, b, c); }, "MatMultTiledOptimized");
+
+            // RunTest(MatMultCacheOblivious, "MatMultCacheOblivious");
+            RunTest([](const auto& a, const auto& b, auto& c) { MatMultCacheObliviousOptimized(a, b, c); },
+                    "MatMultCacheObliviousOptimized", true);
+
+            RunTest([](const auto& a, const auto& b, auto& c) { MatMultFastest(a, b, c); }, "MatMultFastest");
+
+            // a small crossover so the 750x750 problem actually recurses, large products use the tuned one
+            RunTest([](const auto& a, const auto& b, auto& c) { MatMultStrassen(a, b, c, 128); },
+                    "MatMultStrassen (crossover 128)");
 
-                // test output
-                if (c.isApprox(c_eigen)) {
-                    std::cout << "ok";
-                } else {
-                    std::cout << "error!";
+            /* ----- Thread scaling of the parallel tiled multiply ----- */
+            // thread counts 1, 2, 4, ... up to the hardware concurrency
+            std::vector<unsigned> thread_counts;
+            unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+            for (unsigned threads = 1; threads < max_threads; threads *= 2) thread_counts.push_back(threads);
+            thread_counts.push_back(max_threads);
+
+            std::vector<std::pair<unsigned, double>> scaling; // (threads, mean ms)
+            for (unsigned threads : thread_counts) {
+                Util::ThreadPool pool(threads);
+
+                RunTest([&pool](const auto& a, const auto& b, auto& c) { MatMultTiledParallel(a, b, c, pool); },
+                        "MatMultTiledParallel (" + std::to_string(threads) + " threads)", true);
+
+                double min, max, mean;
+                timer.Stats(min, max, mean);
+                scaling.emplace_back(threads, mean);
+            }
+
+            std::cout << "-------- MatMultTiledParallel Scaling --------" << std::endl
+                      << "Threads, Mean (ms), Speedup, Efficiency" << std::endl;
+
+            for (const auto& point : scaling) {
+                double speedup = scaling.front().second/point.second;
+                std::cout << point.first << ", " << point.second << ", " << speedup << ", " << speedup/point.first << std::endl;
+            }
+
+            /* ----- Numa placement, the same product with its pages spread over the nodes ----- */
+            {
+                const std::vector<Util::NumaNode>& nodes = Util::NumaNodes();
+
+                std::cout << "-------- NUMA Tests --------" << std::endl << "Nodes:";
+                for (const Util::NumaNode& node : nodes) std::cout << " " << node.id << " (" << node.cpus.size() << " cpus)";
+                std::cout << std::endl;
+
+                // every node's processors reading every node's memory, the diagonal is local
+                std::cout << "Read Bandwidth (GB/s), CPU Node";
+                for (const Util::NumaNode& node : nodes) std::cout << ", Memory Node " << node.id;
+                std::cout << std::endl;
+
+                for (const Util::NumaNode& cpu_node : nodes) {
+                    std::cout << cpu_node.id;
+                    for (const Util::NumaNode& memory_node : nodes) {
+                        std::cout << ", " << Util::ReadBandwidth(cpu_node.id, memory_node.id, size_t(256) << 20);
+                    }
+                    std::cout << std::endl;
                 }
 
+                Util::ThreadPool pinned_pool(0, Util::ThreadPool::Pinning::Nodes);
+
+                // a, b and c as they are, all first touched by this thread
+                RunTest([&pinned_pool](const auto& a, const auto& b, auto& c) { MatMultNuma(a, b, c, pinned_pool); },
+                        "MatMultNuma (first touch by one thread)", true);
+
+                // copies placed before anything touches them, c and b by slab and a interleaved
+                Eigen::MatrixXf a_numa(dim1, dim3);
+                Eigen::MatrixXf b_numa(dim3, dim2);
+                Eigen::MatrixXf c_numa(dim1, dim2);
+
+                PlaceMatrix(a_numa, pinned_pool, NumaPlacement::Interleave);
+                PlaceMatrix(b_numa, pinned_pool, NumaPlacement::Columns);
+                PlaceMatrix(c_numa, pinned_pool, NumaPlacement::Columns);
+
+                a_numa = a;
+                b_numa = b;
+                c_numa.setZero();
+
+                timer.Reset();
+                for (int i = 0; i < num_iter; i++) {
+                    timer.Start();
+                    MatMultNuma(a_numa, b_numa, c_numa, pinned_pool);
+                    timer.Stop();
+                }
+
+                std::cout << "MatMultNuma (placed by node): " << timer.StatsString() << ", " << RoofString(timer, true) << ", result "
+                          << ResultString(c_numa) << std::endl;
+
+                std::cout << "Pages of c per node:";
+                std::vector<size_t> pages = Util::PagesPerNode(c_numa.data(), c_numa.size()*sizeof(float));
+                for (size_t node = 0; node < pages.size(); node++) std::cout << " " << node << ": " << pages[node];
                 std::cout << std::endl;
+            }
+
+            /* ----- Gemm with alpha, beta and a fused epilogue ----- */
+            // c = relu(alpha*a*b + beta*c + bias) with one bias per row
+            std::cout << "-------- Gemm Epilogue Tests --------" << std::endl;
+
+            const float alpha = 0.5f;
+            const float beta = 2.0f;
+
+            Eigen::VectorXf bias = Eigen::VectorXf::Random(dim1);
+            Eigen::MatrixXf c_init = Eigen::MatrixXf::Random(dim1, dim2);
+            Eigen::MatrixXf c_gemm_eigen = ((alpha*a*b + beta*c_init).colwise() + bias).cwiseMax(0.0f);
+
+            GemmEpilogue epilogue = GemmEpilogue::Relu();
+            epilogue.bias_mode = GemmEpilogue::BiasMode::PerRow;
+            epilogue.bias = bias.data();
+
+            auto RunGemmTest = [&](auto func, std::string label) {
+                timer.Reset();
+                for (int i = 0; i < num_iter; i++) {
+                    c = c_init;
+
+                    timer.Start();
+                    func();
+                    timer.Stop();
+                }
+
+                std::cout << label << ": " << timer.StatsString() << ", result "
+                          << (c.isApprox(c_gemm_eigen) ? "ok" : "error!") << std::endl;
             };
 
-            /* ----- Test the functions ----- */
-            RunTest(MatMultSimple, "MatMultSimple");
-            RunTest(MatMultSimpleOptimized, "MatMultSimpleOptimized");
+            RunGemmTest([&]() { Gemm(alpha, a, b, beta, c, epilogue); }, "Gemm (fused epilogue)");
 
-            RunTest(MatMultTiled, "MatMultTiled");
-            RunTest(MatMultTiledOptimized, "MatMultTiledOptimized");
+            // the same work as a product followed by a pass over c for each step
+            Eigen::MatrixXf c_product(dim1, dim2);
+            RunGemmTest([&]() {
+                MatMultFastest(a, b, c_product);
+                c *= beta;
+                c.noalias() += alpha*c_product;
+                c.colwise() += bias;
+                c = c.cwiseMax(0.0f);
+            }, "MatMultFastest + separate passes");
 
-            // RunTest(MatMultCacheOblivious, "MatMultCacheOblivious");
-            // RunTest(MatMultCacheObliviousOptimized, "MatMultCacheObliviousOptimized");
+            /* ----- The same product from a row major a and a stored b^T ----- */
+            // a row major a is a^T in column major order, so both operands are passed transposed
+            std::cout << "-------- Transposed Operand Tests --------" << std::endl;
+
+            Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> a_row_major = a;
+            Eigen::MatrixXf b_transposed = b.transpose();
+
+            auto a_t = a_row_major.transpose(); // no copy, the column major view of a^T
+            const Op t = Op::Transpose;
+
+            RunTest([&](const auto&, const auto&, auto& c) { MatMultTiledOptimized(a_t, b_transposed, c, t, t); },
+                    "MatMultTiledOptimized (a^T, b^T)");
+            RunTest([&](const auto&, const auto&, auto& c) { MatMultCacheObliviousOptimized(a_t, b_transposed, c, t, t); },
+                    "MatMultCacheObliviousOptimized (a^T, b^T)", true);
+            RunTest([&](const auto&, const auto&, auto& c) { MatMultFastest(a_t, b_transposed, c, t, t); },
+                    "MatMultFastest (a^T, b^T)");
+            RunTest([&](const auto&, const auto&, auto& c) { MatMultStrassen(a_t, b_transposed, c, 128, t, t); },
+                    "MatMultStrassen (a^T, b^T, crossover 128)");
+
+            // what the flags save, transposing both operands into new matrices first
+            RunTest([&](const auto&, const auto&, auto& c) {
+                Eigen::MatrixXf a_copy = a_row_major;
+                Eigen::MatrixXf b_copy = b_transposed.transpose();
+                MatMultFastest(a_copy, b_copy, c);
+            }, "MatMultFastest (copies of a and b)");
+
+            // the top left quarter of the product, read straight out of a and b
+            {
+                const uint64_t half1 = dim1/2;
+                const uint64_t half2 = dim2/2;
+
+                Eigen::MatrixXf c_block(half1, half2);
+                Eigen::MatrixXf c_block_eigen = a.topRows(half1)*b.leftCols(half2);
+
+                timer.Reset();
+                for (int i = 0; i < num_iter; i++) {
+                    timer.Start();
+                    MatMultFastest(a.topRows(half1), b.leftCols(half2), c_block);
+                    timer.Stop();
+                }
+
+                std::cout << "MatMultFastest (blocks of a and b): " << timer.StatsString() << ", result "
+                          << (c_block.isApprox(c_block_eigen) ? "ok" : "error!") << std::endl;
+            }
+
+            /* ----- Out of core, the same product through matrix files ----- */
+            {
+                std::filesystem::path directory = std::filesystem::temp_directory_path();
+                std::string a_path = (directory/"OptimizationTests_a.matrix").string();
+                std::string b_path = (directory/"OptimizationTests_b.matrix").string();
+                std::string c_path = (directory/"OptimizationTests_c.matrix").string();
+
+                MatrixFile::Write(a_path, a);
+                MatrixFile::Write(b_path, b);
+
+                MatrixFile a_file(a_path);
+                MatrixFile b_file(b_path);
+                MatrixFile c_file(c_path, dim1, dim2);
+
+                // a working set far below the 6.75MB of the three matrices so the product actually streams
+                const size_t working_set = size_t(4) << 20;
+
+                timer.Reset();
+                for (int i = 0; i < num_iter; i++) {
+                    timer.Start();
+                    MatMultOutOfCore(a_file, b_file, c_file, working_set);
+                    timer.Stop();
+                }
+
+                std::cout << "MatMultOutOfCore (4MB working set): " << timer.StatsString() << ", result "
+                          << ResultString(c_file.Matrix()) << std::endl;
 
-            // RunTest(MatMultFastest, "MatMultFastest");
+                for (const std::string& path : {a_path, b_path, c_path}) std::filesystem::remove(path);
+            }
+
+            /* ----- A fixed b, packed once, times a stream of short a's ----- */
+            {
+                std::cout << "-------- Prepacked MatrixMultiply Tests --------" << std::endl
+                          << "Shape (m x n x k), Gemm (ms), Gemm prepacked b (ms), Speedup, Result" << std::endl;
+
+                Eigen::MatrixXf weights = Eigen::MatrixXf::Random(dim3, dim2);
+                PackedMatrix weights_packed(weights);
+
+                for (int rows : {1, 8, 32, 128}) {
+                    Eigen::MatrixXf a_short = Eigen::MatrixXf::Random(rows, dim3);
+                    Eigen::MatrixXf c_short(rows, dim2);
+                    Eigen::MatrixXf c_short_eigen = a_short*weights;
+
+                    auto TimeShort = [&](auto func) {
+                        timer.Reset();
+                        for (int i = 0; i < num_iter; i++) {
+                            timer.Start();
+                            func();
+                            timer.Stop();
+                        }
+
+                        double min, max, mean;
+                        timer.Stats(min, max, mean);
+                        return min;
+                    };
+
+                    double gemm_min = TimeShort([&]() { Gemm(1.0f, a_short, weights, 0.0f, c_short); });
+                    double packed_min = TimeShort([&]() { Gemm(1.0f, a_short, Op::None, weights_packed, 0.0f, c_short); });
+
+                    std::cout << rows << "x" << dim2 << "x" << dim3 << ", " << gemm_min << ", " << packed_min << ", "
+                              << gemm_min/packed_min << ", " << (c_short.isApprox(c_short_eigen) ? "ok" : "error!") << std::endl;
+                }
+            }
+
+            /* ----- Batched small products ----- */
+            std::cout << "-------- Batched MatrixMultiply Tests --------" << std::endl
+                      << "Size, Batch, Function Name, Min (ms), Mean (ms), Max (ms), Products/s, Result" << std::endl;
+
+            for (int size : {4, 8, 16, 32}) {
+                // about 24MB of operands per batch regardless of the size
+                const size_t batch_count = 2000000/(size*size);
+                const int64_t stride = size*size;
+
+                Eigen::MatrixXf a_batch(stride, batch_count);
+                Eigen::MatrixXf b_batch(stride, batch_count);
+                Eigen::MatrixXf c_batch(stride, batch_count);
+
+                a_batch.setRandom();
+                b_batch.setRandom();
+
+                // the reference results, one eigen product per matrix
+                Eigen::MatrixXf c_batch_eigen(stride, batch_count);
+                for (size_t i = 0; i < batch_count; i++) {
+                    Eigen::Map<Eigen::MatrixXf>(c_batch_eigen.col(i).data(), size, size)
+                        = Eigen::Map<const Eigen::MatrixXf>(a_batch.col(i).data(), size, size)*Eigen::Map<const Eigen::MatrixXf>(b_batch.col(i).data(), size, size);
+                }
+
+                auto RunBatchTest = [&](auto func, std::string label) {
+                    c_batch.setZero();
+
+                    timer.Reset();
+                    for (int i = 0; i < num_iter; i++) {
+                        timer.Start();
+                        func();
+                        timer.Stop();
+                    }
+
+                    double min, max, mean;
+                    timer.Stats(min, max, mean);
+
+                    std::cout << size << "x" << size << ", " << batch_count << ", " << label << ", "
+                              << min << ", " << mean << ", " << max << ", " << batch_count/(min*1e-3) << ", "
+                              << (c_batch.isApprox(c_batch_eigen) ? "ok" : "error!") << std::endl;
+                };
+
+                RunBatchTest([&]() {
+                    MatMultBatchedStrided(size, size, size, a_batch.data(), stride, b_batch.data(), stride, c_batch.data(), stride, batch_count);
+                }, "MatMultBatchedStrided");
+
+                // one call per product through the regular interface, for comparison
+                RunBatchTest([&]() {
+                    for (size_t i = 0; i < batch_count; i++) {
+                        Eigen::Map<Eigen::MatrixXf> c_i(c_batch.col(i).data(), size, size);
+                        MatMultSimpleOptimized(Eigen::Map<const Eigen::MatrixXf>(a_batch.col(i).data(), size, size),
+                                               Eigen::Map<const Eigen::MatrixXf>(b_batch.col(i).data(), size, size),
+                                               c_i);
+                    }
+                }, "MatMultSimpleOptimized per product");
+            }
+
+            /* ----- Sparse a over a sweep of densities ----- */
+            std::cout << "-------- Sparse MatrixMultiply Tests --------" << std::endl
+                      << "Density, Dense (ms), CSR (ms), CSC (ms), CSR Speedup, Result" << std::endl;
+
+            // the dense time doesn't depend on the density, so it is measured once
+            timer.Reset();
+            for (int i = 0; i < num_iter; i++) {
+                timer.Start();
+                MatMultFastest(a, b, c);
+                timer.Stop();
+            }
+
+            double dense_min, dense_max, dense_mean;
+            timer.Stats(dense_min, dense_max, dense_mean);
+
+            for (double density : {0.5, 0.2, 0.1, 0.05, 0.02, 0.01, 0.005, 0.001}) {
+                // keep each element of a with probability density
+                Eigen::MatrixXf keep = (Eigen::MatrixXf::Random(dim1, dim3).array() + 1.0f)*0.5f;
+                Eigen::MatrixXf a_sparse = (keep.array() < density).select(a, 0.0f);
+                Eigen::MatrixXf c_sparse_eigen = a_sparse*b;
+
+                CsrMatrix a_csr(a_sparse);
+                CscMatrix a_csc(a_sparse);
+
+                bool ok = true;
+                auto TimeSparse = [&](const auto& a_compressed) {
+                    c.setZero();
+
+                    timer.Reset();
+                    for (int i = 0; i < num_iter; i++) {
+                        timer.Start();
+                        MatMultSparse(a_compressed, b, c);
+                        timer.Stop();
+                    }
+                    ok = ok && c.isApprox(c_sparse_eigen);
+
+                    double min, max, mean;
+                    timer.Stats(min, max, mean);
+                    return min;
+                };
+
+                double csr_min = TimeSparse(a_csr);
+                double csc_min = TimeSparse(a_csc);
+
+                std::cout << a_csr.Density() << ", " << dense_min << ", " << csr_min << ", " << csc_min << ", "
+                          << dense_min/csr_min << ", " << (ok ? "ok" : "error!") << std::endl;
+            }
+
+            /* ----- The planner on shapes the square products don't cover ----- */
+            std::cout << "-------- Planner MatrixMultiply Tests --------" << std::endl
+                      << "Shape (m x n x k), Path, MatMult (ms), MatMultFastest (ms), Speedup, Result" << std::endl;
+
+            const std::vector<std::tuple<int, int, int>> shapes = {
+                {750, 1, 750}, {1, 750, 750}, {750, 750, 4}, {2000, 2000, 16}, {4096, 8, 16}, {8, 8, 8}, {750, 750, 750}
+            };
+
+            for (const auto& [rows, cols, k] : shapes) {
+                Eigen::MatrixXf a_shape = Eigen::MatrixXf::Random(rows, k);
+                Eigen::MatrixXf b_shape = Eigen::MatrixXf::Random(k, cols);
+                Eigen::MatrixXf c_shape(rows, cols);
+                Eigen::MatrixXf c_shape_eigen = a_shape*b_shape;
+
+                auto TimeShape = [&](auto func) {
+                    timer.Reset();
+                    for (int i = 0; i < num_iter; i++) {
+                        timer.Start();
+                        func();
+                        timer.Stop();
+                    }
+
+                    double min, max, mean;
+                    timer.Stats(min, max, mean);
+                    return min;
+                };
+
+                double planner_min = TimeShape([&]() { MatMult(a_shape, b_shape, c_shape); });
+                bool ok = c_shape.isApprox(c_shape_eigen);
+
+                double fastest_min = TimeShape([&]() { MatMultFastest(a_shape, b_shape, c_shape); });
+
+                std::cout << rows << "x" << cols << "x" << k << ", " << MatMultPathName(PlanMatMult(rows, cols, k)) << ", "
+                          << planner_min << ", " << fastest_min << ", " << fastest_min/planner_min << ", "
+                          << (ok ? "ok" : "error!") << std::endl;
+            }
         }
         
     } // namespace MatrixMultiply
@@ -0,0 +1,295 @@
+/*
+MatrixMultiplyAutotune.cpp
+Evan Newman
+*/
+
+#include "MatrixMultiplyAutotune.h"
+
+// System
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+
+// Libraries
+#include <eigen3/Eigen/Core>
+
+// Local
+#include "MatrixMultiplyTiled.h"
+#include "MatrixMultiplyCacheOblivious.h"
+#include "MatrixMultiplyStrassen.h"
+
+#include "Util/CpuInfo.h"
+#include "Util/ThreadPool.h"
+#include "Util/Timer.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        const char* const default_tuning_file = "OptimizationTests.tuning";
+
+        namespace {
+
+            uint64_t NextPowerOfTwo(uint64_t value) {
+                uint64_t power = 1;
+                while (power < value) power <<= 1;
+                return power;
+            }
+
+            // the exponent of NextPowerOfTwo(value), from the leading zeros of value - 1
+            unsigned CeilLog2(uint64_t value) {
+                return value <= 1 ? 0 : 64 - static_cast<unsigned>(__builtin_clzll(value - 1));
+            }
+
+            const TunedKernel tuned_kernels[] = {
+                TunedKernel::Tiled, TunedKernel::TiledOptimized, TunedKernel::CacheObliviousOptimized, TunedKernel::Strassen
+            };
+
+            bool ParseTunedKernel(const std::string& name, TunedKernel& kernel) {
+                for (TunedKernel candidate : tuned_kernels) {
+                    if (name == TunedKernelName(candidate)) {
+                        kernel = candidate;
+                        return true;
+                    }
+                }
+
+                return false;
+            }
+
+            /** the exponents of a shape class written by ShapeClass, false for anything that
+             *  isn't three powers of two, which no lookup could match
+             */
+            bool ParseShapeClass(const std::string& shape_class, unsigned log2s[3]) {
+                std::istringstream fields(shape_class);
+
+                for (int i = 0; i < 3; i++) {
+                    uint64_t size = 0;
+                    if (!(fields >> size) || size == 0 || (size & (size - 1)) != 0) return false;
+                    if (i < 2 && fields.get() != 'x') return false;
+
+                    log2s[i] = CeilLog2(size);
+                }
+
+                return fields.peek() == std::char_traits<char>::eof();
+            }
+
+        } // namespace
+
+        std::string ShapeClass(uint64_t rows, uint64_t cols, uint64_t k) {
+            return std::to_string(NextPowerOfTwo(rows)) + "x" + std::to_string(NextPowerOfTwo(cols)) + "x" + std::to_string(NextPowerOfTwo(k));
+        }
+
+        const char* TunedKernelName(TunedKernel kernel) {
+            switch (kernel) {
+                case TunedKernel::Tiled: return "MatMultTiled";
+                case TunedKernel::TiledOptimized: return "MatMultTiledOptimized";
+                case TunedKernel::CacheObliviousOptimized: return "MatMultCacheObliviousOptimized";
+                case TunedKernel::Strassen: return "MatMultStrassen";
+            }
+
+            return "unknown";
+        }
+
+        TuningCache::TuningCache() : _cpu_model(Util::CpuModelName()), _snapshot(nullptr) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            Publish();
+        }
+
+        TuningCache& TuningCache::Instance() {
+            static TuningCache cache;
+            return cache;
+        }
+
+        /* the tuning file is plain text with one entry per line
+         * cpu model <tab> kernel <tab> shape class <tab> block size
+         * lines starting with # are comments
+         */
+        bool TuningCache::Load(const std::string& path) {
+            std::ifstream file(path);
+            if (!file.is_open()) return false;
+
+            // parsed in full before anything is merged, so a bad file leaves the cache as it was
+            std::map<Key, int> block_sizes;
+
+            std::string line;
+            while (std::getline(file, line)) {
+                if (line.empty() || line[0] == '#') continue;
+
+                std::istringstream fields(line);
+                std::string cpu_model, kernel, shape_class, block_size_text;
+
+                if (!std::getline(fields, cpu_model, '\t')
+                    || !std::getline(fields, kernel, '\t')
+                    || !std::getline(fields, shape_class, '\t')
+                    || !std::getline(fields, block_size_text)) {
+                    throw std::runtime_error("malformed line in tuning file " + path + ": " + line);
+                }
+
+                std::istringstream value(block_size_text);
+                int block_size = 0;
+                value >> block_size;
+
+                if (value.fail() || !value.eof() || block_size <= 0) {
+                    throw std::runtime_error("malformed block size in tuning file " + path + ": " + line);
+                }
+
+                block_sizes[Key(cpu_model, kernel, shape_class)] = block_size;
+            }
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (const auto& entry : block_sizes) _block_sizes[entry.first] = entry.second;
+            Publish();
+
+            return true;
+        }
+
+        void TuningCache::Save(const std::string& path) const {
+            std::ofstream file(path);
+            if (!file.is_open()) throw std::runtime_error("could not open tuning file " + path + " for writing");
+
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            file << "# OptimizationTests tuning cache" << std::endl
+                 << "# cpu model\tkernel\tshape class\tblock size" << std::endl;
+
+            for (const auto& entry : _block_sizes) {
+                file << std::get<0>(entry.first) << '\t'
+                     << std::get<1>(entry.first) << '\t'
+                     << std::get<2>(entry.first) << '\t'
+                     << entry.second << std::endl;
+            }
+        }
+
+        int TuningCache::BlockSize(TunedKernel kernel, uint64_t rows, uint64_t cols, uint64_t k, int fallback) const {
+            const Snapshot& snapshot = *_snapshot.load(std::memory_order_acquire);
+            if (snapshot.block_sizes.empty()) return fallback;
+
+            const uint64_t key = SnapshotKey(kernel, CeilLog2(rows), CeilLog2(cols), CeilLog2(k));
+
+            auto entry = std::lower_bound(snapshot.block_sizes.begin(), snapshot.block_sizes.end(), key,
+                                          [](const std::pair<uint64_t, int>& entry, uint64_t key) { return entry.first < key; });
+            return entry == snapshot.block_sizes.end() || entry->first != key ? fallback : entry->second;
+        }
+
+        void TuningCache::Set(TunedKernel kernel, const std::string& shape_class, int block_size) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _block_sizes[Key(_cpu_model, TunedKernelName(kernel), shape_class)] = block_size;
+            Publish();
+        }
+
+        uint64_t TuningCache::SnapshotKey(TunedKernel kernel, unsigned rows_log2, unsigned cols_log2, unsigned k_log2) {
+            return static_cast<uint64_t>(kernel) << 24 | rows_log2 << 16 | cols_log2 << 8 | k_log2;
+        }
+
+        void TuningCache::Publish() {
+            auto snapshot = std::make_unique<Snapshot>();
+
+            // entries of other cpus, of kernels this build doesn't have, or with a shape class no lookup makes are never matched
+            for (const auto& entry : _block_sizes) {
+                TunedKernel kernel;
+                unsigned log2s[3];
+
+                if (std::get<0>(entry.first) != _cpu_model
+                    || !ParseTunedKernel(std::get<1>(entry.first), kernel)
+                    || !ParseShapeClass(std::get<2>(entry.first), log2s)) {
+                    continue;
+                }
+
+                snapshot->block_sizes.emplace_back(SnapshotKey(kernel, log2s[0], log2s[1], log2s[2]), entry.second);
+            }
+
+            std::sort(snapshot->block_sizes.begin(), snapshot->block_sizes.end());
+
+            _snapshot.store(snapshot.get(), std::memory_order_release);
+            _snapshots.push_back(std::move(snapshot));
+        }
+
+        void Autotune(const std::vector<std::array<uint64_t, 3>>& shapes, int num_iter) {
+            using Kernel = std::function<void(const Eigen::MatrixXf&, const Eigen::MatrixXf&, Eigen::MatrixXf&)>;
+
+            std::cout << "-------- MatrixMultiply Autotune --------" << std::endl
+                      << "CPU: " << Util::CpuModelName() << std::endl
+                      << "Kernel, Shape, Block Size, Min (ms)" << std::endl;
+
+            for (const auto& shape : shapes) {
+                Eigen::MatrixXf a(shape[0], shape[2]);
+                Eigen::MatrixXf b(shape[2], shape[1]);
+                Eigen::MatrixXf c(shape[0], shape[1]);
+
+                a.setRandom();
+                b.setRandom();
+
+                const std::string shape_class = ShapeClass(shape[0], shape[1], shape[2]);
+
+                // times each candidate and stores the one with the lowest minimum
+                auto Tune = [&](TunedKernel tuned_kernel, const std::vector<std::pair<int, Kernel>>& candidates) {
+                    const std::string kernel = TunedKernelName(tuned_kernel);
+
+                    int best_block_size = 0;
+                    double best_time = std::numeric_limits<double>::max();
+
+                    for (const auto& candidate : candidates) {
+                        Util::Timer timer;
+
+                        candidate.second(a, b, c); // warm up the caches and the pool
+
+                        for (int i = 0; i < num_iter; i++) {
+                            timer.Start();
+                            candidate.second(a, b, c);
+                            timer.Stop();
+                        }
+
+                        double min, max, mean;
+                        timer.Stats(min, max, mean);
+
+                        std::cout << kernel << ", " << shape[0] << "x" << shape[1] << "x" << shape[2] << ", "
+                                  << candidate.first << ", " << min << std::endl;
+
+                        if (min < best_time) {
+                            best_time = min;
+                            best_block_size = candidate.first;
+                        }
+                    }
+
+                    TuningCache::Instance().Set(tuned_kernel, shape_class, best_block_size);
+                    std::cout << kernel << " " << shape_class << " -> " << best_block_size << std::endl;
+                };
+
+                std::vector<std::pair<int, Kernel>> tiled;
+                std::vector<std::pair<int, Kernel>> tiled_optimized;
+                std::vector<std::pair<int, Kernel>> cache_oblivious;
+                std::vector<std::pair<int, Kernel>> strassen;
+
+                ForEachBlockSize(TiledBlockSizes(), [&](auto size) {
+                    tiled.emplace_back(size.value, [](const Eigen::MatrixXf& a, const Eigen::MatrixXf& b, Eigen::MatrixXf& c) {
+                        MatMultTiledBlocked<decltype(size)::value>(a, b, c);
+                    });
+                    tiled_optimized.emplace_back(size.value, [](const Eigen::MatrixXf& a, const Eigen::MatrixXf& b, Eigen::MatrixXf& c) {
+                        MatMultTiledOptimizedBlocked<decltype(size)::value>(a, b, c);
+                    });
+                });
+
+                ForEachBlockSize(CacheObliviousBlockSizes(), [&](auto size) {
+                    cache_oblivious.emplace_back(size.value, [](const Eigen::MatrixXf& a, const Eigen::MatrixXf& b, Eigen::MatrixXf& c) {
+                        MatMultCacheObliviousOptimizedBlocked<decltype(size)::value>(a, b, c, Util::ThreadPool::Default());
+                    });
+                });
+
+                ForEachBlockSize(StrassenCrossovers(), [&](auto size) {
+                    strassen.emplace_back(size.value, [](const Eigen::MatrixXf& a, const Eigen::MatrixXf& b, Eigen::MatrixXf& c) {
+                        MatMultStrassen(a, b, c, decltype(size)::value);
+                    });
+                });
+
+                Tune(TunedKernel::Tiled, tiled);
+                Tune(TunedKernel::TiledOptimized, tiled_optimized);
+                Tune(TunedKernel::CacheObliviousOptimized, cache_oblivious);
+                Tune(TunedKernel::Strassen, strassen);
+            }
+        }
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
@@ -0,0 +1,158 @@
+/*
+MatrixMultiplyAutotune.h block size candidates, the persisted tuning cache and the autotuner
+Evan Newman
+*/
+
+#ifndef MATRIX_MULTIPLY_AUTOTUNE_H
+#define MATRIX_MULTIPLY_AUTOTUNE_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        /** a compile time list of block sizes a kernel is instantiated for
+         */
+        template <int... Sizes>
+        struct BlockSizeList {};
+
+        // candidates for MatMultTiled and MatMultTiledOptimized, see the explicit instantiations in MatrixMultiplyTiled.cpp
+        using TiledBlockSizes = BlockSizeList<10, 16, 32, 50, 64, 100, 128>;
+
+        // candidates for the base case of MatMultCacheObliviousOptimized, instantiated in MatrixMultiplyCacheOblivious.cpp
+        using CacheObliviousBlockSizes = BlockSizeList<16, 32, 64>;
+
+        // candidate crossovers for MatMultStrassen, a runtime parameter so nothing is instantiated for these
+        using StrassenCrossovers = BlockSizeList<256, 512, 1024, 2048>;
+
+        /** calls func(std::integral_constant<int, block_size>()) if block_size is in the list
+         *
+         * \return false if block_size is not one of the candidates
+         */
+        template <typename Func, int... Sizes>
+        bool DispatchBlockSize(BlockSizeList<Sizes...>, int block_size, Func&& func) {
+            return ((block_size == Sizes ? (func(std::integral_constant<int, Sizes>()), true) : false) || ...);
+        }
+
+        /** the position of block_size in the list, for indexing the per block size kernels of a KernelTable
+         *
+         * \return -1 if block_size is not one of the candidates
+         */
+        template <int... Sizes>
+        constexpr int BlockSizeIndex(BlockSizeList<Sizes...>, int block_size) {
+            const int sizes[] = {Sizes...};
+            for (int i = 0; i < static_cast<int>(sizeof...(Sizes)); i++) {
+                if (sizes[i] == block_size) return i;
+            }
+            return -1;
+        }
+
+        /** calls func(std::integral_constant<int, size>()) for every block size in the list
+         */
+        template <typename Func, int... Sizes>
+        void ForEachBlockSize(BlockSizeList<Sizes...>, Func&& func) {
+            (func(std::integral_constant<int, Sizes>()), ...);
+        }
+
+        /** the tuning file used when none is given on the command line
+         */
+        extern const char* const default_tuning_file;
+
+        /** the class of problem sizes a tuned block size applies to. each dimension is
+         *  rounded up to a power of two, so a 750x750x750 product is class "1024x1024x1024"
+         */
+        std::string ShapeClass(uint64_t rows, uint64_t cols, uint64_t k);
+
+        /** the kernels with a tuned block size
+         */
+        enum class TunedKernel {
+            Tiled,
+            TiledOptimized,
+            CacheObliviousOptimized,
+            Strassen
+        };
+
+        /** the name of a tuned kernel in the tuning file, ie "MatMultTiled"
+         */
+        const char* TunedKernelName(TunedKernel kernel);
+
+        /** Block sizes picked by the autotuner, keyed by (cpu model, kernel, shape class).
+         *  Entries for every cpu model are kept so one tuning file can serve a mixed fleet,
+         *  lookups only ever match the cpu the program is running on. Load and Set publish an
+         *  immutable snapshot of this cpu's entries keyed by numbers, so the kernels look up
+         *  their block size on every call without taking a lock or building strings
+         */
+        class TuningCache {
+        public:
+            /** the cache the kernels consult
+             */
+            static TuningCache& Instance();
+
+            /** merges the entries of a tuning file into the cache. throws std::runtime_error,
+             *  leaving the cache alone, if any line of the file is malformed
+             *
+             * \return false if the file could not be opened
+             */
+            bool Load(const std::string& path);
+
+            /** writes every entry of the cache to a tuning file
+             */
+            void Save(const std::string& path) const;
+
+            /** the tuned block size of a kernel for the shape class of rows x cols x k on this cpu
+             *
+             * \param fallback the block size returned when nothing has been tuned
+             */
+            int BlockSize(TunedKernel kernel, uint64_t rows, uint64_t cols, uint64_t k, int fallback) const;
+
+            void Set(TunedKernel kernel, const std::string& shape_class, int block_size);
+
+        private:
+            TuningCache();
+
+            using Key = std::tuple<std::string, std::string, std::string>; // (cpu model, kernel, shape class)
+
+            // this cpu's entries keyed by SnapshotKey and sorted by it
+            struct Snapshot {
+                std::vector<std::pair<uint64_t, int>> block_sizes;
+            };
+
+            /** the kernel and the log2 of every dimension of a shape class packed into one number
+             */
+            static uint64_t SnapshotKey(TunedKernel kernel, unsigned rows_log2, unsigned cols_log2, unsigned k_log2);
+
+            /** rebuilds the snapshot from _block_sizes, called with _mutex held
+             */
+            void Publish();
+
+            std::string _cpu_model;
+            std::map<Key, int> _block_sizes;
+            mutable std::mutex _mutex;
+
+            // every snapshot ever published stays alive, a lookup may still be reading an old one
+            std::vector<std::unique_ptr<const Snapshot>> _snapshots;
+            std::atomic<const Snapshot*> _snapshot;
+        };
+
+        /** times every candidate block size (or crossover) of the tunable kernels on each shape and stores
+         *  the fastest one for each (kernel, shape class) in TuningCache::Instance()
+         *
+         * \param shapes the (rows, cols, k) sizes to tune for
+         * \param num_iter the number of timed runs per candidate, the minimum is compared
+         */
+        void Autotune(const std::vector<std::array<uint64_t, 3>>& shapes, int num_iter);
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
+
+#endif // #ifndef MATRIX_MULTIPLY_AUTOTUNE_H
@@ -0,0 +1,180 @@
+/*
+MatrixMultiplyBaseline.cpp
+Evan Newman
+*/
+
+#include "MatrixMultiplyBaseline.h"
+
+// System
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Local
+#include "MatrixMultiplyKernels.h"
+
+#include "Util/CpuInfo.h"
+#include "Util/Stats.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        /* the baseline file is plain text with one entry per line
+         * cpu model <tab> kernel table <tab> kernel <tab> m <tab> n <tab> k <tab> samples separated by spaces
+         * lines starting with # are comments
+         */
+        std::vector<BaselineEntry> LoadBaseline(const std::string& path) {
+            std::ifstream file(path);
+            if (!file.is_open()) throw std::runtime_error("could not open baseline file " + path);
+
+            std::vector<BaselineEntry> entries;
+
+            std::string line;
+            while (std::getline(file, line)) {
+                if (line.empty() || line[0] == '#') continue;
+
+                std::istringstream fields(line);
+                BaselineEntry entry;
+                std::string m, n, k, samples;
+
+                if (!std::getline(fields, entry.cpu_model, '\t')
+                    || !std::getline(fields, entry.isa, '\t')
+                    || !std::getline(fields, entry.kernel, '\t')
+                    || !std::getline(fields, m, '\t')
+                    || !std::getline(fields, n, '\t')
+                    || !std::getline(fields, k, '\t')
+                    || !std::getline(fields, samples)) {
+                    throw std::runtime_error("malformed line in baseline file " + path + ": " + line);
+                }
+
+                try {
+                    entry.m = std::stoull(m);
+                    entry.n = std::stoull(n);
+                    entry.k = std::stoull(k);
+                } catch (const std::exception&) {
+                    throw std::runtime_error("malformed line in baseline file " + path + ": " + line);
+                }
+
+                std::istringstream values(samples);
+                double sample;
+                while (values >> sample) entry.samples.push_back(sample);
+
+                if (!values.eof() || entry.samples.empty()) {
+                    throw std::runtime_error("malformed line in baseline file " + path + ": " + line);
+                }
+
+                entries.push_back(std::move(entry));
+            }
+
+            return entries;
+        }
+
+        void SaveBaseline(const BenchmarkReport& report, const std::string& path) {
+            std::ofstream file(path);
+            if (!file.is_open()) throw std::runtime_error("could not open baseline file " + path + " for writing");
+
+            const std::string cpu_model = Util::CpuModelName();
+
+            file << "# OptimizationTests benchmark baseline, times in ms" << std::endl
+                 << "# cpu model\tkernel table\tkernel\tm\tn\tk\tsamples" << std::endl;
+
+            file.precision(9);
+
+            for (const BenchmarkResult& result : report.results) {
+                file << cpu_model << '\t' << Kernels().name << '\t' << result.kernel << '\t'
+                     << result.m << '\t' << result.n << '\t' << result.k << '\t';
+
+                for (size_t i = 0; i < result.samples.size(); i++) file << (i == 0 ? "" : " ") << result.samples[i];
+                file << std::endl;
+            }
+
+            if (!file) throw std::runtime_error("could not write baseline file " + path);
+        }
+
+        const char* BaselineVerdictName(BaselineVerdict verdict) {
+            switch (verdict) {
+                case BaselineVerdict::Missing: return "no baseline";
+                case BaselineVerdict::Unchanged: return "unchanged";
+                case BaselineVerdict::Faster: return "faster";
+                case BaselineVerdict::Slower: return "slower";
+            }
+
+            return "unknown";
+        }
+
+        std::vector<BaselineComparison> CompareToBaseline(const BenchmarkReport& report,
+                                                          const std::vector<BaselineEntry>& baseline,
+                                                          const BaselineOptions& options) {
+            const std::string cpu_model = Util::CpuModelName();
+
+            std::vector<BaselineComparison> comparisons;
+
+            for (const BenchmarkResult& result : report.results) {
+                BaselineComparison comparison;
+                comparison.kernel = result.kernel;
+                comparison.m = result.m;
+                comparison.n = result.n;
+                comparison.k = result.k;
+                comparison.median = result.stats.median;
+
+                // the last entry wins, so appending a newer run to a baseline file replaces the older one
+                const BaselineEntry* entry = nullptr;
+                for (const BaselineEntry& candidate : baseline) {
+                    if (candidate.cpu_model == cpu_model && candidate.isa == Kernels().name && candidate.kernel == result.kernel
+                        && candidate.m == result.m && candidate.n == result.n && candidate.k == result.k) {
+                        entry = &candidate;
+                    }
+                }
+
+                if (entry == nullptr || result.samples.empty()) {
+                    comparisons.push_back(comparison);
+                    continue;
+                }
+
+                comparison.baseline_median = Util::Summarize(entry->samples).median;
+                comparison.ratio = comparison.median/comparison.baseline_median;
+                comparison.ratio_interval = Util::BootstrapMedianRatio(entry->samples, result.samples, options.confidence);
+
+                const Util::RankSumTest test = Util::MannWhitneyU(entry->samples, result.samples);
+                const bool slower = comparison.ratio > 1.0;
+                comparison.p_value = slower ? test.p_greater : test.p_less;
+
+                comparison.verdict = BaselineVerdict::Unchanged;
+
+                if (comparison.p_value < options.alpha) {
+                    if (slower && comparison.ratio_interval.low > 1.0 && comparison.ratio > 1.0 + options.threshold) {
+                        comparison.verdict = BaselineVerdict::Slower;
+                    } else if (!slower && comparison.ratio_interval.high < 1.0 && comparison.ratio < 1.0 - options.threshold) {
+                        comparison.verdict = BaselineVerdict::Faster;
+                    }
+                }
+
+                comparisons.push_back(comparison);
+            }
+
+            return comparisons;
+        }
+
+        void WriteBaselineComparison(const std::vector<BaselineComparison>& comparisons, std::ostream& out) {
+            out << "-------- Baseline Comparison --------" << std::endl
+                << "kernel,m,n,k,baseline_median_ms,median_ms,ratio,ratio_low,ratio_high,p_value,verdict" << std::endl;
+
+            for (const BaselineComparison& comparison : comparisons) {
+                out << comparison.kernel << "," << comparison.m << "," << comparison.n << "," << comparison.k << ",";
+
+                if (comparison.verdict == BaselineVerdict::Missing) {
+                    out << "," << comparison.median << ",,,,," << BaselineVerdictName(comparison.verdict) << std::endl;
+                    continue;
+                }
+
+                out << comparison.baseline_median << "," << comparison.median << "," << comparison.ratio << ","
+                    << comparison.ratio_interval.low << "," << comparison.ratio_interval.high << ","
+                    << comparison.p_value << "," << BaselineVerdictName(comparison.verdict) << std::endl;
+            }
+        }
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
@@ -0,0 +1,94 @@
+/*
+MatrixMultiplyBaseline.h saved benchmark runs and regression checks against them
+Evan Newman
+*/
+
+#ifndef MATRIX_MULTIPLY_BASELINE_H
+#define MATRIX_MULTIPLY_BASELINE_H
+
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "MatrixMultiplyBenchmark.h"
+
+#include "Util/Stats.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        /** the timed runs of one kernel on one shape from an earlier benchmark, times in ms
+         */
+        struct BaselineEntry {
+            std::string cpu_model;
+            std::string isa;     // the name of the kernel table it ran with
+            std::string kernel;
+            uint64_t m;
+            uint64_t n;
+            uint64_t k;
+            std::vector<double> samples;
+        };
+
+        /** reads a baseline file written by SaveBaseline
+         *
+         * \return the entries, throws std::runtime_error if the file can't be read or a line is malformed
+         */
+        std::vector<BaselineEntry> LoadBaseline(const std::string& path);
+
+        /** writes every sample of a report to a baseline file, along with the cpu and
+         *  kernel table it ran on. throws std::runtime_error if the file can't be written
+         */
+        void SaveBaseline(const BenchmarkReport& report, const std::string& path);
+
+        struct BaselineOptions {
+            double alpha = 0.01;      // the largest one-sided p value that counts as a change
+            double threshold = 0.05;  // the smallest change of the median that counts, as a fraction
+            double confidence = 0.95; // of the bootstrap interval of the median ratio
+        };
+
+        enum class BaselineVerdict {
+            Missing,   // no baseline for this kernel and shape on this cpu and kernel table
+            Unchanged, // within the noise, or too small to matter
+            Faster,
+            Slower     // a regression
+        };
+
+        const char* BaselineVerdictName(BaselineVerdict verdict);
+
+        /** one result against its baseline
+         */
+        struct BaselineComparison {
+            std::string kernel;
+            uint64_t m;
+            uint64_t n;
+            uint64_t k;
+
+            BaselineVerdict verdict = BaselineVerdict::Missing;
+
+            double baseline_median = NAN;
+            double median = NAN;
+            double ratio = NAN;           // median/baseline_median, above 1 is slower
+            Util::Interval ratio_interval = {NAN, NAN};
+            double p_value = NAN;         // one-sided, in the direction the median moved
+        };
+
+        /** compares every result of a report with the samples of the same kernel and shape in a
+         *  baseline taken on the same cpu and kernel table. a result only counts as slower (or
+         *  faster) when all three agree: the rank sum test is significant at options.alpha, the
+         *  bootstrap interval of the median ratio excludes 1, and the median moved by more than
+         *  options.threshold. a single noisy run can pass one of these but rarely all of them
+         */
+        std::vector<BaselineComparison> CompareToBaseline(const BenchmarkReport& report,
+                                                          const std::vector<BaselineEntry>& baseline,
+                                                          const BaselineOptions& options = BaselineOptions());
+
+        /** writes the comparisons as comma separated lines with a title and header
+         */
+        void WriteBaselineComparison(const std::vector<BaselineComparison>& comparisons, std::ostream& out);
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
+
+#endif // #ifndef MATRIX_MULTIPLY_BASELINE_H
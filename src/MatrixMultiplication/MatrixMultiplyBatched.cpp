@@ -0,0 +1,47 @@
+/*
+MatrixMultiplyBatched.cpp
+Evan Newman
+*/
+
+#include "MatrixMultiplyBatched.h"
+
+// System
+#include <stdexcept>
+#include <cstdint>
+
+// Local
+#include "MatrixMultiplyKernels.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        namespace {
+
+            void CheckSizes(int rows, int cols, int k) {
+                if (rows < 0 || cols < 0 || k < 0) {
+                    throw std::invalid_argument("batched matrix sizes must not be negative");
+                }
+            }
+
+        } // namespace
+
+        void MatMultBatchedStrided(int rows, int cols, int k,
+                                   const float* a, int64_t stride_a,
+                                   const float* b, int64_t stride_b,
+                                   float* c, int64_t stride_c,
+                                   size_t batch_count) {
+            CheckSizes(rows, cols, k);
+            Kernels().batched_strided(rows, cols, k, a, stride_a, b, stride_b, c, stride_c, batch_count);
+        }
+
+        void MatMultBatched(int rows, int cols, int k,
+                            const float* const* a,
+                            const float* const* b,
+                            float* const* c,
+                            size_t batch_count) {
+            CheckSizes(rows, cols, k);
+            Kernels().batched(rows, cols, k, a, b, c, batch_count);
+        }
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
@@ -0,0 +1,60 @@
+/*
+MatrixMultiplyBatched.h
+Evan Newman
+*/
+
+#ifndef MATRIX_MULTIPLY_BATCHED_H
+#define MATRIX_MULTIPLY_BATCHED_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        /** Performs a[i]*b[i] = c[i] for a batch of small products that all have the same size.
+         *  Every matrix is column major and densely packed, ie its leading dimension is its
+         *  number of rows, like an Eigen::MatrixXf. The sizes are checked once for the whole batch.
+         *  Every shape with m, n and k multiples of 4 up to 32 runs through a fully unrolled
+         *  fixed size kernel. When m isn't a multiple of 8 and a, b and c of 8 products fit in
+         *  half of L1, groups of 8 products are interleaved and vectorized across the batch
+         *  instead. Other shapes with up to 32 rows get a kernel with only the rows fixed, and
+         *  the rest use a generic kernel
+         *
+         * \param rows the rows of every a and c
+         * \param cols the columns of every b and c
+         * \param k the columns of every a and rows of every b
+         * \param a the first a, a[i] starts at a + i*stride_a
+         * \param stride_a the distance in floats between consecutive a's
+         * \param b the first b, b[i] starts at b + i*stride_b
+         * \param stride_b the distance in floats between consecutive b's
+         * \param c the first c, c[i] starts at c + i*stride_c
+         * \param stride_c the distance in floats between consecutive c's
+         * \param batch_count the number of products
+         */
+        void MatMultBatchedStrided(int rows, int cols, int k,
+                                   const float* a, int64_t stride_a,
+                                   const float* b, int64_t stride_b,
+                                   float* c, int64_t stride_c,
+                                   size_t batch_count);
+
+        /** Performs a[i]*b[i] = c[i] like MatMultBatchedStrided for matrices anywhere in memory
+         *
+         * \param rows the rows of every a and c
+         * \param cols the columns of every b and c
+         * \param k the columns of every a and rows of every b
+         * \param a the array of batch_count pointers to the a matrices
+         * \param b the array of batch_count pointers to the b matrices
+         * \param c the array of batch_count pointers to the c matrices
+         * \param batch_count the number of products
+         */
+        void MatMultBatched(int rows, int cols, int k,
+                            const float* const* a,
+                            const float* const* b,
+                            float* const* c,
+                            size_t batch_count);
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
+
+#endif // #ifndef MATRIX_MULTIPLY_BATCHED_H
@@ -0,0 +1,334 @@
+/*
+MatrixMultiplyBatchedKernel.h the batched small matrix kernels, compiled once per instruction set
+Evan Newman
+*/
+
+/* only included by the MatrixMultiplyKernels*.cpp files, see MatrixMultiplyGemmKernel.h
+ */
+
+#ifndef MATRIX_MULTIPLY_BATCHED_KERNEL_H
+#define MATRIX_MULTIPLY_BATCHED_KERNEL_H
+
+#ifndef MATRIX_MULTIPLY_ISA
+#error "define MATRIX_MULTIPLY_ISA before including MatrixMultiplyBatchedKernel.h"
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+        namespace MATRIX_MULTIPLY_ISA {
+
+            namespace {
+
+                // products computed side by side by the interleaved kernel, one per float of a ymm register
+                constexpr int batch_lanes = 8;
+
+                /* accessors for the i-th matrices of a batch, so every kernel works on both batch layouts */
+                struct StridedBatch {
+                    const float* a;
+                    int64_t stride_a;
+                    const float* b;
+                    int64_t stride_b;
+                    float* c;
+                    int64_t stride_c;
+
+                    const float* A(size_t i) const { return a + i*stride_a; }
+                    const float* B(size_t i) const { return b + i*stride_b; }
+                    float* C(size_t i) const { return c + i*stride_c; }
+                };
+
+                struct PointerBatch {
+                    const float* const* a;
+                    const float* const* b;
+                    float* const* c;
+
+                    const float* A(size_t i) const { return a[i]; }
+                    const float* B(size_t i) const { return b[i]; }
+                    float* C(size_t i) const { return c[i]; }
+                };
+
+                /** c = a*b for one product with M known at compile time. each column of c is
+                 *  accumulated in registers and the row loop vectorizes. FixedKernel passes N and K
+                 *  as constants too, so once this is inlined the rest fully unrolls
+                 */
+                template <int M>
+                inline void ColumnKernel(int cols, int k, const float* a, const float* b, float* c) {
+#if defined(__AVX2__) && defined(__FMA__)
+                    if constexpr (M % 8 == 0) {
+                        constexpr int vectors = M/8;
+
+                        for (int col = 0; col < cols; col++) {
+                            __m256 sum[vectors];
+                            for (int v = 0; v < vectors; v++) sum[v] = _mm256_setzero_ps();
+
+                            for (int i = 0; i < k; i++) {
+                                const __m256 b_i = _mm256_broadcast_ss(b + i + col*k);
+                                for (int v = 0; v < vectors; v++) sum[v] = _mm256_fmadd_ps(_mm256_loadu_ps(a + 8*v + i*M), b_i, sum[v]);
+                            }
+
+                            for (int v = 0; v < vectors; v++) _mm256_storeu_ps(c + 8*v + col*M, sum[v]);
+                        }
+                        return;
+                    }
+#endif
+                    for (int col = 0; col < cols; col++) {
+                        float sum[M];
+                        for (int row = 0; row < M; row++) sum[row] = 0;
+
+                        for (int i = 0; i < k; i++) {
+                            const float b_i = b[i + col*k];
+                            for (int row = 0; row < M; row++) sum[row] += a[row + i*M]*b_i;
+                        }
+
+                        for (int row = 0; row < M; row++) c[row + col*M] = sum[row];
+                    }
+                }
+
+                /** c = a*b for one product with every size known at compile time
+                 */
+                template <int M, int N, int K>
+                inline void FixedKernel(const float* a, const float* b, float* c) {
+                    ColumnKernel<M>(N, K, a, b, c);
+                }
+
+#if defined(__AVX2__) && defined(__FMA__)
+                /** transposes the 8x8 block held in rows, in registers
+                 */
+                inline void Transpose8x8(__m256 rows[8]) {
+                    __m256 t[8];
+                    for (int i = 0; i < 4; i++) {
+                        t[2*i] = _mm256_unpacklo_ps(rows[2*i], rows[2*i + 1]);
+                        t[2*i + 1] = _mm256_unpackhi_ps(rows[2*i], rows[2*i + 1]);
+                    }
+
+                    __m256 u[8];
+                    for (int i = 0; i < 2; i++) {
+                        u[4*i] = _mm256_shuffle_ps(t[4*i], t[4*i + 2], 0x44);
+                        u[4*i + 1] = _mm256_shuffle_ps(t[4*i], t[4*i + 2], 0xEE);
+                        u[4*i + 2] = _mm256_shuffle_ps(t[4*i + 1], t[4*i + 3], 0x44);
+                        u[4*i + 3] = _mm256_shuffle_ps(t[4*i + 1], t[4*i + 3], 0xEE);
+                    }
+
+                    for (int i = 0; i < 4; i++) {
+                        rows[i] = _mm256_permute2f128_ps(u[i], u[i + 4], 0x20);
+                        rows[i + 4] = _mm256_permute2f128_ps(u[i], u[i + 4], 0x31);
+                    }
+                }
+
+                /** c = a*b for batch_lanes products at once. every block of 8 elements of the 8
+                 *  products is transposed in registers so one vector holds the same element of
+                 *  every product, then each multiply-add is a single instruction across the group.
+                 *  used when a column of c isn't a whole number of vectors
+                 */
+                template <int M, int N, int K, typename Batch>
+                inline void InterleavedKernel(const Batch& batch, size_t first) {
+                    static_assert((M*K) % batch_lanes == 0 && (K*N) % batch_lanes == 0 && (M*N) % batch_lanes == 0,
+                                  "the interleaved kernel transposes whole 8x8 blocks");
+
+                    __m256 a_lanes[M*K];
+                    __m256 b_lanes[K*N];
+                    __m256 c_lanes[M*N];
+
+                    for (int elem = 0; elem < M*K; elem += batch_lanes) {
+                        for (int lane = 0; lane < batch_lanes; lane++) a_lanes[elem + lane] = _mm256_loadu_ps(batch.A(first + lane) + elem);
+                        Transpose8x8(a_lanes + elem);
+                    }
+
+                    for (int elem = 0; elem < K*N; elem += batch_lanes) {
+                        for (int lane = 0; lane < batch_lanes; lane++) b_lanes[elem + lane] = _mm256_loadu_ps(batch.B(first + lane) + elem);
+                        Transpose8x8(b_lanes + elem);
+                    }
+
+                    for (int col = 0; col < N; col++) {
+                        for (int row = 0; row < M; row++) {
+                            __m256 sum = _mm256_mul_ps(a_lanes[row], b_lanes[col*K]);
+                            for (int i = 1; i < K; i++) sum = _mm256_fmadd_ps(a_lanes[row + i*M], b_lanes[i + col*K], sum);
+                            c_lanes[row + col*M] = sum;
+                        }
+                    }
+
+                    for (int elem = 0; elem < M*N; elem += batch_lanes) {
+                        Transpose8x8(c_lanes + elem);
+                        for (int lane = 0; lane < batch_lanes; lane++) _mm256_storeu_ps(batch.C(first + lane) + elem, c_lanes[elem + lane]);
+                    }
+                }
+#else
+                /** c = a*b for batch_lanes products at once. the matrices are interleaved so every
+                 *  element holds one value per product, then the lane loop of each multiply-add
+                 *  vectorizes across the group. used when a column isn't a whole number of vectors
+                 */
+                template <int M, int N, int K, typename Batch>
+                inline void InterleavedKernel(const Batch& batch, size_t first) {
+                    float a_lanes[M*K][batch_lanes];
+                    float b_lanes[K*N][batch_lanes];
+                    float c_lanes[M*N][batch_lanes] = {};
+
+                    for (int lane = 0; lane < batch_lanes; lane++) {
+                        const float* a = batch.A(first + lane);
+                        const float* b = batch.B(first + lane);
+
+                        for (int elem = 0; elem < M*K; elem++) a_lanes[elem][lane] = a[elem];
+                        for (int elem = 0; elem < K*N; elem++) b_lanes[elem][lane] = b[elem];
+                    }
+
+                    for (int col = 0; col < N; col++) {
+                        for (int i = 0; i < K; i++) {
+                            for (int row = 0; row < M; row++) {
+                                for (int lane = 0; lane < batch_lanes; lane++) {
+                                    c_lanes[row + col*M][lane] += a_lanes[row + i*M][lane]*b_lanes[i + col*K][lane];
+                                }
+                            }
+                        }
+                    }
+
+                    for (int lane = 0; lane < batch_lanes; lane++) {
+                        float* c = batch.C(first + lane);
+                        for (int elem = 0; elem < M*N; elem++) c[elem] = c_lanes[elem][lane];
+                    }
+                }
+#endif
+
+                /** c = a*b for one product of any size
+                 */
+                inline void GenericKernel(int rows, int cols, int k, const float* a, const float* b, float* c) {
+                    // columns shorter than a vector are summed in a fixed size column so the
+                    // compiler doesn't vectorize the short runtime loops with gathers
+                    if (rows < batch_lanes) {
+                        for (int col = 0; col < cols; col++) {
+                            float sum[batch_lanes] = {};
+
+                            for (int i = 0; i < k; i++) {
+                                const float b_i = b[i + col*k];
+                                const float* a_col = a + i*rows;
+
+                                for (int row = 0; row < batch_lanes; row++) sum[row] += (row < rows ? a_col[row] : 0.0f)*b_i;
+                            }
+
+                            for (int row = 0; row < rows; row++) c[row + col*rows] = sum[row];
+                        }
+                        return;
+                    }
+
+                    for (int col = 0; col < cols; col++) {
+                        float* c_col = c + col*rows;
+                        for (int row = 0; row < rows; row++) c_col[row] = 0;
+
+                        for (int i = 0; i < k; i++) {
+                            const float b_i = b[i + col*k];
+                            const float* a_col = a + i*rows;
+
+                            for (int row = 0; row < rows; row++) c_col[row] += a_col[row]*b_i;
+                        }
+                    }
+                }
+
+                // the sizes with fixed kernels for every m, n and k, multiples of fixed_step up to max_fixed
+                constexpr int fixed_step = 4;
+                constexpr int max_fixed = 32;
+                constexpr int fixed_sizes = max_fixed/fixed_step;
+
+                // up to this many rows the row count alone is fixed for any other shape
+                constexpr int max_fixed_rows = 32;
+
+                /* the interleaved kernel keeps a, b and c of batch_lanes products on the stack, they
+                 * have to fit in half of a 32 KB L1 next to the matrices they're loaded from and stored to
+                 */
+                constexpr size_t max_interleaved_bytes = 16*1024;
+
+                template <int M, int N, int K>
+                constexpr bool fits_interleaved = size_t(M*K + K*N + M*N)*batch_lanes*sizeof(float) <= max_interleaved_bytes;
+
+                template <int M, int N, int K, typename Batch>
+                void RunFixed(const Batch& batch, size_t batch_count) {
+                    size_t i = 0;
+
+                    // columns that aren't whole vectors leave lanes idle, so vectorize across the batch instead
+                    if constexpr (M % batch_lanes != 0 && fits_interleaved<M, N, K>) {
+                        for (; i + batch_lanes <= batch_count; i += batch_lanes) InterleavedKernel<M, N, K>(batch, i);
+                    }
+
+                    for (; i < batch_count; i++) FixedKernel<M, N, K>(batch.A(i), batch.B(i), batch.C(i));
+                }
+
+                template <int M, typename Batch>
+                void RunFixedRows(int cols, int k, const Batch& batch, size_t batch_count) {
+                    for (size_t i = 0; i < batch_count; i++) ColumnKernel<M>(cols, k, batch.A(i), batch.B(i), batch.C(i));
+                }
+
+                template <typename Batch>
+                using RunFixedFunc = void (*)(const Batch&, size_t);
+
+                template <typename Batch>
+                using RunFixedRowsFunc = void (*)(int, int, const Batch&, size_t);
+
+                /* the fixed kernels indexed by ((m/fixed_step - 1)*fixed_sizes + n/fixed_step - 1)*fixed_sizes + k/fixed_step - 1,
+                 * and the fixed row kernels by m - 1. plain arrays, see MatrixMultiplyGemmKernel.h about inline library code
+                 */
+                template <typename Batch>
+                struct FixedTable {
+                    RunFixedFunc<Batch> fixed[fixed_sizes*fixed_sizes*fixed_sizes];
+                    RunFixedRowsFunc<Batch> rows[max_fixed_rows];
+                };
+
+                template <typename Batch, size_t... Fixed, size_t... Rows>
+                constexpr FixedTable<Batch> MakeFixedTable(std::index_sequence<Fixed...>, std::index_sequence<Rows...>) {
+                    return {
+                        {&RunFixed<fixed_step*(int(Fixed)/(fixed_sizes*fixed_sizes) + 1),
+                                   fixed_step*(int(Fixed)/fixed_sizes%fixed_sizes + 1),
+                                   fixed_step*(int(Fixed)%fixed_sizes + 1), Batch>...},
+                        {&RunFixedRows<int(Rows) + 1, Batch>...}
+                    };
+                }
+
+                template <typename Batch>
+                constexpr FixedTable<Batch> fixed_table = MakeFixedTable<Batch>(
+                    std::make_index_sequence<fixed_sizes*fixed_sizes*fixed_sizes>(), std::make_index_sequence<max_fixed_rows>());
+
+                bool IsFixedSize(int size) {
+                    return size > 0 && size <= max_fixed && size % fixed_step == 0;
+                }
+
+                template <typename Batch>
+                void RunBatch(int rows, int cols, int k, const Batch& batch, size_t batch_count) {
+                    if (IsFixedSize(rows) && IsFixedSize(cols) && IsFixedSize(k)) {
+                        const int index = ((rows/fixed_step - 1)*fixed_sizes + cols/fixed_step - 1)*fixed_sizes + k/fixed_step - 1;
+                        fixed_table<Batch>.fixed[index](batch, batch_count);
+                        return;
+                    }
+
+                    if (rows > 0 && rows <= max_fixed_rows) {
+                        fixed_table<Batch>.rows[rows - 1](cols, k, batch, batch_count);
+                        return;
+                    }
+
+                    for (size_t i = 0; i < batch_count; i++) GenericKernel(rows, cols, k, batch.A(i), batch.B(i), batch.C(i));
+                }
+
+                void BatchedStridedKernel(int rows, int cols, int k,
+                                          const float* a, int64_t stride_a,
+                                          const float* b, int64_t stride_b,
+                                          float* c, int64_t stride_c,
+                                          size_t batch_count) {
+                    RunBatch(rows, cols, k, StridedBatch{a, stride_a, b, stride_b, c, stride_c}, batch_count);
+                }
+
+                void BatchedKernel(int rows, int cols, int k,
+                                   const float* const* a, const float* const* b, float* const* c,
+                                   size_t batch_count) {
+                    RunBatch(rows, cols, k, PointerBatch{a, b, c}, batch_count);
+                }
+
+            } // namespace
+
+        } // namespace MATRIX_MULTIPLY_ISA
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
+
+#endif // #ifndef MATRIX_MULTIPLY_BATCHED_KERNEL_H
@@ -0,0 +1,435 @@
+/*
+MatrixMultiplyBenchmark.cpp
+Evan Newman
+*/
+
+#include "MatrixMultiplyBenchmark.h"
+
+// System
+#include <stdexcept>
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Libraries
+#include <eigen3/Eigen/Core>
+
+// Local
+#include "MatrixMultiplySimple.h"
+#include "MatrixMultiplyTiled.h"
+#include "MatrixMultiplyCacheOblivious.h"
+#include "MatrixMultiplyFastest.h"
+#include "MatrixMultiplyStrassen.h"
+#include "MatrixMultiplyPlanner.h"
+#include "MatrixMultiplyNuma.h"
+#include "MatrixMultiplyKernels.h"
+#include "MatrixMultiplyRoofline.h"
+#include "MatrixMultiplyVerify.h"
+
+#include "Util/CpuInfo.h"
+#include "Util/PerfCounters.h"
+#include "Util/Stats.h"
+#include "Util/ThreadPool.h"
+#include "Util/Timer.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        namespace {
+
+            /** parses one dimension of a shape, a number or a range first:last:step
+             */
+            bool ParseDimension(const std::string& text, std::vector<uint64_t>& values) {
+                std::vector<std::string> parts;
+                std::stringstream stream(text);
+                std::string part;
+                while (std::getline(stream, part, ':')) parts.push_back(part);
+
+                auto ParseNumber = [](const std::string& number, uint64_t& value) {
+                    if (number.empty() || number.find_first_not_of("0123456789") != std::string::npos) return false;
+                    value = std::stoull(number);
+                    return true;
+                };
+
+                uint64_t first, last, step;
+
+                if (parts.size() == 1) {
+                    if (!ParseNumber(parts[0], first)) return false;
+                    values.push_back(first);
+                    return true;
+                }
+
+                if (parts.size() != 3 || !ParseNumber(parts[0], first) || !ParseNumber(parts[1], last)) return false;
+
+                const bool geometric = !parts[2].empty() && parts[2][0] == '*';
+                if (!ParseNumber(geometric ? parts[2].substr(1) : parts[2], step)) return false;
+
+                // a step that goes nowhere would never end
+                if (first > last || (geometric ? step < 2 || first == 0 : step == 0)) return false;
+
+                for (uint64_t value = first; value <= last; value = geometric ? value*step : value + step) {
+                    values.push_back(value);
+                }
+                return true;
+            }
+
+            std::string JsonString(const std::string& text) {
+                std::string quoted = "\"";
+                for (char ch : text) {
+                    if (ch == '"' || ch == '\\') quoted += '\\';
+                    if (static_cast<unsigned char>(ch) >= 0x20) quoted += ch;
+                }
+                return quoted + "\"";
+            }
+
+            // the misses reported per flop, as well as their counts
+            constexpr Util::PerfEvent per_flop_events[] = {
+                Util::PerfEvent::L1dMisses, Util::PerfEvent::LlcMisses, Util::PerfEvent::DtlbMisses
+            };
+
+            // a column that may be missing, written as missing when value is nan
+            std::string CounterField(double value, const char* missing) {
+                if (std::isnan(value)) return missing;
+
+                std::ostringstream field;
+                field << value;
+                return field.str();
+            }
+
+            void WriteHeader(BenchmarkFormat format, const BenchmarkReport& report, std::ostream& out) {
+                if (format == BenchmarkFormat::Json) return;
+
+                if (format == BenchmarkFormat::Text) {
+                    out << "-------- MatrixMultiply Benchmark --------" << std::endl
+                        << "Kernels: " << Kernels().name << " (" << Util::CpuModelName() << "), verified by "
+                        << VerifyModeName(report.verify) << std::endl;
+
+                    if (report.has_roofline) {
+                        const Roofline& roofline = report.roofline;
+                        out << "Roofline: peak " << roofline.peak_gflops_thread << " GFLOP/s, bandwidth " << roofline.bandwidth_gbs_thread
+                            << " GB/s on one thread, peak " << roofline.peak_gflops << " GFLOP/s, bandwidth " << roofline.bandwidth_gbs
+                            << " GB/s on " << roofline.threads << " threads" << std::endl;
+                    }
+                }
+
+                out << "kernel,m,n,k,iterations,min_ms,median_ms,p90_ms,p99_ms,max_ms,mean_ms,stddev_ms,gflops,bandwidth_gbs,result,relative_error";
+
+                if (report.counters) {
+                    for (size_t i = 0; i < Util::num_perf_events; i++) out << "," << Util::PerfEventName(static_cast<Util::PerfEvent>(i));
+                    out << ",ipc";
+                    for (Util::PerfEvent event : per_flop_events) out << "," << Util::PerfEventName(event) << "_per_flop";
+                }
+
+                if (report.has_roofline) out << ",intensity,attainable_gflops,roof_fraction,peak_fraction";
+
+                out << std::endl;
+            }
+
+            void WriteRow(const BenchmarkResult& result, const BenchmarkReport& report, std::ostream& out) {
+                const Util::SampleStats& stats = result.stats;
+
+                out << result.kernel << "," << result.m << "," << result.n << "," << result.k << "," << stats.count << ","
+                    << stats.min << "," << stats.median << "," << stats.p90 << "," << stats.p99 << "," << stats.max << ","
+                    << stats.mean << "," << stats.stddev << "," << result.gflops << "," << result.bandwidth_gbs << ","
+                    << (result.ok ? "ok" : "error") << "," << result.relative_error;
+
+                if (report.counters) {
+                    for (size_t i = 0; i < Util::num_perf_events; i++) {
+                        const Util::PerfEvent event = static_cast<Util::PerfEvent>(i);
+                        out << "," << CounterField(result.counters.Valid(event) ? result.counters.Value(event) : NAN, "");
+                    }
+
+                    out << "," << CounterField(result.Ipc(), "");
+                    for (Util::PerfEvent event : per_flop_events) out << "," << CounterField(result.MissesPerFlop(event), "");
+                }
+
+                if (report.has_roofline) {
+                    out << "," << result.intensity << "," << CounterField(result.attainable_gflops, "") << ","
+                        << CounterField(result.roof_fraction, "") << "," << CounterField(result.peak_fraction, "");
+                }
+
+                out << std::endl;
+            }
+
+            void WriteJson(const BenchmarkReport& report, std::ostream& out) {
+                out << "{" << std::endl
+                    << "  \"cpu\": " << JsonString(Util::CpuModelName()) << "," << std::endl
+                    << "  \"kernels\": " << JsonString(Kernels().name) << "," << std::endl
+                    << "  \"threads\": " << std::thread::hardware_concurrency() << "," << std::endl
+                    << "  \"verify\": " << JsonString(VerifyModeName(report.verify)) << "," << std::endl;
+
+                if (report.has_roofline) {
+                    const Roofline& roofline = report.roofline;
+                    out << "  \"roofline\": {\"threads\": " << roofline.threads
+                        << ", \"peak_gflops_thread\": " << roofline.peak_gflops_thread << ", \"peak_gflops\": " << roofline.peak_gflops
+                        << ", \"bandwidth_gbs_thread\": " << roofline.bandwidth_gbs_thread << ", \"bandwidth_gbs\": " << roofline.bandwidth_gbs
+                        << "}," << std::endl;
+                }
+
+                out << "  \"results\": [";
+
+                for (size_t i = 0; i < report.results.size(); i++) {
+                    const BenchmarkResult& result = report.results[i];
+                    const Util::SampleStats& stats = result.stats;
+
+                    out << (i == 0 ? "" : ",") << std::endl
+                        << "    {\"kernel\": " << JsonString(result.kernel)
+                        << ", \"m\": " << result.m << ", \"n\": " << result.n << ", \"k\": " << result.k
+                        << ", \"iterations\": " << stats.count
+                        << ", \"min_ms\": " << stats.min << ", \"median_ms\": " << stats.median
+                        << ", \"p90_ms\": " << stats.p90 << ", \"p99_ms\": " << stats.p99
+                        << ", \"max_ms\": " << stats.max << ", \"mean_ms\": " << stats.mean << ", \"stddev_ms\": " << stats.stddev
+                        << ", \"gflops\": " << result.gflops << ", \"bandwidth_gbs\": " << result.bandwidth_gbs
+                        << ", \"ok\": " << (result.ok ? "true" : "false") << ", \"relative_error\": " << result.relative_error
+                        << ", \"intensity\": " << result.intensity;
+
+                    if (result.counted) {
+                        out << ", \"counters\": {";
+                        for (size_t e = 0; e < Util::num_perf_events; e++) {
+                            const Util::PerfEvent event = static_cast<Util::PerfEvent>(e);
+                            out << (e == 0 ? "" : ", ") << JsonString(Util::PerfEventName(event)) << ": "
+                                << CounterField(result.counters.Valid(event) ? result.counters.Value(event) : NAN, "null");
+                        }
+
+                        out << ", \"ipc\": " << CounterField(result.Ipc(), "null");
+                        for (Util::PerfEvent event : per_flop_events) {
+                            out << ", " << JsonString(std::string(Util::PerfEventName(event)) + "_per_flop") << ": "
+                                << CounterField(result.MissesPerFlop(event), "null");
+                        }
+                        out << "}";
+                    }
+
+                    if (report.has_roofline) {
+                        out << ", \"attainable_gflops\": " << CounterField(result.attainable_gflops, "null")
+                            << ", \"roof_fraction\": " << CounterField(result.roof_fraction, "null")
+                            << ", \"peak_fraction\": " << CounterField(result.peak_fraction, "null");
+                    }
+
+                    out << ", \"samples_ms\": [";
+
+                    for (size_t s = 0; s < result.samples.size(); s++) out << (s == 0 ? "" : ", ") << result.samples[s];
+                    out << "]}";
+                }
+
+                out << std::endl << "  ]" << std::endl << "}" << std::endl;
+            }
+
+        } // namespace
+
+        double BenchmarkResult::Ipc() const {
+            if (!counters.Valid(Util::PerfEvent::Cycles) || !counters.Valid(Util::PerfEvent::Instructions)) return NAN;
+            if (counters.Value(Util::PerfEvent::Cycles) == 0.0) return NAN;
+
+            return counters.Value(Util::PerfEvent::Instructions)/counters.Value(Util::PerfEvent::Cycles);
+        }
+
+        double BenchmarkResult::MissesPerFlop(Util::PerfEvent event) const {
+            const double flops = 2.0*m*n*k;
+            if (!counters.Valid(event) || flops == 0.0) return NAN;
+
+            return counters.Value(event)/flops;
+        }
+
+        const std::vector<BenchmarkKernel>& BenchmarkKernels() {
+            using Matrix = Eigen::MatrixXf;
+
+            static const std::vector<BenchmarkKernel> kernels = {
+                {"simple", [](const Matrix& a, const Matrix& b, Matrix& c) { MatMultSimple(a, b, c); }, false, false},
+                {"simple_optimized", [](const Matrix& a, const Matrix& b, Matrix& c) { MatMultSimpleOptimized(a, b, c); }, false, false},
+                {"tiled", [](const Matrix& a, const Matrix& b, Matrix& c) { MatMultTiled(a, b, c); }, false, false},
+                {"tiled_optimized", [](const Matrix& a, const Matrix& b, Matrix& c) { MatMultTiledOptimized(a, b, c); }, false, true},
+                {"tiled_parallel", [](const Matrix& a, const Matrix& b, Matrix& c) { MatMultTiledParallel(a, b, c); }, true, true},
+                {"cache_oblivious", [](const Matrix& a, const Matrix& b, Matrix& c) { MatMultCacheOblivious(a, b, c); }, false, false},
+                {"cache_oblivious_optimized", [](const Matrix& a, const Matrix& b, Matrix& c) { MatMultCacheObliviousOptimized(a, b, c); }, true, true},
+                {"fastest", [](const Matrix& a, const Matrix& b, Matrix& c) { MatMultFastest(a, b, c); }, false, true},
+                {"strassen", [](const Matrix& a, const Matrix& b, Matrix& c) { MatMultStrassen(a, b, c); }, false, true},
+                {"matmult", [](const Matrix& a, const Matrix& b, Matrix& c) { MatMult(a, b, c); }, false, true},
+                {"numa", [](const Matrix& a, const Matrix& b, Matrix& c) {
+                    static Util::ThreadPool pool(0, Util::ThreadPool::Pinning::Nodes);
+                    MatMultNuma(a, b, c, pool);
+                }, true, false},
+                {"eigen", [](const Matrix& a, const Matrix& b, Matrix& c) { c.noalias() = a*b; }, false, true}
+            };
+
+            return kernels;
+        }
+
+        bool ParseShapes(const std::string& text, std::vector<std::array<uint64_t, 3>>& shapes) {
+            std::vector<std::array<uint64_t, 3>> parsed;
+
+            std::stringstream list(text);
+            std::string shape;
+            while (std::getline(list, shape, ',')) {
+                std::vector<uint64_t> dims[3];
+
+                std::stringstream stream(shape);
+                std::string dim;
+                int count = 0;
+                while (std::getline(stream, dim, 'x')) {
+                    if (count == 3 || !ParseDimension(dim, dims[count])) return false;
+                    count++;
+                }
+                if (count != 3) return false;
+
+                for (uint64_t m : dims[0]) {
+                    for (uint64_t n : dims[1]) {
+                        for (uint64_t k : dims[2]) parsed.push_back({m, n, k});
+                    }
+                }
+            }
+
+            if (parsed.empty()) return false;
+
+            shapes.insert(shapes.end(), parsed.begin(), parsed.end());
+            return true;
+        }
+
+        bool ParseBenchmarkFormat(const std::string& text, BenchmarkFormat& format) {
+            if (text == "text") format = BenchmarkFormat::Text;
+            else if (text == "csv") format = BenchmarkFormat::Csv;
+            else if (text == "json") format = BenchmarkFormat::Json;
+            else return false;
+
+            return true;
+        }
+
+        BenchmarkReport RunBenchmark(const BenchmarkOptions& options, std::ostream* progress) {
+            // look every name up before timing anything, so a typo doesn't cost a whole sweep
+            std::vector<const BenchmarkKernel*> kernels;
+            for (const BenchmarkKernel& kernel : BenchmarkKernels()) {
+                if (options.kernels.empty() && kernel.by_default) kernels.push_back(&kernel);
+            }
+
+            for (const std::string& name : options.kernels) {
+                auto kernel = std::find_if(BenchmarkKernels().begin(), BenchmarkKernels().end(),
+                                           [&](const BenchmarkKernel& candidate) { return candidate.name == name; });
+                if (kernel == BenchmarkKernels().end()) throw std::invalid_argument("there is no kernel called " + name);
+
+                kernels.push_back(&*kernel);
+            }
+
+            // opened once for the whole run, whatever can't be opened is left out of every result
+            std::unique_ptr<Util::PerfCounters> counters;
+            if (options.counters) {
+                counters = std::make_unique<Util::PerfCounters>();
+
+                if (progress != nullptr && options.format == BenchmarkFormat::Text && !counters->Error().empty()) {
+                    *progress << "some performance counters are unavailable (" << counters->Error() << ")" << std::endl;
+                }
+            }
+
+            BenchmarkReport report;
+            report.verify = options.verify;
+            report.counters = options.counters;
+
+            // measured before anything else runs, so nothing the kernels leave behind slows it down
+            if (options.roofline) {
+                report.has_roofline = true;
+                report.roofline = MeasureRoofline();
+            }
+
+            if (progress != nullptr) WriteHeader(options.format, report, *progress);
+
+            Util::Timer timer;
+            timer.AttachCounters(counters.get());
+
+            for (const std::array<uint64_t, 3>& shape : options.shapes) {
+                const uint64_t m = shape[0];
+                const uint64_t n = shape[1];
+                const uint64_t k = shape[2];
+
+                Eigen::MatrixXf a = Eigen::MatrixXf::Random(m, k);
+                Eigen::MatrixXf b = Eigen::MatrixXf::Random(k, n);
+                Eigen::MatrixXf c(m, n);
+
+                // only computed when asked for, at large sizes it costs more than the kernels
+                Eigen::MatrixXf c_reference;
+                if (options.verify == VerifyMode::Reference) c_reference = a*b;
+
+                const double flops = 2.0*m*n*k;
+                const double bytes = sizeof(float)*(m*k + k*n + 2.0*m*n);
+
+                for (const BenchmarkKernel* kernel : kernels) {
+                    for (int i = 0; i < options.warmup; i++) kernel->run(a, b, c);
+
+                    timer.Reset();
+                    for (int i = 0; i < options.iterations; i++) {
+                        timer.Start();
+                        kernel->run(a, b, c);
+                        timer.Stop();
+                    }
+
+                    BenchmarkResult result;
+                    result.kernel = kernel->name;
+                    result.m = m;
+                    result.n = n;
+                    result.k = k;
+                    result.samples = timer.Samples();
+                    result.stats = Util::Summarize(result.samples);
+
+                    const double seconds = result.stats.median*1e-3;
+                    result.gflops = seconds > 0.0 ? flops/seconds*1e-9 : 0.0;
+                    result.bandwidth_gbs = seconds > 0.0 ? bytes/seconds*1e-9 : 0.0;
+
+                    const Verification verification = options.verify == VerifyMode::Reference ? VerifyReference(c, c_reference)
+                                                                                                : VerifyFreivalds(a, b, c);
+                    result.ok = verification.ok;
+                    result.relative_error = verification.relative_error;
+
+                    if (counters != nullptr) {
+                        result.counted = true;
+
+                        const std::vector<Util::PerfSample>& runs = timer.CounterSamples();
+                        for (size_t e = 0; e < Util::num_perf_events; e++) {
+                            bool valid = !runs.empty();
+                            double sum = 0.0;
+                            for (const Util::PerfSample& run : runs) {
+                                valid = valid && run.valid[e];
+                                sum += run.values[e];
+                            }
+
+                            result.counters.valid[e] = valid;
+                            result.counters.values[e] = valid ? sum/runs.size() : 0.0;
+                        }
+                    }
+
+                    result.intensity = ArithmeticIntensity(m, n, k);
+                    result.parallel = kernel->parallel;
+
+                    if (report.has_roofline) {
+                        const double peak = kernel->parallel ? report.roofline.peak_gflops : report.roofline.peak_gflops_thread;
+
+                        result.attainable_gflops = report.roofline.Attainable(result.intensity, kernel->parallel);
+                        result.roof_fraction = result.attainable_gflops > 0.0 ? result.gflops/result.attainable_gflops : NAN;
+                        result.peak_fraction = peak > 0.0 ? result.gflops/peak : NAN;
+                    }
+
+                    if (progress != nullptr && options.format != BenchmarkFormat::Json) WriteRow(result, report, *progress);
+                    report.results.push_back(std::move(result));
+                }
+            }
+
+            if (progress != nullptr && options.format == BenchmarkFormat::Json) WriteJson(report, *progress);
+
+            return report;
+        }
+
+        void WriteBenchmarkReport(const BenchmarkReport& report, BenchmarkFormat format, std::ostream& out) {
+            if (format == BenchmarkFormat::Json) {
+                WriteJson(report, out);
+                return;
+            }
+
+            WriteHeader(format, report, out);
+            for (const BenchmarkResult& result : report.results) WriteRow(result, report, out);
+        }
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
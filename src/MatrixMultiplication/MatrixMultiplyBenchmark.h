@@ -0,0 +1,139 @@
+/*
+MatrixMultiplyBenchmark.h the command line benchmark harness for the matrix multiply kernels
+Evan Newman
+*/
+
+#ifndef MATRIX_MULTIPLY_BENCHMARK_H
+#define MATRIX_MULTIPLY_BENCHMARK_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <eigen3/Eigen/Core>
+
+#include "MatrixMultiplyRoofline.h"
+#include "MatrixMultiplyVerify.h"
+
+#include "Util/PerfCounters.h"
+#include "Util/Stats.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        /** a kernel the harness can time, run computes c = a*b
+         */
+        struct BenchmarkKernel {
+            std::string name;
+            std::function<void(const Eigen::MatrixXf& a, const Eigen::MatrixXf& b, Eigen::MatrixXf& c)> run;
+            bool parallel;   // runs on every hardware thread, so it is held to the machine's ceilings
+            bool by_default; // timed when no kernels are named on the command line
+        };
+
+        /** every kernel the harness knows, by the name used on the command line
+         */
+        const std::vector<BenchmarkKernel>& BenchmarkKernels();
+
+        enum class BenchmarkFormat {
+            Text, // the same comma separated lines as the rest of the tests, with a title
+            Csv,  // a header line and one line per result, nothing else
+            Json  // one object with the machine and an array of results
+        };
+
+        struct BenchmarkOptions {
+            std::vector<std::array<uint64_t, 3>> shapes; // (m, n, k), c is m x n
+            std::vector<std::string> kernels;            // empty for the default ones
+            int warmup = 3;                              // untimed runs before the timed ones
+            int iterations = 20;                         // timed runs, every one is kept
+            BenchmarkFormat format = BenchmarkFormat::Text;
+            bool counters = false;                       // read the hardware counters around every timed run
+            bool roofline = false;                       // measure the machine's ceilings and place every result under them
+            VerifyMode verify = VerifyMode::Freivalds;   // how every result is checked, the reference product is O(mnk)
+        };
+
+        /** one kernel on one shape, times in ms
+         */
+        struct BenchmarkResult {
+            std::string kernel;
+            uint64_t m;
+            uint64_t n;
+            uint64_t k;
+
+            std::vector<double> samples;
+            Util::SampleStats stats;
+
+            double gflops;         // 2*m*n*k flops at the median time
+            double bandwidth_gbs;  // the compulsory traffic (a and b read, c read and written once) at the median time
+
+            bool ok;
+            double relative_error; // against a*b in the frobenius norm, see Verification
+
+            // the mean counts of one run, an event is only valid if it was counted on every run
+            bool counted = false;
+            Util::PerfSample counters;
+
+            // instructions per cycle and misses per flop, nan when their events weren't counted
+            double Ipc() const;
+            double MissesPerFlop(Util::PerfEvent event) const;
+
+            // flops per byte of the compulsory traffic, see ArithmeticIntensity
+            double intensity;
+
+            // with a roofline, the attainable GFLOP/s at this intensity and the shares of it and of the peak reached, nan otherwise
+            bool parallel;
+            double attainable_gflops = NAN;
+            double roof_fraction = NAN;
+            double peak_fraction = NAN;
+        };
+
+        /** everything one run of the harness measured
+         */
+        struct BenchmarkReport {
+            std::vector<BenchmarkResult> results;
+
+            VerifyMode verify = VerifyMode::Freivalds;
+            bool counters = false;
+            bool has_roofline = false;
+            Roofline roofline = {};
+        };
+
+        /** parses a list of shapes like "750x750x750,100:1000:100x64x64". every dimension is a
+         *  number or a range first:last:step, which adds step each time or multiplies by it
+         *  when written *step (64:1024:*2). the shapes are every combination of the ranges
+         *
+         * \param text the shapes, separated by commas
+         * \param shapes the parsed shapes are appended here
+         *
+         * \return false if the text isn't a list of shapes
+         */
+        bool ParseShapes(const std::string& text, std::vector<std::array<uint64_t, 3>>& shapes);
+
+        /** parses text, csv or json
+         */
+        bool ParseBenchmarkFormat(const std::string& text, BenchmarkFormat& format);
+
+        /** times the kernels on every shape. every kernel gets the same random a and b for a
+         *  shape, runs warmup times untimed and then iterations times keeping every sample
+         *
+         * \param options what to time and how often
+         * \param progress if set, every result is written to it in options.format as soon as
+         *                 it is measured, json is only written once all of them are done. a
+         *                 note goes there too when counters were asked for but can't be read
+         *
+         * \return a result per kernel and shape, throws std::invalid_argument for a kernel
+         *         name that doesn't exist
+         */
+        BenchmarkReport RunBenchmark(const BenchmarkOptions& options, std::ostream* progress = nullptr);
+
+        /** writes a report in a format, the header (or for json the whole document) included
+         */
+        void WriteBenchmarkReport(const BenchmarkReport& report, BenchmarkFormat format, std::ostream& out);
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
+
+#endif // #ifndef MATRIX_MULTIPLY_BENCHMARK_H
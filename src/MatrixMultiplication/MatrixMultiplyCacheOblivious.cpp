@@ -3,28 +3,43 @@ MatrixMultiplyCacheOblivious.cpp
 Evan Newman
 */
 
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+
 #include <eigen3/Eigen/Core>
 
+#include "MatrixMultiplyCacheOblivious.h"
+#include "MatrixMultiplyAutotune.h"
+#include "MatrixMultiplyKernels.h"
+#include "Util/ThreadPool.h"
+#include "Util/Trace.h"
+
 namespace OptimizationTests {
     namespace MatrixMultiply {
 
         void MatMultCacheOblivious(const Eigen::Ref<const Eigen::MatrixXf> a,
                                    const Eigen::Ref<const Eigen::MatrixXf> b,
-                                   Eigen::Ref<Eigen::MatrixXf> c) {
+                                   Eigen::Ref<Eigen::MatrixXf> c,
+                                   Op op_a,
+                                   Op op_b) {
+
+            const Operand a_op(a, op_a);
+            const Operand b_op(b, op_b);
                           
             // Ensure the inputs are ok for matrix multiplication
-            if (a.rows() != c.rows()
-               || a.cols() != b.rows()
-               || b.cols() != c.cols()) {
+            if (a_op.rows != c.rows()
+               || a_op.cols != b_op.rows
+               || b_op.cols != c.cols()) {
                    throw std::invalid_argument("matrices a, b, and c have incompatible sizes");
             }
 
-            // grab the data pointers from eigen
-            const float* a_raw = a.data();
-            const float* b_raw = b.data();
+            // grab the data pointers from the operands
+            const float* a_raw = a_op.data;
+            const float* b_raw = b_op.data;
             float* c_raw = c.data();
 
-            for (uint64_t i = 0; i < c.rows()*c.cols(); i++) c_raw[i] = 0;
+            c.setZero();
 
             std::function<void(const float* a_raw_current, const float* b_raw_current, float* c_raw_current,
                                const uint64_t& row_size, const uint64_t& col_size, const uint64_t& k_size)> MatMultRecursive
@@ -74,16 +89,16 @@ namespace OptimizationTests {
 
                 /* calculate the offsets requred for each submatrix */
                 // k offsets
-                uint64_t a_k_offset = k_size_p1*a.rows();
-                uint64_t b_k_offset = k_size_p1;
+                uint64_t a_k_offset = k_size_p1*a_op.col_stride;
+                uint64_t b_k_offset = k_size_p1*b_op.row_stride;
 
                 // row offsets
-                uint64_t a_row_offset = row_size_p1;
+                uint64_t a_row_offset = row_size_p1*a_op.row_stride;
                 uint64_t c_row_offset = row_size_p1;
 
                 // col offsets
-                uint64_t c_col_offset = col_size_p1*c.rows();
-                uint64_t b_col_offset = col_size_p1*b.rows();
+                uint64_t c_col_offset = col_size_p1*c.outerStride();
+                uint64_t b_col_offset = col_size_p1*b_op.col_stride;
 
                 /* calculate the terms */
                 // c_11 += a_11*b_11
@@ -138,164 +153,237 @@ namespace OptimizationTests {
 
             // kickstart that recursion baby
             MatMultRecursive(a_raw, b_raw, c_raw,
-                             a.rows(), b.cols(), a.cols());
+                             a_op.rows, b_op.cols, a_op.cols);
         }
 
-        void MatMultCacheObliviousOptimized(const Eigen::Ref<const Eigen::MatrixXf> a,
-                                            const Eigen::Ref<const Eigen::MatrixXf> b,
-                                            Eigen::Ref<Eigen::MatrixXf> c) {
-
-            const uint64_t block_size = 10;
-                          
-            // Ensure the inputs are ok for matrix multiplication
-            if (a.rows() != c.rows()
-               || a.cols() != b.rows()
-               || b.cols() != c.cols()) {
-                   throw std::invalid_argument("matrices a, b, and c have incompatible sizes");
-            } 
+        namespace {
+
+            // below this many multiply-adds a product is not worth forking into tasks
+            constexpr uint64_t fork_threshold = 128*128*128;
+
+            // the strides of op(a) and op(b), the leading dimension of c and the leaf kernels, see MatrixMultiplyLoopKernel.h
+            struct RecursionContext {
+                int64_t a_rs;
+                int64_t a_cs;
+                int64_t b_rs;
+                int64_t b_cs;
+                int64_t ldc;
+                Util::ThreadPool& pool;
+                KernelTable::BlockKernel fixed_kernel;
+                decltype(KernelTable::oblivious_ragged) ragged_kernel;
+            };
 
-            if (a.rows() < block_size || a.cols() < block_size || b.cols() < block_size) {
-                throw std::invalid_argument("matrices a, b, and c must have dimensions larger than the block size " + std::to_string(block_size));
+            /** splits a dimension roughly in half with the first part rounded up to a multiple
+             *  of BlockSize. dimensions that already fit in a block are not split.
+             *  rounding the splits means nearly every leaf of the recursion is a full
+             *  BlockSize cube that runs through the fixed size kernel, only the edges are ragged
+             */
+            template <int BlockSize>
+            uint64_t SplitSize(uint64_t size) {
+                if (size <= BlockSize) return size;
+                return (size/2 + BlockSize - 1)/BlockSize*BlockSize;
             }
 
-            // grab the data pointers from eigen
-            const float* a_raw = a.data();
-            const float* b_raw = b.data();
-            float* c_raw = c.data();
+            template <int BlockSize>
+            void MatMultRecursive(const RecursionContext& ctx,
+                                  const float* a_raw_current, const float* b_raw_current, float* c_raw_current,
+                                  uint64_t row_size, uint64_t col_size, uint64_t k_size) {
 
-            for (uint64_t i = 0; i < c.rows()*c.cols(); i++) c_raw[i] = 0;
+                /* base cases */
+                // if any dimensions are 0, the partition is invalid
+                if (row_size == 0 || col_size == 0 || k_size == 0) {
+                    return;
+                }
 
-            auto MatMult = [&a, &b, &c](const float* a_raw_submatrix, const float* b_raw_submatrix, float* c_raw_submatrix,
-                                        const uint64_t& row_size, const uint64_t& col_size, const uint64_t& k_size){
-                
-                for (int c_col = 0; c_col < col_size; c_col++) { // for every column of c
-                    for (int c_row = 0; c_row < row_size; c_row++) { // for every row of c
-                        float sum = 0; // initialize the running sum to 0
+                // if all the dimensions fit in a block, multiply submatrix a and b at the current location
+                if (row_size <= BlockSize && col_size <= BlockSize && k_size <= BlockSize) {
+                    TRACE_ZONE(row_size == BlockSize ? "base block" : "ragged block");
 
-                        for (int k = 0; k < k_size; k++) { // for every column of a / row of b
-                            // multiply the element of a and the element of b and add the result to the current value of sum
-                            sum += a_raw_submatrix[c_row + k*a.rows()]*b_raw_submatrix[k + c_col*b.rows()];
+                    const float* a_block = a_raw_current;
+                    int64_t lda = ctx.a_cs;
+
+                    // the kernels want the columns of a contiguous, a transposed a is copied into a block first
+                    alignas(64) float a_packed[BlockSize*BlockSize];
+                    if (ctx.a_rs != 1) {
+                        TRACE_ZONE("pack a");
+
+                        for (uint64_t k = 0; k < k_size; k++) {
+                            for (uint64_t row = 0; row < row_size; row++) a_packed[row + k*BlockSize] = a_raw_current[row*ctx.a_rs + k*ctx.a_cs];
                         }
 
-                        // set the value of c to be the running sum
-                        c_raw_submatrix[c_row + c_col*c.rows()] += sum;
+                        a_block = a_packed;
+                        lda = BlockSize;
                     }
-                }
-            };
-
-            std::function<void(const float* a_raw_current, const float* b_raw_current, float* c_raw_current,
-                               const uint64_t& row_size, const uint64_t& col_size, const uint64_t& k_size)> MatMultRecursive
-                    = [&](const float* a_raw_current, const float* b_raw_current, float* c_raw_current, 
-                          const uint64_t& row_size, const uint64_t& col_size, const uint64_t& k_size) {
-                    
-                /* base cases */
-                // if any dimensions are 0, the partition is invalid
-                if (row_size == 0 || col_size == 0 || k_size == 0) {
-                    return;
 
-                } 
-                
-                // if all the dimensions are less than the block size, multiply submatrix a and b at the current location
-                else if (row_size <= block_size && col_size <= block_size && k_size <= block_size) {
-                    MatMult(a_raw_current, b_raw_current, c_raw_current, row_size, col_size, k_size);
+                    if (row_size == BlockSize) {
+                        ctx.fixed_kernel(a_block, lda, b_raw_current, ctx.b_rs, ctx.b_cs, c_raw_current, ctx.ldc,
+                                         col_size, k_size);
+                    } else {
+                        ctx.ragged_kernel(a_block, lda, b_raw_current, ctx.b_rs, ctx.b_cs, c_raw_current, ctx.ldc,
+                                          row_size, col_size, k_size);
+                    }
                     return;
                 }
 
-                /* the following formula holds when a, b, and c are scalars or matrices
-                 * we can exploit this with the recursive algorithm
+                /* same quadrant decomposition as MatMultCacheOblivious
                  *
-                 * / c_11   c_12 \   / a_11   a_12 \   / b_11   b_12 \ 
-                 * |             | = |             | * |             |
-                 * \ c_21   c_22 /   \ a_21   a_22 /   \ b_21   b_22 /
+                 * / c_11   c_12 \   / a_11*b_11 + a_12*b_21   a_11*b_12 + a_12*b_22 \ 
+                 * |             | = |                                               |
+                 * \ c_21   c_22 /   \ a_21*b_11 + a_22*b_21   a_21*b_12 + a_22*b_22 /
                  *
-                 *   / a_11*b_11   a_11*b_12 \   / a_12*b_21   a_12*b_22 \
-                 * = |                       | + |                       |
-                 *   \ a_21*b_11   a_21*b_12 /   \ a_22*b_21   a_22*b_22 /
-                */
+                 * the four quadrants of c are independent and can run in parallel,
+                 * the two k halves of each quadrant write the same c so they stay in order
+                 */
+                uint64_t row_size_p1 = SplitSize<BlockSize>(row_size);
+                uint64_t row_size_p2 = row_size - row_size_p1;
 
-                /* partition each dimension into two sub-sizes
-                 * place the odd amount on the p1 side, ie closer to 0
-                 * p1 should always be >= p2
-                */
-                // row partition
-                uint64_t row_size_p2 = row_size/2;
-                uint64_t row_size_p1 = row_size_p2 + row_size%2;
-               
-                // column partition
-                uint64_t col_size_p2 = col_size/2;
-                uint64_t col_size_p1 = col_size_p2 + col_size%2;
+                uint64_t col_size_p1 = SplitSize<BlockSize>(col_size);
+                uint64_t col_size_p2 = col_size - col_size_p1;
 
-                // k partition
-                uint64_t k_size_p2 = k_size/2;
-                uint64_t k_size_p1 = k_size_p2 + k_size%2;
+                uint64_t k_size_p1 = SplitSize<BlockSize>(k_size);
+                uint64_t k_size_p2 = k_size - k_size_p1;
 
                 /* calculate the offsets requred for each submatrix */
                 // k offsets
-                uint64_t a_k_offset = k_size_p1*a.rows();
-                uint64_t b_k_offset = k_size_p1;
+                uint64_t a_k_offset = k_size_p1*ctx.a_cs;
+                uint64_t b_k_offset = k_size_p1*ctx.b_rs;
 
                 // row offsets
-                uint64_t a_row_offset = row_size_p1;
+                uint64_t a_row_offset = row_size_p1*ctx.a_rs;
                 uint64_t c_row_offset = row_size_p1;
 
                 // col offsets
-                uint64_t c_col_offset = col_size_p1*c.rows();
-                uint64_t b_col_offset = col_size_p1*b.rows();
+                uint64_t c_col_offset = col_size_p1*ctx.ldc;
+                uint64_t b_col_offset = col_size_p1*ctx.b_cs;
+
+                // c_quadrant += a_row_half*b_col_half over both halves of k, in order
+                auto Quadrant = [&ctx, a_raw_current, b_raw_current, c_raw_current, a_k_offset, b_k_offset, k_size_p1, k_size_p2]
+                                (uint64_t a_offset, uint64_t b_offset, uint64_t c_offset, uint64_t rows, uint64_t cols) {
+                    MatMultRecursive<BlockSize>(ctx, a_raw_current + a_offset, b_raw_current + b_offset, c_raw_current + c_offset,
+                                     rows, cols, k_size_p1);
+                    MatMultRecursive<BlockSize>(ctx, a_raw_current + a_offset + a_k_offset, b_raw_current + b_offset + b_k_offset, c_raw_current + c_offset,
+                                     rows, cols, k_size_p2);
+                };
+
+                // small products and single threaded pools just recurse in place
+                if (ctx.pool.NumThreads() == 1 || row_size*col_size*k_size < fork_threshold) {
+                    Quadrant(0, 0, 0, row_size_p1, col_size_p1);
+                    Quadrant(a_row_offset, 0, c_row_offset, row_size_p2, col_size_p1);
+                    Quadrant(0, b_col_offset, c_col_offset, row_size_p1, col_size_p2);
+                    Quadrant(a_row_offset, b_col_offset, c_row_offset + c_col_offset, row_size_p2, col_size_p2);
+                    return;
+                }
 
-                /* calculate the terms */
-                // c_11 += a_11*b_11
-                MatMultRecursive(a_raw_current,
-                                 b_raw_current,
-                                 c_raw_current,
-                                 row_size_p1, col_size_p1, k_size_p1);
+                // fork c_21, c_12 and c_22 and compute c_11 on this thread while they run
+                Util::ThreadPool::TaskGroup group(ctx.pool);
 
-                // c_11 += a_12*b_21
-                MatMultRecursive(a_raw_current + a_k_offset,
-                                 b_raw_current + b_k_offset,
-                                 c_raw_current,
-                                 row_size_p1, col_size_p1, k_size_p2);
+                if (row_size_p2 != 0) {
+                    group.Run([=]() {
+                        TRACE_ZONE("quadrant task");
+                        Quadrant(a_row_offset, 0, c_row_offset, row_size_p2, col_size_p1);
+                    });
+                }
 
-                // c_21 += a_21*b_11
-                MatMultRecursive(a_raw_current + a_row_offset,
-                                 b_raw_current,
-                                 c_raw_current + c_row_offset,
-                                 row_size_p2, col_size_p1, k_size_p1);
+                if (col_size_p2 != 0) {
+                    group.Run([=]() {
+                        TRACE_ZONE("quadrant task");
+                        Quadrant(0, b_col_offset, c_col_offset, row_size_p1, col_size_p2);
+                    });
+                }
 
-                // c_21 += a_22*b_21
-                MatMultRecursive(a_raw_current + a_row_offset + a_k_offset,
-                                 b_raw_current + b_k_offset,
-                                 c_raw_current + c_row_offset, 
-                                 row_size_p2, col_size_p1, k_size_p2);
+                if (row_size_p2 != 0 && col_size_p2 != 0) {
+                    group.Run([=]() {
+                        TRACE_ZONE("quadrant task");
+                        Quadrant(a_row_offset, b_col_offset, c_row_offset + c_col_offset, row_size_p2, col_size_p2);
+                    });
+                }
 
-                // c_12 += a_11*b_12
-                MatMultRecursive(a_raw_current,
-                                 b_raw_current + b_col_offset,
-                                 c_raw_current + c_col_offset,
-                                 row_size_p1, col_size_p2, k_size_p1);
+                Quadrant(0, 0, 0, row_size_p1, col_size_p1);
 
-                // c_12 += a_12*b_22
-                MatMultRecursive(a_raw_current + a_k_offset,
-                                 b_raw_current + b_col_offset + b_k_offset, 
-                                 c_raw_current + c_col_offset,
-                                 row_size_p1, col_size_p2, k_size_p2);
+                TRACE_ZONE("wait for quadrants");
+                group.Wait();
+            }
 
-                // c_22 += a_21*b_12
-                MatMultRecursive(a_raw_current + a_row_offset,
-                                 b_raw_current + b_col_offset,
-                                 c_raw_current + c_row_offset + c_col_offset,
-                                 row_size_p2, col_size_p2, k_size_p1);
+        } // namespace
 
-                // c_22 += a_22*b_22
-                MatMultRecursive(a_raw_current + a_row_offset + a_k_offset,
-                                 b_raw_current + b_col_offset + b_k_offset, 
-                                 c_raw_current + c_row_offset + c_col_offset,
-                                 row_size_p2, col_size_p2, k_size_p2);
+        template <int BlockSize>
+        void MatMultCacheObliviousOptimizedBlocked(const Eigen::Ref<const Eigen::MatrixXf> a,
+                                                   const Eigen::Ref<const Eigen::MatrixXf> b,
+                                                   Eigen::Ref<Eigen::MatrixXf> c,
+                                                   Util::ThreadPool& pool,
+                                                   Op op_a,
+                                                   Op op_b) {
 
-            };
+            const Operand a_op(a, op_a);
+            const Operand b_op(b, op_b);
+
+            // Ensure the inputs are ok for matrix multiplication
+            if (a_op.rows != c.rows()
+               || a_op.cols != b_op.rows
+               || b_op.cols != c.cols()) {
+                   throw std::invalid_argument("matrices a, b, and c have incompatible sizes");
+            }
+
+            // grab the data pointers from the operands
+            const float* a_raw = a_op.data;
+            const float* b_raw = b_op.data;
+            float* c_raw = c.data();
+
+            TRACE_ZONE("MatMultCacheObliviousOptimized");
+
+            {
+                TRACE_ZONE("zero c");
+                c.setZero();
+            }
+
+            constexpr int kernel_index = BlockSizeIndex(CacheObliviousBlockSizes(), BlockSize);
+            static_assert(kernel_index >= 0, "BlockSize is not one of the CacheObliviousBlockSizes");
+
+            const KernelTable& kernels = Kernels();
+            RecursionContext ctx{a_op.row_stride, a_op.col_stride, b_op.row_stride, b_op.col_stride, c.outerStride(), pool,
+                                 kernels.oblivious_fixed[kernel_index], kernels.oblivious_ragged};
 
             // kickstart that recursion baby
-            MatMultRecursive(a_raw, b_raw, c_raw,
-                             a.rows(), b.cols(), a.cols());
+            MatMultRecursive<BlockSize>(ctx, a_raw, b_raw, c_raw,
+                                        a_op.rows, b_op.cols, a_op.cols);
+        }
+
+        // one instantiation per candidate in CacheObliviousBlockSizes so the autotuner can time each of them
+        template void MatMultCacheObliviousOptimizedBlocked<16>(const Eigen::Ref<const Eigen::MatrixXf>, const Eigen::Ref<const Eigen::MatrixXf>,
+                                                                Eigen::Ref<Eigen::MatrixXf>, Util::ThreadPool&, Op, Op);
+        template void MatMultCacheObliviousOptimizedBlocked<32>(const Eigen::Ref<const Eigen::MatrixXf>, const Eigen::Ref<const Eigen::MatrixXf>,
+                                                                Eigen::Ref<Eigen::MatrixXf>, Util::ThreadPool&, Op, Op);
+        template void MatMultCacheObliviousOptimizedBlocked<64>(const Eigen::Ref<const Eigen::MatrixXf>, const Eigen::Ref<const Eigen::MatrixXf>,
+                                                                Eigen::Ref<Eigen::MatrixXf>, Util::ThreadPool&, Op, Op);
+
+        void MatMultCacheObliviousOptimized(const Eigen::Ref<const Eigen::MatrixXf> a,
+                                            const Eigen::Ref<const Eigen::MatrixXf> b,
+                                            Eigen::Ref<Eigen::MatrixXf> c,
+                                            Util::ThreadPool& pool,
+                                            Op op_a,
+                                            Op op_b) {
+
+            const int default_block_size = 32;
+
+            // tuned on the shape of the product, whichever way round the operands are stored
+            const Operand a_op(a, op_a);
+            const Operand b_op(b, op_b);
+
+            int block_size = TuningCache::Instance().BlockSize(TunedKernel::CacheObliviousOptimized, a_op.rows, b_op.cols, a_op.cols, default_block_size);
+
+            bool dispatched = DispatchBlockSize(CacheObliviousBlockSizes(), block_size, [&](auto size) {
+                MatMultCacheObliviousOptimizedBlocked<decltype(size)::value>(a, b, c, pool, op_a, op_b);
+            });
+
+            if (!dispatched) MatMultCacheObliviousOptimizedBlocked<default_block_size>(a, b, c, pool, op_a, op_b);
+        }
+
+        void MatMultCacheObliviousOptimized(const Eigen::Ref<const Eigen::MatrixXf> a,
+                                            const Eigen::Ref<const Eigen::MatrixXf> b,
+                                            Eigen::Ref<Eigen::MatrixXf> c,
+                                            Op op_a,
+                                            Op op_b) {
+            MatMultCacheObliviousOptimized(a, b, c, Util::ThreadPool::Default(), op_a, op_b);
         }
 
     } // namespace MatrixMultiply
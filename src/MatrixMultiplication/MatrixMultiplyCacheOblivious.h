@@ -8,30 +8,81 @@ Evan Newman
 
 #include <eigen3/Eigen/Core>
 
+#include "MatrixMultiplyOperand.h"
+#include "Util/ThreadPool.h"
+
 namespace OptimizationTests {
     namespace MatrixMultiply {
 
-        /** Performs a*b = c with a cache oblivious recursive algorithm
+        /** Performs op(a)*op(b) = c with a cache oblivious recursive algorithm
          * 
          * \param a the input matrix a
          * \param b the input matrix b
+         * \param op_a whether to use a or its transpose
+         * \param op_b whether to use b or its transpose
          * 
          * \return the resulting matrix c
          */
         void MatMultCacheOblivious(const Eigen::Ref<const Eigen::MatrixXf> a,
                                    const Eigen::Ref<const Eigen::MatrixXf> b,
-                                   Eigen::Ref<Eigen::MatrixXf> c);
+                                   Eigen::Ref<Eigen::MatrixXf> c,
+                                   Op op_a = Op::None,
+                                   Op op_b = Op::None);
         
-        /** Performs a*b = c with a cache oblivious recursive algorithm with coarse base case
+        /** Performs MatMultCacheObliviousOptimized with a fixed base case block size.
+         *  Instantiated for every size in CacheObliviousBlockSizes
+         * 
+         * \tparam BlockSize the edge length of the base case blocks
+         * \param a the input matrix a
+         * \param b the input matrix b
+         * \param pool the thread pool the quadrant tasks run on
+         * \param op_a whether to use a or its transpose
+         * \param op_b whether to use b or its transpose
+         * 
+         * \return the resulting matrix c
+         */
+        template <int BlockSize>
+        void MatMultCacheObliviousOptimizedBlocked(const Eigen::Ref<const Eigen::MatrixXf> a,
+                                                   const Eigen::Ref<const Eigen::MatrixXf> b,
+                                                   Eigen::Ref<Eigen::MatrixXf> c,
+                                                   Util::ThreadPool& pool,
+                                                   Op op_a = Op::None,
+                                                   Op op_b = Op::None);
+
+        /** Performs op(a)*op(b) = c with a cache oblivious recursive algorithm with coarse base case.
+         *  The recursion is a plain function bottoming out in a fixed size vectorized kernel,
+         *  and the four quadrants of c are computed as fork-join tasks on the pool.
+         *  The base case block size is the tuned one for this cpu and shape, or 32
+         * 
+         * \param a the input matrix a
+         * \param b the input matrix b
+         * \param pool the thread pool the quadrant tasks run on
+         * \param op_a whether to use a or its transpose
+         * \param op_b whether to use b or its transpose
+         * 
+         * \return the resulting matrix c
+         */
+        void MatMultCacheObliviousOptimized(const Eigen::Ref<const Eigen::MatrixXf> a,
+                                            const Eigen::Ref<const Eigen::MatrixXf> b,
+                                            Eigen::Ref<Eigen::MatrixXf> c,
+                                            Util::ThreadPool& pool,
+                                            Op op_a = Op::None,
+                                            Op op_b = Op::None);
+
+        /** Performs MatMultCacheObliviousOptimized on the default thread pool
          * 
          * \param a the input matrix a
          * \param b the input matrix b
+         * \param op_a whether to use a or its transpose
+         * \param op_b whether to use b or its transpose
          * 
          * \return the resulting matrix c
          */
         void MatMultCacheObliviousOptimized(const Eigen::Ref<const Eigen::MatrixXf> a,
                                             const Eigen::Ref<const Eigen::MatrixXf> b,
-                                            Eigen::Ref<Eigen::MatrixXf> c);
+                                            Eigen::Ref<Eigen::MatrixXf> c,
+                                            Op op_a = Op::None,
+                                            Op op_b = Op::None);
     
     } // namespace MatrixMultiply
 } // namespace OptimizationTests
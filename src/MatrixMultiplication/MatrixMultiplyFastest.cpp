@@ -1,22 +1,28 @@
 /*
-MatrixMultiplyTiled.cpp
+MatrixMultiplyFastest.cpp
 Evan Newman
 */
 
+#include "MatrixMultiplyFastest.h"
+
+// Libraries
 #include <eigen3/Eigen/Core>
 
+// Local
+#include "MatrixMultiplyGemm.h"
+
 namespace OptimizationTests {
     namespace MatrixMultiply {
 
-
         void MatMultFastest(const Eigen::Ref<const Eigen::MatrixXf> a,
-                          const Eigen::Ref<const Eigen::MatrixXf> b,
-                          Eigen::Ref<Eigen::MatrixXf> c) {
-            
-            // transpose b
-            
-        }
+                            const Eigen::Ref<const Eigen::MatrixXf> b,
+                            Eigen::Ref<Eigen::MatrixXf> c,
+                            Op op_a,
+                            Op op_b) {
 
+            // beta = 0 so c is overwritten tile by tile without being cleared first
+            Gemm(1.0f, a, op_a, b, op_b, 0.0f, c);
+        }
 
     } // namespace MatrixMultiply
-} // namespace OptimizationTests
\ No newline at end of file
+} // namespace OptimizationTests
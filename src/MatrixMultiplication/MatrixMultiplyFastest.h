@@ -1,28 +1,37 @@
 /*
-MatrixMultiplyTiled.h
+MatrixMultiplyFastest.h
 Evan Newman
 */
 
-#ifndef MATRIX_MULTIPLY_TILED_H
-#define MATRIX_MULTIPLY_TILED_H
+#ifndef MATRIX_MULTIPLY_FASTEST_H
+#define MATRIX_MULTIPLY_FASTEST_H
 
 #include <eigen3/Eigen/Core>
 
+#include "MatrixMultiplyOperand.h"
+
 namespace OptimizationTests {
     namespace MatrixMultiply {
 
-        /** Performs a*b = c with submatrix tiling
-         * 
+        /** Performs op(a)*op(b) = c with a BLIS/GotoBLAS style packed algorithm. a and b are
+         *  packed into contiguous aligned micro-panels inside MC/KC/NC cache blocks and
+         *  an MR x NR register blocked FMA microkernel accumulates each tile of c.
+         *  This is Gemm with alpha = 1, beta = 0 and no epilogue
+         *
          * \param a the input matrix a
          * \param b the input matrix b
-         * 
+         * \param op_a whether to use a or its transpose
+         * \param op_b whether to use b or its transpose
+         *
          * \return the resulting matrix c
          */
         void MatMultFastest(const Eigen::Ref<const Eigen::MatrixXf> a,
                             const Eigen::Ref<const Eigen::MatrixXf> b,
-                            Eigen::Ref<Eigen::MatrixXf> c);
+                            Eigen::Ref<Eigen::MatrixXf> c,
+                            Op op_a = Op::None,
+                            Op op_b = Op::None);
 
     } // namespace MatrixMultiply
 } // namespace OptimizationTests
 
-#endif // #ifndef MATRIX_MULTIPLY_TILED_H
+#endif // #ifndef MATRIX_MULTIPLY_FASTEST_H
@@ -0,0 +1,67 @@
+/*
+MatrixMultiplyGemm.cpp
+Evan Newman
+*/
+
+#include "MatrixMultiplyGemm.h"
+
+// Libraries
+#include <eigen3/Eigen/Core>
+
+// Local
+#include "MatrixMultiplyGemmContext.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        void Gemm(float alpha,
+                  const Eigen::Ref<const Eigen::MatrixXf> a,
+                  const Eigen::Ref<const Eigen::MatrixXf> b,
+                  float beta,
+                  Eigen::Ref<Eigen::MatrixXf> c,
+                  const GemmEpilogue& epilogue) {
+            Gemm(alpha, a, Op::None, b, Op::None, beta, c, epilogue);
+        }
+
+        void Gemm(float alpha,
+                  const Eigen::Ref<const Eigen::MatrixXf> a,
+                  Op op_a,
+                  const Eigen::Ref<const Eigen::MatrixXf> b,
+                  Op op_b,
+                  float beta,
+                  Eigen::Ref<Eigen::MatrixXf> c,
+                  const GemmEpilogue& epilogue) {
+
+            GemmContext& context = GemmContext::ForThisThread();
+
+            // an epilogue that multiplies again gets a context of its own
+            if (context.Busy()) {
+                GemmContext nested;
+                nested.Gemm(alpha, a, op_a, b, op_b, beta, c, epilogue);
+                return;
+            }
+
+            context.Gemm(alpha, a, op_a, b, op_b, beta, c, epilogue);
+        }
+
+        void Gemm(float alpha,
+                  const Eigen::Ref<const Eigen::MatrixXf> a,
+                  Op op_a,
+                  const PackedMatrix& b,
+                  float beta,
+                  Eigen::Ref<Eigen::MatrixXf> c,
+                  const GemmEpilogue& epilogue) {
+
+            GemmContext& context = GemmContext::ForThisThread();
+
+            if (context.Busy()) {
+                GemmContext nested;
+                nested.Gemm(alpha, a, op_a, b, beta, c, epilogue);
+                return;
+            }
+
+            context.Gemm(alpha, a, op_a, b, beta, c, epilogue);
+        }
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
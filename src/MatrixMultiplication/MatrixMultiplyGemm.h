@@ -0,0 +1,126 @@
+/*
+MatrixMultiplyGemm.h
+Evan Newman
+*/
+
+#ifndef MATRIX_MULTIPLY_GEMM_H
+#define MATRIX_MULTIPLY_GEMM_H
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+
+#include <eigen3/Eigen/Core>
+
+#include "MatrixMultiplyOperand.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        class PackedMatrix;
+
+        /** Work done on each tile of c by Gemm after the product is accumulated, while the
+         *  tile is still in registers (bias and clamp) or in L1 (tile_func), so none of it
+         *  costs another pass over c. Applied in the order bias, clamp, tile_func
+         */
+        struct GemmEpilogue {
+            enum class BiasMode {
+                None,      // no bias
+                PerRow,    // c(row, col) += bias[row], bias holds c.rows() floats
+                PerColumn  // c(row, col) += bias[col], bias holds c.cols() floats
+            };
+
+            BiasMode bias_mode = BiasMode::None;
+            const float* bias = nullptr;
+
+            // every element is clamped to [clamp_min, clamp_max], the defaults leave c alone
+            float clamp_min = -std::numeric_limits<float>::infinity();
+            float clamp_max = std::numeric_limits<float>::infinity();
+
+            /** called once for every finished tile of c, tile points at c(row, col) and the
+             *  tile is rows x cols with leading dimension ld. may run from any thread
+             */
+            std::function<void(float* tile, int64_t ld, int row, int col, int rows, int cols)> tile_func;
+
+            /** an epilogue that only applies max(c, 0)
+             */
+            static GemmEpilogue Relu() {
+                GemmEpilogue epilogue;
+                epilogue.clamp_min = 0.0f;
+                return epilogue;
+            }
+
+            bool HasBias() const { return bias_mode != BiasMode::None; }
+            bool HasClamp() const {
+                return clamp_min != -std::numeric_limits<float>::infinity()
+                    || clamp_max != std::numeric_limits<float>::infinity();
+            }
+            bool Empty() const { return !HasBias() && !HasClamp() && !tile_func; }
+        };
+
+        /** Performs c = epilogue(alpha*a*b + beta*c) with the packed kernel of MatMultFastest.
+         *  alpha and beta are folded into the microkernel, the old c is read only while its
+         *  tile is being written and not at all when beta is 0, so c may hold garbage (even
+         *  NaN) in that case like in BLAS. the packing buffers belong to the calling thread's
+         *  GemmContext and are reused from call to call
+         *
+         * \param alpha the scale of the product a*b
+         * \param a the input matrix a
+         * \param b the input matrix b
+         * \param beta the scale of the old c
+         * \param c the input and resulting matrix c
+         * \param epilogue the bias, clamp and functor applied to each finished tile
+         */
+        void Gemm(float alpha,
+                  const Eigen::Ref<const Eigen::MatrixXf> a,
+                  const Eigen::Ref<const Eigen::MatrixXf> b,
+                  float beta,
+                  Eigen::Ref<Eigen::MatrixXf> c,
+                  const GemmEpilogue& epilogue = GemmEpilogue());
+
+        /** Performs c = epilogue(alpha*op(a)*op(b) + beta*c), Gemm with the transpose flags
+         *  of BLAS sgemm. op(a) and op(b) are read in place while packing, so a transposed
+         *  operand costs nothing extra. a row major matrix x is still copied if it is bound
+         *  to a or b directly, pass x.transpose() with Op::Transpose to read it in place
+         *
+         * \param alpha the scale of the product op(a)*op(b)
+         * \param a the input matrix a
+         * \param op_a whether to use a or its transpose
+         * \param b the input matrix b
+         * \param op_b whether to use b or its transpose
+         * \param beta the scale of the old c
+         * \param c the input and resulting matrix c
+         * \param epilogue the bias, clamp and functor applied to each finished tile
+         */
+        void Gemm(float alpha,
+                  const Eigen::Ref<const Eigen::MatrixXf> a,
+                  Op op_a,
+                  const Eigen::Ref<const Eigen::MatrixXf> b,
+                  Op op_b,
+                  float beta,
+                  Eigen::Ref<Eigen::MatrixXf> c,
+                  const GemmEpilogue& epilogue = GemmEpilogue());
+
+        /** Performs c = epilogue(alpha*op(a)*b + beta*c) with a b packed ahead of time by
+         *  PackedMatrix, which skips packing b on every call
+         *
+         * \param alpha the scale of the product op(a)*b
+         * \param a the input matrix a
+         * \param op_a whether to use a or its transpose
+         * \param b the packed input matrix b
+         * \param beta the scale of the old c
+         * \param c the input and resulting matrix c
+         * \param epilogue the bias, clamp and functor applied to each finished tile
+         */
+        void Gemm(float alpha,
+                  const Eigen::Ref<const Eigen::MatrixXf> a,
+                  Op op_a,
+                  const PackedMatrix& b,
+                  float beta,
+                  Eigen::Ref<Eigen::MatrixXf> c,
+                  const GemmEpilogue& epilogue = GemmEpilogue());
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
+
+#endif // #ifndef MATRIX_MULTIPLY_GEMM_H
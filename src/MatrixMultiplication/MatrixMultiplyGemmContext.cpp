@@ -0,0 +1,212 @@
+/*
+MatrixMultiplyGemmContext.cpp
+Evan Newman
+*/
+
+#include "MatrixMultiplyGemmContext.h"
+
+// System
+#include <stdexcept>
+#include <cstdint>
+#include <algorithm>
+
+// Libraries
+#include <eigen3/Eigen/Core>
+
+// Local
+#include "MatrixMultiplyKernels.h"
+
+#include "Util/Arena.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        namespace {
+
+            // forwards a finished tile from the kernel to the epilogue's functor
+            void CallTileFunc(const void* context, float* tile, int64_t ld, int row, int col, int rows, int cols) {
+                static_cast<const GemmEpilogue*>(context)->tile_func(tile, ld, row, col, rows, cols);
+            }
+
+            EpilogueParams ToParams(const GemmEpilogue& epilogue) {
+                EpilogueParams params;
+
+                switch (epilogue.bias_mode) {
+                    case GemmEpilogue::BiasMode::None: params.bias_mode = EpilogueParams::no_bias; break;
+                    case GemmEpilogue::BiasMode::PerRow: params.bias_mode = EpilogueParams::per_row; break;
+                    case GemmEpilogue::BiasMode::PerColumn: params.bias_mode = EpilogueParams::per_column; break;
+                }
+                params.bias = epilogue.bias;
+
+                params.clamp = epilogue.HasClamp();
+                params.clamp_min = epilogue.clamp_min;
+                params.clamp_max = epilogue.clamp_max;
+
+                params.tile_func = epilogue.tile_func ? CallTileFunc : nullptr;
+                params.tile_context = &epilogue;
+
+                return params;
+            }
+
+            // marks a context busy for the length of a product
+            class BusyScope {
+            public:
+                explicit BusyScope(bool& busy) : _busy(busy) {
+                    if (_busy) throw std::logic_error("the gemm context is already running a product");
+                    _busy = true;
+                }
+
+                ~BusyScope() { _busy = false; }
+
+            private:
+                bool& _busy;
+            };
+
+        } // namespace
+
+        PackedMatrix::PackedMatrix() : _data(nullptr), _rows(0), _cols(0), _kernels(nullptr) {}
+
+        PackedMatrix::PackedMatrix(const Eigen::Ref<const Eigen::MatrixXf> b, Op op_b) : PackedMatrix() {
+            Pack(b, op_b);
+        }
+
+        void PackedMatrix::Pack(const Eigen::Ref<const Eigen::MatrixXf> b, Op op_b) {
+            const Operand b_op(b, op_b);
+            const KernelTable& kernels = MatrixMultiply::Kernels(); // not the member
+
+            // whole micro-panels of nr columns, the last one zero padded
+            const int64_t cols_padded = (b_op.cols + kernels.nr - 1)/kernels.nr*kernels.nr;
+            const size_t count = static_cast<size_t>(b_op.rows*cols_padded);
+
+            _arena.Reset();
+            _arena.Reserve(Util::Arena::Footprint<float>(count));
+
+            float* data = _arena.Allocate<float>(count);
+            kernels.pack_b(b_op.rows, b_op.cols, b_op.data, b_op.row_stride, b_op.col_stride, data);
+
+            _data = data;
+            _rows = b_op.rows;
+            _cols = b_op.cols;
+            _kernels = &kernels;
+        }
+
+        void GemmContext::Gemm(float alpha,
+                               const Eigen::Ref<const Eigen::MatrixXf> a,
+                               Op op_a,
+                               const Eigen::Ref<const Eigen::MatrixXf> b,
+                               Op op_b,
+                               float beta,
+                               Eigen::Ref<Eigen::MatrixXf> c,
+                               const GemmEpilogue& epilogue) {
+
+            const Operand a_op(a, op_a);
+            const Operand b_op(b, op_b);
+
+            // Ensure the inputs are ok for matrix multiplication
+            if (a_op.rows != c.rows()
+               || a_op.cols != b_op.rows
+               || b_op.cols != c.cols()) {
+                   throw std::invalid_argument("matrices a, b, and c have incompatible sizes");
+            }
+
+            if (epilogue.HasBias() && epilogue.bias == nullptr) {
+                throw std::invalid_argument("the gemm epilogue has a bias mode but no bias");
+            }
+
+            const int m = c.rows();
+            const int n = c.cols();
+            const int k = a_op.cols;
+
+            if (m == 0 || n == 0) return;
+
+            BusyScope busy(_busy);
+
+            const KernelTable& kernels = Kernels();
+
+            // the kernel skips the epilogue entirely when there is nothing in it
+            const EpilogueParams params = ToParams(epilogue);
+            const EpilogueParams* params_ptr = epilogue.Empty() ? nullptr : &params;
+
+            // packing buffers, rounded up to whole micro-panels
+            const int mc_max = std::min(kernels.mc, (m + kernels.mr - 1)/kernels.mr*kernels.mr);
+            const int kc_max = std::min(kernels.kc, k);
+            const int nc_max = std::min(kernels.nc, (n + kernels.nr - 1)/kernels.nr*kernels.nr);
+
+            const size_t a_count = static_cast<size_t>(mc_max)*kc_max;
+            const size_t b_count = static_cast<size_t>(kc_max)*nc_max;
+
+            _arena.Reset();
+            _arena.Reserve(Util::Arena::Footprint<float>(a_count) + Util::Arena::Footprint<float>(b_count));
+
+            float* a_packed = _arena.Allocate<float>(a_count);
+            float* b_packed = _arena.Allocate<float>(b_count);
+
+            // the transposes are taken care of while packing, which copies every block anyway
+            kernels.gemm(m, n, k, alpha,
+                         a_op.data, a_op.row_stride, a_op.col_stride,
+                         b_op.data, b_op.row_stride, b_op.col_stride,
+                         beta, c.data(), c.outerStride(),
+                         params_ptr, a_packed, b_packed);
+        }
+
+        void GemmContext::Gemm(float alpha,
+                               const Eigen::Ref<const Eigen::MatrixXf> a,
+                               Op op_a,
+                               const PackedMatrix& b,
+                               float beta,
+                               Eigen::Ref<Eigen::MatrixXf> c,
+                               const GemmEpilogue& epilogue) {
+
+            const Operand a_op(a, op_a);
+
+            // Ensure the inputs are ok for matrix multiplication
+            if (a_op.rows != c.rows()
+               || a_op.cols != b.Rows()
+               || b.Cols() != c.cols()) {
+                   throw std::invalid_argument("matrices a, b, and c have incompatible sizes");
+            }
+
+            if (epilogue.HasBias() && epilogue.bias == nullptr) {
+                throw std::invalid_argument("the gemm epilogue has a bias mode but no bias");
+            }
+
+            const int m = c.rows();
+            const int n = c.cols();
+            const int k = a_op.cols;
+
+            if (m == 0 || n == 0) return;
+
+            const KernelTable& kernels = Kernels();
+
+            if (b.Kernels() != &kernels) {
+                throw std::invalid_argument("the packed matrix b was packed for other kernels, pack it again");
+            }
+
+            BusyScope busy(_busy);
+
+            const EpilogueParams params = ToParams(epilogue);
+            const EpilogueParams* params_ptr = epilogue.Empty() ? nullptr : &params;
+
+            const int mc_max = std::min(kernels.mc, (m + kernels.mr - 1)/kernels.mr*kernels.mr);
+            const int kc_max = std::min(kernels.kc, k);
+            const size_t a_count = static_cast<size_t>(mc_max)*kc_max;
+
+            _arena.Reset();
+            _arena.Reserve(Util::Arena::Footprint<float>(a_count));
+
+            float* a_packed = _arena.Allocate<float>(a_count);
+
+            kernels.gemm_prepacked(m, n, k, alpha,
+                                   a_op.data, a_op.row_stride, a_op.col_stride,
+                                   b.Data(),
+                                   beta, c.data(), c.outerStride(),
+                                   params_ptr, a_packed);
+        }
+
+        GemmContext& GemmContext::ForThisThread() {
+            thread_local GemmContext context;
+            return context;
+        }
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
@@ -0,0 +1,170 @@
+/*
+MatrixMultiplyGemmContext.h
+Evan Newman
+*/
+
+#ifndef MATRIX_MULTIPLY_GEMM_CONTEXT_H
+#define MATRIX_MULTIPLY_GEMM_CONTEXT_H
+
+#include <cstdint>
+
+#include <eigen3/Eigen/Core>
+
+#include "MatrixMultiplyOperand.h"
+#include "MatrixMultiplyGemm.h"
+
+#include "Util/Arena.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        struct KernelTable;
+
+        /** op(b) packed once into the layout the gemm microkernel reads, for a b that is
+         *  multiplied by many a's (weights). The packing is tied to the kernels in use when it
+         *  was made, Gemm throws if SelectKernels has switched them since
+         */
+        class PackedMatrix {
+        public:
+            PackedMatrix();
+
+            /** packs op(b)
+             *
+             * \param b the matrix to pack
+             * \param op_b whether to pack b or its transpose
+             */
+            explicit PackedMatrix(const Eigen::Ref<const Eigen::MatrixXf> b, Op op_b = Op::None);
+
+            /** packs a new op(b), reusing the memory of the old one when it is big enough
+             *
+             * \param b the matrix to pack
+             * \param op_b whether to pack b or its transpose
+             */
+            void Pack(const Eigen::Ref<const Eigen::MatrixXf> b, Op op_b = Op::None);
+
+            // the size of op(b)
+            int64_t Rows() const { return _rows; }
+            int64_t Cols() const { return _cols; }
+
+            const float* Data() const { return _data; }
+            const KernelTable* Kernels() const { return _kernels; }
+
+        private:
+            Util::Arena _arena;
+            const float* _data;
+            int64_t _rows;
+            int64_t _cols;
+            const KernelTable* _kernels;
+        };
+
+        /** Owns the packing buffers of Gemm so a run of products doesn't allocate anything
+         *  once the buffers have grown to the largest of them. The buffers live in a huge page
+         *  backed arena, and never grow past one cache block of a and one of b however large
+         *  the product is. A second arena holds the scratch of the products that aren't a
+         *  Gemm (the rank-k packing, gemv's buffers, Strassen's temporaries), kept apart so a
+         *  Gemm run on that scratch doesn't overwrite it. Not thread safe, use one context per thread
+         */
+        class GemmContext {
+        public:
+            GemmContext() : _busy(false), _scratch_busy(false) {}
+
+            GemmContext(const GemmContext&) = delete;
+            GemmContext& operator=(const GemmContext&) = delete;
+
+            /** Performs c = epilogue(alpha*op(a)*op(b) + beta*c), see Gemm
+             *
+             * \param alpha the scale of the product op(a)*op(b)
+             * \param a the input matrix a
+             * \param op_a whether to use a or its transpose
+             * \param b the input matrix b
+             * \param op_b whether to use b or its transpose
+             * \param beta the scale of the old c
+             * \param c the input and resulting matrix c
+             * \param epilogue the bias, clamp and functor applied to each finished tile
+             */
+            void Gemm(float alpha,
+                      const Eigen::Ref<const Eigen::MatrixXf> a,
+                      Op op_a,
+                      const Eigen::Ref<const Eigen::MatrixXf> b,
+                      Op op_b,
+                      float beta,
+                      Eigen::Ref<Eigen::MatrixXf> c,
+                      const GemmEpilogue& epilogue = GemmEpilogue());
+
+            /** Performs c = epilogue(alpha*op(a)*b + beta*c) with an already packed b, so only
+             *  a is packed
+             *
+             * \param alpha the scale of the product op(a)*b
+             * \param a the input matrix a
+             * \param op_a whether to use a or its transpose
+             * \param b the packed input matrix b
+             * \param beta the scale of the old c
+             * \param c the input and resulting matrix c
+             * \param epilogue the bias, clamp and functor applied to each finished tile
+             */
+            void Gemm(float alpha,
+                      const Eigen::Ref<const Eigen::MatrixXf> a,
+                      Op op_a,
+                      const PackedMatrix& b,
+                      float beta,
+                      Eigen::Ref<Eigen::MatrixXf> c,
+                      const GemmEpilogue& epilogue = GemmEpilogue());
+
+            /** whether a product is running in this context, an epilogue calling back into
+             *  it would have its packing buffers overwritten
+             */
+            bool Busy() const { return _busy; }
+
+            const Util::Arena& Arena() const { return _arena; }
+
+            /** the context the free Gemm functions use on the calling thread
+             */
+            static GemmContext& ForThisThread();
+
+            /** runs func(arena) with the scratch arena of the calling thread's context reset and
+             *  reserved to bytes, for func to Allocate its buffers from. when that scratch is
+             *  already in use further up the stack func gets a context of its own, like Gemm
+             *
+             * \param bytes the space func allocates, see Util::Arena::Footprint
+             * \param func called with the Util::Arena& to allocate from
+             */
+            template <typename Func>
+            static void WithScratch(size_t bytes, Func&& func) {
+                GemmContext& context = ForThisThread();
+
+                if (context._scratch_busy) {
+                    GemmContext nested;
+                    nested.RunWithScratch(bytes, func);
+                    return;
+                }
+
+                context.RunWithScratch(bytes, func);
+            }
+
+        private:
+            template <typename Func>
+            void RunWithScratch(size_t bytes, Func& func) {
+                struct Release {
+                    bool& busy;
+                    ~Release() { busy = false; }
+                };
+
+                _scratch_busy = true;
+                Release release{_scratch_busy};
+
+                _scratch.Reset();
+                _scratch.Reserve(bytes);
+                func(_scratch);
+            }
+
+            Util::Arena _arena;
+            bool _busy;
+
+            Util::Arena _scratch;
+            bool _scratch_busy;
+        };
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
+
+#endif // #ifndef MATRIX_MULTIPLY_GEMM_CONTEXT_H
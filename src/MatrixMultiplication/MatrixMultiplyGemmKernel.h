@@ -0,0 +1,433 @@
+/*
+MatrixMultiplyGemmKernel.h the packed gemm driver and microkernel, compiled once per instruction set
+Evan Newman
+*/
+
+/* only included by the MatrixMultiplyKernels*.cpp files, which define MATRIX_MULTIPLY_ISA to
+ * the namespace of their instruction set first. nothing in here may call an inline function
+ * from another header (std::min, Eigen, ...): the linker keeps one copy of an inline function
+ * for the whole program, and it could be the one compiled for a newer instruction set
+ */
+
+#ifndef MATRIX_MULTIPLY_GEMM_KERNEL_H
+#define MATRIX_MULTIPLY_GEMM_KERNEL_H
+
+#ifndef MATRIX_MULTIPLY_ISA
+#error "define MATRIX_MULTIPLY_ISA before including MatrixMultiplyGemmKernel.h"
+#endif
+
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "MatrixMultiplyKernels.h"
+
+#include "Util/Trace.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+        namespace MATRIX_MULTIPLY_ISA {
+
+            namespace {
+
+                /* one vector of floats of the instruction set and the register blocking that fits
+                 * its register file. the MR x NR tile of c takes MR/width*NR accumulators and leaves
+                 * room for the column of a and the broadcast of b
+                 */
+#if defined(__AVX512F__)
+                struct Vec {
+                    using Type = __m512;
+                    static constexpr int width = 16;
+
+                    static Type Zero() { return _mm512_setzero_ps(); }
+                    static Type Set(float x) { return _mm512_set1_ps(x); }
+                    static Type Load(const float* p) { return _mm512_load_ps(p); }
+                    static Type LoadU(const float* p) { return _mm512_loadu_ps(p); }
+                    static void StoreU(float* p, Type x) { _mm512_storeu_ps(p, x); }
+                    static Type FmAdd(Type x, Type y, Type z) { return _mm512_fmadd_ps(x, y, z); }
+                    static Type Mul(Type x, Type y) { return _mm512_mul_ps(x, y); }
+                    static Type Add(Type x, Type y) { return _mm512_add_ps(x, y); }
+                    static Type Max(Type x, Type y) { return _mm512_max_ps(x, y); }
+                    static Type Min(Type x, Type y) { return _mm512_min_ps(x, y); }
+                };
+
+                // 24 of the 32 zmm registers
+                constexpr int MR = 32;
+                constexpr int NR = 12;
+#elif defined(__AVX2__) && defined(__FMA__)
+                struct Vec {
+                    using Type = __m256;
+                    static constexpr int width = 8;
+
+                    static Type Zero() { return _mm256_setzero_ps(); }
+                    static Type Set(float x) { return _mm256_set1_ps(x); }
+                    static Type Load(const float* p) { return _mm256_load_ps(p); }
+                    static Type LoadU(const float* p) { return _mm256_loadu_ps(p); }
+                    static void StoreU(float* p, Type x) { _mm256_storeu_ps(p, x); }
+                    static Type FmAdd(Type x, Type y, Type z) { return _mm256_fmadd_ps(x, y, z); }
+                    static Type Mul(Type x, Type y) { return _mm256_mul_ps(x, y); }
+                    static Type Add(Type x, Type y) { return _mm256_add_ps(x, y); }
+                    static Type Max(Type x, Type y) { return _mm256_max_ps(x, y); }
+                    static Type Min(Type x, Type y) { return _mm256_min_ps(x, y); }
+                };
+
+                // 12 of the 16 ymm registers
+                constexpr int MR = 16;
+                constexpr int NR = 6;
+#elif defined(__SSE2__)
+                struct Vec {
+                    using Type = __m128;
+                    static constexpr int width = 4;
+
+                    static Type Zero() { return _mm_setzero_ps(); }
+                    static Type Set(float x) { return _mm_set1_ps(x); }
+                    static Type Load(const float* p) { return _mm_load_ps(p); }
+                    static Type LoadU(const float* p) { return _mm_loadu_ps(p); }
+                    static void StoreU(float* p, Type x) { _mm_storeu_ps(p, x); }
+                    static Type FmAdd(Type x, Type y, Type z) { return _mm_add_ps(_mm_mul_ps(x, y), z); }
+                    static Type Mul(Type x, Type y) { return _mm_mul_ps(x, y); }
+                    static Type Add(Type x, Type y) { return _mm_add_ps(x, y); }
+                    static Type Max(Type x, Type y) { return _mm_max_ps(x, y); }
+                    static Type Min(Type x, Type y) { return _mm_min_ps(x, y); }
+                };
+
+                // 8 of the 16 xmm registers, the separate multiply and add need temporaries
+                constexpr int MR = 8;
+                constexpr int NR = 4;
+#else
+                // portable fallback, one float at a time
+                struct Vec {
+                    using Type = float;
+                    static constexpr int width = 1;
+
+                    static Type Zero() { return 0.0f; }
+                    static Type Set(float x) { return x; }
+                    static Type Load(const float* p) { return *p; }
+                    static Type LoadU(const float* p) { return *p; }
+                    static void StoreU(float* p, Type x) { *p = x; }
+                    static Type FmAdd(Type x, Type y, Type z) { return x*y + z; }
+                    static Type Mul(Type x, Type y) { return x*y; }
+                    static Type Add(Type x, Type y) { return x + y; }
+                    static Type Max(Type x, Type y) { return x < y ? y : x; }
+                    static Type Min(Type x, Type y) { return y < x ? y : x; }
+                };
+
+                constexpr int MR = 8;
+                constexpr int NR = 4;
+#endif
+
+                // vectors down one column of the tile
+                constexpr int MV = MR/Vec::width;
+
+                /* cache blocking, sized so that a KC x NR micro-panel of b stays in L1,
+                 * the MC x KC packed block of a stays in L2 and the KC x NC packed block of b in L3
+                 */
+                constexpr int MC = 128;
+                constexpr int KC = 256;
+                constexpr int NC = 3072;
+
+                static_assert(MC % MR == 0 && NC % NR == 0, "the cache blocks must hold whole micro-panels");
+
+                int Min(int x, int y) { return x < y ? x : y; }
+
+                /** how the microkernel combines its product with the tile of c in memory.
+                 *  c = alpha*a_packed*b_packed + beta*c, then the epilogue if there is one
+                 */
+                struct TileUpdate {
+                    float alpha;
+                    float beta;                     // 0 means the old c is never read
+                    const EpilogueParams* epilogue; // only set on the last k block
+                    int row;                        // where the tile starts in c, for the bias
+                    int col;
+                };
+
+                /** applies the bias and clamp of the epilogue to one element of c
+                 */
+                float EpilogueElement(float value, int row, int col, const EpilogueParams& epilogue) {
+                    if (epilogue.bias_mode == EpilogueParams::per_row) value += epilogue.bias[row];
+                    else if (epilogue.bias_mode == EpilogueParams::per_column) value += epilogue.bias[col];
+
+                    if (epilogue.clamp) {
+                        value = value < epilogue.clamp_min ? epilogue.clamp_min : value;
+                        value = value > epilogue.clamp_max ? epilogue.clamp_max : value;
+                    }
+                    return value;
+                }
+
+                /** packs an m_size x k_size block of a, element (row, k) at a[row*a_rs + k*a_cs],
+                 *  into micro-panels of MR rows. every panel holds its MR rows contiguously for
+                 *  each k in turn so the microkernel streams through it linearly. rows past
+                 *  m_size are zero padded
+                 */
+                void PackA(const float* a, int64_t a_rs, int64_t a_cs, int m_size, int k_size, float* a_packed) {
+                    for (int panel = 0; panel < m_size; panel += MR) {
+                        int rows = Min(MR, m_size - panel);
+                        const float* a_panel = a + panel*a_rs;
+
+                        // a column major a, copy down its columns
+                        if (a_rs == 1) {
+                            for (int k = 0; k < k_size; k++, a_packed += MR) {
+                                const float* a_col = a_panel + k*a_cs;
+
+                                int row = 0;
+                                for (; row < rows; row++) a_packed[row] = a_col[row];
+                                for (; row < MR; row++) a_packed[row] = 0.0f;
+                            }
+                            continue;
+                        }
+
+                        // a transposed a, read along its rows and scatter them into the panel
+                        for (int row = 0; row < rows; row++) {
+                            const float* a_row = a_panel + row*a_rs;
+                            for (int k = 0; k < k_size; k++) a_packed[row + k*MR] = a_row[k*a_cs];
+                        }
+
+                        for (int k = 0; k < k_size; k++) {
+                            for (int row = rows; row < MR; row++) a_packed[row + k*MR] = 0.0f;
+                        }
+
+                        a_packed += k_size*MR;
+                    }
+                }
+
+                /** packs a k_size x n_size block of b, element (k, col) at b[k*b_rs + col*b_cs],
+                 *  into micro-panels of NR columns. every panel holds the NR elements of a row
+                 *  contiguously for each k in turn. columns past n_size are zero padded
+                 */
+                void PackB(const float* b, int64_t b_rs, int64_t b_cs, int k_size, int n_size, float* b_packed) {
+                    for (int panel = 0; panel < n_size; panel += NR) {
+                        int cols = Min(NR, n_size - panel);
+                        const float* b_panel = b + panel*b_cs;
+
+                        for (int k = 0; k < k_size; k++, b_packed += NR) {
+                            const float* b_row = b_panel + k*b_rs;
+
+                            int col = 0;
+                            for (; col < cols; col++) b_packed[col] = b_row[col*b_cs];
+                            for (; col < NR; col++) b_packed[col] = 0.0f;
+                        }
+                    }
+                }
+
+                /** computes the full MR x NR tile c = alpha*a_packed*b_packed + beta*c with the whole
+                 *  tile of c kept in registers over k, and applies the epilogue before storing it
+                 */
+                void MicroKernel(int k_size, const float* a_packed, const float* b_packed,
+                                 float* c, int64_t ldc, const TileUpdate& update) {
+                    Vec::Type acc[NR][MV];
+
+                    for (int col = 0; col < NR; col++) {
+                        for (int v = 0; v < MV; v++) acc[col][v] = Vec::Zero();
+                    }
+
+                    for (int k = 0; k < k_size; k++, a_packed += MR, b_packed += NR) {
+                        Vec::Type a_k[MV];
+                        for (int v = 0; v < MV; v++) a_k[v] = Vec::Load(a_packed + v*Vec::width);
+
+                        for (int col = 0; col < NR; col++) {
+                            const Vec::Type b_k = Vec::Set(b_packed[col]);
+                            for (int v = 0; v < MV; v++) acc[col][v] = Vec::FmAdd(a_k[v], b_k, acc[col][v]);
+                        }
+                    }
+
+                    if (update.alpha != 1.0f) {
+                        const Vec::Type alpha = Vec::Set(update.alpha);
+                        for (int col = 0; col < NR; col++) {
+                            for (int v = 0; v < MV; v++) acc[col][v] = Vec::Mul(acc[col][v], alpha);
+                        }
+                    }
+
+                    if (update.beta != 0.0f) {
+                        const Vec::Type beta = Vec::Set(update.beta);
+                        for (int col = 0; col < NR; col++) {
+                            for (int v = 0; v < MV; v++) acc[col][v] = Vec::FmAdd(Vec::LoadU(c + v*Vec::width + col*ldc), beta, acc[col][v]);
+                        }
+                    }
+
+                    if (update.epilogue != nullptr) {
+                        const EpilogueParams& epilogue = *update.epilogue;
+
+                        if (epilogue.bias_mode == EpilogueParams::per_row) {
+                            for (int v = 0; v < MV; v++) {
+                                const Vec::Type bias = Vec::LoadU(epilogue.bias + update.row + v*Vec::width);
+                                for (int col = 0; col < NR; col++) acc[col][v] = Vec::Add(acc[col][v], bias);
+                            }
+                        }
+                        else if (epilogue.bias_mode == EpilogueParams::per_column) {
+                            for (int col = 0; col < NR; col++) {
+                                const Vec::Type bias = Vec::Set(epilogue.bias[update.col + col]);
+                                for (int v = 0; v < MV; v++) acc[col][v] = Vec::Add(acc[col][v], bias);
+                            }
+                        }
+
+                        if (epilogue.clamp) {
+                            const Vec::Type clamp_min = Vec::Set(epilogue.clamp_min);
+                            const Vec::Type clamp_max = Vec::Set(epilogue.clamp_max);
+                            for (int col = 0; col < NR; col++) {
+                                for (int v = 0; v < MV; v++) acc[col][v] = Vec::Min(Vec::Max(acc[col][v], clamp_min), clamp_max);
+                            }
+                        }
+                    }
+
+                    for (int col = 0; col < NR; col++) {
+                        for (int v = 0; v < MV; v++) Vec::StoreU(c + v*Vec::width + col*ldc, acc[col][v]);
+                    }
+                }
+
+                /** where PackBKernel puts the kc x nc block of b starting at (pc, jc). the blocks
+                 *  are stored NC columns at a time and down k within those, each padded to whole
+                 *  micro-panels, so every block before column jc is a full NC wide
+                 */
+                int64_t PrepackedOffset(int k, int jc, int pc, int nc) {
+                    return static_cast<int64_t>(jc)*k + static_cast<int64_t>(pc)*((nc + NR - 1)/NR*NR);
+                }
+
+                /** packs all of the k x n b, every block the way GemmKernel would pack it, so it
+                 *  can be multiplied by any number of a's without being packed again
+                 */
+                void PackBKernel(int k, int n, const float* b, int64_t b_rs, int64_t b_cs, float* b_packed) {
+                    TRACE_ZONE("prepack b");
+
+                    for (int jc = 0; jc < n; jc += NC) {
+                        int nc = Min(NC, n - jc);
+
+                        for (int pc = 0; pc < k; pc += KC) {
+                            int kc = Min(KC, k - pc);
+                            PackB(b + pc*b_rs + jc*b_cs, b_rs, b_cs, kc, nc, b_packed + PrepackedOffset(k, jc, pc, nc));
+                        }
+                    }
+                }
+
+                /** the gemm loops, b_prepacked is either all of b from PackBKernel or nullptr, in
+                 *  which case every block of b is packed into b_packed on the way
+                 */
+                void GemmBlocks(int m, int n, int k, float alpha,
+                                const float* a, int64_t a_rs, int64_t a_cs,
+                                const float* b, int64_t b_rs, int64_t b_cs, const float* b_prepacked,
+                                float beta, float* c, int64_t ldc,
+                                const EpilogueParams* epilogue, float* a_packed, float* b_packed) {
+
+                    TRACE_ZONE("gemm");
+
+                    // an empty k leaves only the scaling of c and the epilogue
+                    if (k == 0 || alpha == 0.0f) {
+                        TRACE_ZONE("scale c");
+
+                        for (int col = 0; col < n; col++) {
+                            for (int row = 0; row < m; row++) {
+                                float& c_elem = c[row + col*ldc];
+                                c_elem = beta == 0.0f ? 0.0f : beta*c_elem;
+                                if (epilogue != nullptr) c_elem = EpilogueElement(c_elem, row, col, *epilogue);
+                            }
+                        }
+
+                        if (epilogue != nullptr && epilogue->tile_func != nullptr) epilogue->tile_func(epilogue->tile_context, c, ldc, 0, 0, m, n);
+                        return;
+                    }
+
+                    alignas(64) float c_edge[MR*NR];
+
+                    /* five loops around the microkernel (Goto & van de Geijn)
+                     * jc: NC wide column panels of b and c
+                     * pc: KC deep slices of k, b is packed once per slice
+                     * ic: MC tall row panels of a and c, a is packed once per panel
+                     * jr, ir: NR x MR tiles of c computed by the microkernel
+                     *
+                     * the first k slice scales the old c by beta, the later ones add to it and
+                     * the last one finishes each tile with the epilogue
+                     */
+                    for (int jc = 0; jc < n; jc += NC) {
+                        int nc = Min(NC, n - jc);
+
+                        for (int pc = 0; pc < k; pc += KC) {
+                            int kc = Min(KC, k - pc);
+                            const float beta_block = pc == 0 ? beta : 1.0f;
+                            const EpilogueParams* block_epilogue = pc + kc == k ? epilogue : nullptr;
+
+                            const float* b_block = b_packed;
+                            if (b_prepacked != nullptr) {
+                                b_block = b_prepacked + PrepackedOffset(k, jc, pc, nc);
+                            } else {
+                                TRACE_ZONE("pack b");
+                                PackB(b + pc*b_rs + jc*b_cs, b_rs, b_cs, kc, nc, b_packed);
+                            }
+
+                            for (int ic = 0; ic < m; ic += MC) {
+                                int mc = Min(MC, m - ic);
+
+                                {
+                                    TRACE_ZONE("pack a");
+                                    PackA(a + ic*a_rs + pc*a_cs, a_rs, a_cs, mc, kc, a_packed);
+                                }
+
+                                TRACE_ZONE("macro kernel");
+
+                                for (int jr = 0; jr < nc; jr += NR) {
+                                    int cols = Min(NR, nc - jr);
+                                    const float* b_panel = b_block + jr*kc;
+
+                                    for (int ir = 0; ir < mc; ir += MR) {
+                                        int rows = Min(MR, mc - ir);
+                                        const float* a_panel = a_packed + ir*kc;
+
+                                        const int row = ic + ir;
+                                        const int col = jc + jr;
+                                        float* c_tile = c + row + col*ldc;
+
+                                        if (rows == MR && cols == NR) {
+                                            MicroKernel(kc, a_panel, b_panel, c_tile, ldc, TileUpdate{alpha, beta_block, block_epilogue, row, col});
+                                        }
+                                        else {
+                                            TRACE_ZONE("edge tile");
+
+                                            // ragged edge tile, compute the padded tile then finish the valid part
+                                            MicroKernel(kc, a_panel, b_panel, c_edge, MR, TileUpdate{alpha, 0.0f, nullptr, row, col});
+
+                                            for (int j = 0; j < cols; j++) {
+                                                for (int i = 0; i < rows; i++) {
+                                                    float& c_elem = c_tile[i + j*ldc];
+                                                    float value = c_edge[i + j*MR];
+                                                    if (beta_block != 0.0f) value += beta_block*c_elem;
+                                                    if (block_epilogue != nullptr) value = EpilogueElement(value, row + i, col + j, *block_epilogue);
+
+                                                    c_elem = value;
+                                                }
+                                            }
+                                        }
+
+                                        // the tile was just written so it is still in L1
+                                        if (block_epilogue != nullptr && block_epilogue->tile_func != nullptr) {
+                                            block_epilogue->tile_func(block_epilogue->tile_context, c_tile, ldc, row, col, rows, cols);
+                                        }
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+
+                void GemmKernel(int m, int n, int k, float alpha,
+                                const float* a, int64_t a_rs, int64_t a_cs,
+                                const float* b, int64_t b_rs, int64_t b_cs,
+                                float beta, float* c, int64_t ldc,
+                                const EpilogueParams* epilogue, float* a_packed, float* b_packed) {
+                    GemmBlocks(m, n, k, alpha, a, a_rs, a_cs, b, b_rs, b_cs, nullptr, beta, c, ldc, epilogue, a_packed, b_packed);
+                }
+
+                void GemmPrepackedKernel(int m, int n, int k, float alpha,
+                                         const float* a, int64_t a_rs, int64_t a_cs,
+                                         const float* b_prepacked,
+                                         float beta, float* c, int64_t ldc,
+                                         const EpilogueParams* epilogue, float* a_packed) {
+                    GemmBlocks(m, n, k, alpha, a, a_rs, a_cs, nullptr, 0, 0, b_prepacked, beta, c, ldc, epilogue, a_packed, nullptr);
+                }
+
+            } // namespace
+
+        } // namespace MATRIX_MULTIPLY_ISA
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
+
+#endif // #ifndef MATRIX_MULTIPLY_GEMM_KERNEL_H
@@ -0,0 +1,247 @@
+/*
+MatrixMultiplyGemvKernel.h the matrix vector and rank-k update kernels, compiled once per instruction set
+Evan Newman
+*/
+
+/* only included by the MatrixMultiplyKernels*.cpp files, see MatrixMultiplyGemmKernel.h
+ */
+
+#ifndef MATRIX_MULTIPLY_GEMV_KERNEL_H
+#define MATRIX_MULTIPLY_GEMV_KERNEL_H
+
+#ifndef MATRIX_MULTIPLY_ISA
+#error "define MATRIX_MULTIPLY_ISA before including MatrixMultiplyGemvKernel.h"
+#endif
+
+#include <cstdint>
+
+#include "MatrixMultiplyKernels.h"
+#include "MatrixMultiplyGemmKernel.h" // Vec
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+        namespace MATRIX_MULTIPLY_ISA {
+
+            namespace {
+
+                /* both kernels walk down the columns of a gemv_rows rows at a time, with that
+                 * many rows of the result held in registers
+                 */
+                constexpr int gemv_vectors = 4;
+                constexpr int gemv_rows = gemv_vectors*Vec::width;
+
+                /* the rank-k kernel computes rank_k_vectors vectors down rank_k_cols columns of c at once,
+                 * every load of a feeds rank_k_cols multiply-adds. it sweeps the columns of c over
+                 * rank_k_rows rows of a at a time, which stay in L2
+                 */
+                constexpr int rank_k_cols = 4;
+                constexpr int rank_k_vectors = Vec::width == 16 ? 4 : 2;
+                constexpr int rank_k_tile = rank_k_vectors*Vec::width;
+                constexpr int rank_k_rows = 2048;
+
+                int GemvMin(int x, int y) { return x < y ? x : y; }
+
+                /** y = a*x for a column major a, every column of a is one multiply-add into y
+                 */
+                void GemvColumns(int m, int k, const float* a, int64_t lda, const float* x, int64_t incx, float* y) {
+                    int row = 0;
+
+                    for (; row + gemv_rows <= m; row += gemv_rows) {
+                        Vec::Type sum[gemv_vectors];
+                        for (int v = 0; v < gemv_vectors; v++) sum[v] = Vec::Zero();
+
+                        const float* a_rows = a + row;
+                        for (int i = 0; i < k; i++, a_rows += lda) {
+                            const Vec::Type x_i = Vec::Set(x[i*incx]);
+                            for (int v = 0; v < gemv_vectors; v++) sum[v] = Vec::FmAdd(Vec::LoadU(a_rows + v*Vec::width), x_i, sum[v]);
+                        }
+
+                        for (int v = 0; v < gemv_vectors; v++) Vec::StoreU(y + row + v*Vec::width, sum[v]);
+                    }
+
+                    // then one vector at a time
+                    for (; row + Vec::width <= m; row += Vec::width) {
+                        Vec::Type sum = Vec::Zero();
+
+                        const float* a_rows = a + row;
+                        for (int i = 0; i < k; i++, a_rows += lda) sum = Vec::FmAdd(Vec::LoadU(a_rows), Vec::Set(x[i*incx]), sum);
+
+                        Vec::StoreU(y + row, sum);
+                    }
+
+                    // the last few rows, still going down the columns
+                    if (row == m) return;
+
+                    for (int r = row; r < m; r++) y[r] = 0.0f;
+
+                    for (int i = 0; i < k; i++) {
+                        const float* a_col = a + i*lda;
+                        const float x_i = x[i*incx];
+                        for (int r = row; r < m; r++) y[r] += a_col[r]*x_i;
+                    }
+                }
+
+                /** y = a*x for a row major a, every element of y is a dot product of a row of a
+                 *  and the contiguous x. four rows are done at once so x is loaded once for all of them
+                 */
+                void GemvRows(int m, int k, const float* a, int64_t lda, const float* x, float* y) {
+                    constexpr int rows_at_once = 4;
+
+                    alignas(64) float lanes[Vec::width];
+
+                    auto Reduce = [&](Vec::Type sum) {
+                        Vec::StoreU(lanes, sum);
+
+                        float total = 0.0f;
+                        for (int lane = 0; lane < Vec::width; lane++) total += lanes[lane];
+                        return total;
+                    };
+
+                    const int k_vectors = k/Vec::width*Vec::width;
+
+                    int row = 0;
+                    for (; row + rows_at_once <= m; row += rows_at_once) {
+                        Vec::Type sum[rows_at_once];
+                        for (int r = 0; r < rows_at_once; r++) sum[r] = Vec::Zero();
+
+                        for (int i = 0; i < k_vectors; i += Vec::width) {
+                            const Vec::Type x_i = Vec::LoadU(x + i);
+                            for (int r = 0; r < rows_at_once; r++) sum[r] = Vec::FmAdd(Vec::LoadU(a + (row + r)*lda + i), x_i, sum[r]);
+                        }
+
+                        for (int r = 0; r < rows_at_once; r++) {
+                            const float* a_row = a + (row + r)*lda;
+
+                            float total = Reduce(sum[r]);
+                            for (int i = k_vectors; i < k; i++) total += a_row[i]*x[i];
+
+                            y[row + r] = total;
+                        }
+                    }
+
+                    for (; row < m; row++) {
+                        const float* a_row = a + row*lda;
+
+                        Vec::Type sum = Vec::Zero();
+                        for (int i = 0; i < k_vectors; i += Vec::width) sum = Vec::FmAdd(Vec::LoadU(a_row + i), Vec::LoadU(x + i), sum);
+
+                        float total = Reduce(sum);
+                        for (int i = k_vectors; i < k; i++) total += a_row[i]*x[i];
+
+                        y[row] = total;
+                    }
+                }
+
+                /** y = a*x for an m x k a, a(row, i) is a[row*a_rs + i*a_cs], x(i) is x[i*incx] and y is
+                 *  contiguous. a row major a with a strided x copies x into x_packed, which holds k floats
+                 */
+                void GemvKernel(int m, int k, const float* a, int64_t a_rs, int64_t a_cs,
+                                const float* x, int64_t incx, float* y, float* x_packed) {
+                    if (a_rs == 1) {
+                        GemvColumns(m, k, a, a_cs, x, incx, y);
+                        return;
+                    }
+
+                    if (a_cs == 1) {
+                        if (incx != 1) {
+                            for (int i = 0; i < k; i++) x_packed[i] = x[i*incx];
+                            x = x_packed;
+                        }
+
+                        GemvRows(m, k, a, a_rs, x, y);
+                        return;
+                    }
+
+                    // neither way round is contiguous
+                    for (int row = 0; row < m; row++) {
+                        float total = 0.0f;
+                        for (int i = 0; i < k; i++) total += a[row*a_rs + i*a_cs]*x[i*incx];
+                        y[row] = total;
+                    }
+                }
+
+                /** c = a*b for the Vectors*width x rank_k_cols tile of c at c, from the column major a
+                 *  and the rank_k_cols columns of b at b
+                 */
+                template <int Vectors>
+                void RankKTile(int k, const float* a, int64_t lda, const float* b, int64_t b_rs, int64_t b_cs, float* c, int64_t ldc) {
+                    Vec::Type sum[rank_k_cols][Vectors];
+                    for (int j = 0; j < rank_k_cols; j++) {
+                        for (int v = 0; v < Vectors; v++) sum[j][v] = Vec::Zero();
+                    }
+
+                    for (int i = 0; i < k; i++) {
+                        const float* a_col = a + i*lda;
+
+                        Vec::Type a_i[Vectors];
+                        for (int v = 0; v < Vectors; v++) a_i[v] = Vec::LoadU(a_col + v*Vec::width);
+
+                        for (int j = 0; j < rank_k_cols; j++) {
+                            const Vec::Type b_ij = Vec::Set(b[i*b_rs + j*b_cs]);
+                            for (int v = 0; v < Vectors; v++) sum[j][v] = Vec::FmAdd(a_i[v], b_ij, sum[j][v]);
+                        }
+                    }
+
+                    for (int j = 0; j < rank_k_cols; j++) {
+                        for (int v = 0; v < Vectors; v++) Vec::StoreU(c + j*ldc + v*Vec::width, sum[j][v]);
+                    }
+                }
+
+                /** c = a*b for a small k, as a sum of k outer products of the columns of a with the
+                 *  rows of b. every column of c is written once straight from registers, which beats
+                 *  packing b when there is too little k to pay for it. each block of rows of a is
+                 *  copied into a_packed with its columns aligned, which holds m rounded up to 16
+                 *  (but at most rank_k_rows) times k floats
+                 */
+                void RankKKernel(int m, int n, int k,
+                                 const float* a, int64_t a_rs, int64_t a_cs,
+                                 const float* b, int64_t b_rs, int64_t b_cs,
+                                 float* c, int64_t ldc, float* a_packed) {
+                    for (int first = 0; first < m; first += rank_k_rows) {
+                        const int rows = GemvMin(rank_k_rows, m - first);
+
+                        // a is small next to c, copying it keeps every load of it on one cache line
+                        const int64_t lda = (rows + 15)/16*16;
+                        const float* a_block = a_packed;
+
+                        for (int i = 0; i < k; i++) {
+                            const float* a_col = a + first*a_rs + i*a_cs;
+                            for (int row = 0; row < rows; row++) a_packed[row + i*lda] = a_col[row*a_rs];
+                        }
+
+                        int col = 0;
+                        for (; col + rank_k_cols <= n; col += rank_k_cols) {
+                            const float* b_cols = b + col*b_cs;
+                            float* c_cols = c + first + col*ldc;
+
+                            int row = 0;
+                            for (; row + rank_k_tile <= rows; row += rank_k_tile) {
+                                RankKTile<rank_k_vectors>(k, a_block + row, lda, b_cols, b_rs, b_cs, c_cols + row, ldc);
+                            }
+
+                            // then one vector at a time, and the last few rows down the columns
+                            for (; row + Vec::width <= rows; row += Vec::width) {
+                                RankKTile<1>(k, a_block + row, lda, b_cols, b_rs, b_cs, c_cols + row, ldc);
+                            }
+
+                            if (row == rows) continue;
+
+                            for (int j = 0; j < rank_k_cols; j++) {
+                                GemvColumns(rows - row, k, a_block + row, lda, b_cols + j*b_cs, b_rs, c_cols + row + j*ldc);
+                            }
+                        }
+
+                        // the columns past the last group of rank_k_cols
+                        for (; col < n; col++) {
+                            GemvColumns(rows, k, a_block, lda, b + col*b_cs, b_rs, c + first + col*ldc);
+                        }
+                    }
+                }
+
+            } // namespace
+
+        } // namespace MATRIX_MULTIPLY_ISA
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
+
+#endif // #ifndef MATRIX_MULTIPLY_GEMV_KERNEL_H
@@ -0,0 +1,49 @@
+/*
+MatrixMultiplyKernels.cpp
+Evan Newman
+*/
+
+#include "MatrixMultiplyKernels.h"
+
+// System
+#include <atomic>
+
+// Local
+#include "Util/CpuInfo.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        namespace {
+
+            const KernelTable* TableFor(Util::Isa isa) {
+                switch (isa) {
+                    case Util::Isa::Avx512: return &Avx512::kernel_table;
+                    case Util::Isa::Avx2: return &Avx2::kernel_table;
+                    case Util::Isa::Sse42: return &Sse42::kernel_table;
+                    case Util::Isa::Generic: break;
+                }
+                return &Generic::kernel_table;
+            }
+
+            // picked on first use, so before any kernel runs
+            std::atomic<const KernelTable*>& SelectedTable() {
+                static std::atomic<const KernelTable*> selected(TableFor(Util::DetectIsa()));
+                return selected;
+            }
+
+        } // namespace
+
+        const KernelTable& Kernels() {
+            return *SelectedTable().load(std::memory_order_acquire);
+        }
+
+        bool SelectKernels(Util::Isa isa) {
+            if (isa > Util::DetectIsa()) return false;
+
+            SelectedTable().store(TableFor(isa), std::memory_order_release);
+            return true;
+        }
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
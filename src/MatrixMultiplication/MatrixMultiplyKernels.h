@@ -0,0 +1,180 @@
+/*
+MatrixMultiplyKernels.h the instruction set specific kernels and the runtime dispatch between them
+Evan Newman
+*/
+
+#ifndef MATRIX_MULTIPLY_KERNELS_H
+#define MATRIX_MULTIPLY_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Util/CpuInfo.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        /** the GemmEpilogue as plain data, so it can be handed to kernels compiled for another
+         *  instruction set without them calling any of its inline functions
+         */
+        struct EpilogueParams {
+            enum BiasMode { no_bias, per_row, per_column };
+
+            BiasMode bias_mode;
+            const float* bias;
+
+            bool clamp;
+            float clamp_min;
+            float clamp_max;
+
+            // called for every finished tile when set, context is passed through untouched
+            void (*tile_func)(const void* context, float* tile, int64_t ld, int row, int col, int rows, int cols);
+            const void* tile_context;
+        };
+
+        /** one build of the kernels, there is one table per instruction set
+         */
+        struct KernelTable {
+            const char* name;
+
+            // the register and cache blocking of the packed gemm, the packing buffers
+            // need mc*kc floats for a and kc*nc floats for b
+            int mr;
+            int nr;
+            int mc;
+            int kc;
+            int nc;
+
+            /** c = epilogue(alpha*a*b + beta*c) for m x k a, k x n b and column major m x n c.
+             *  a(row, i) is a[row*a_rs + i*a_cs] and b(i, col) is b[i*b_rs + col*b_cs], so either
+             *  can be a transposed or strided view. the sizes are checked by the caller
+             */
+            void (*gemm)(int m, int n, int k, float alpha,
+                         const float* a, int64_t a_rs, int64_t a_cs,
+                         const float* b, int64_t b_rs, int64_t b_cs,
+                         float beta, float* c, int64_t ldc,
+                         const EpilogueParams* epilogue, float* a_packed, float* b_packed);
+
+            /** pack_b packs all of a k x n b for gemm_prepacked, which is gemm reading its b from
+             *  there instead of packing it every call. b_packed holds k*(n rounded up to nr) floats
+             *  and only fits the table that packed it
+             */
+            void (*pack_b)(int k, int n, const float* b, int64_t b_rs, int64_t b_cs, float* b_packed);
+            void (*gemm_prepacked)(int m, int n, int k, float alpha,
+                                   const float* a, int64_t a_rs, int64_t a_cs,
+                                   const float* b_packed,
+                                   float beta, float* c, int64_t ldc,
+                                   const EpilogueParams* epilogue, float* a_packed);
+
+            /** y = a*x for an m x k a, a(row, i) is a[row*a_rs + i*a_cs] and x(i) is x[i*incx].
+             *  y is contiguous and x_packed holds k floats
+             */
+            void (*gemv)(int m, int k, const float* a, int64_t a_rs, int64_t a_cs,
+                         const float* x, int64_t incx, float* y, float* x_packed);
+
+            /** c = a*b for a small k, strided like gemm. a_packed holds min(m rounded up to 16, 2048)*k floats
+             */
+            void (*rank_k)(int m, int n, int k,
+                           const float* a, int64_t a_rs, int64_t a_cs,
+                           const float* b, int64_t b_rs, int64_t b_cs,
+                           float* c, int64_t ldc, float* a_packed);
+
+            /** the kernels behind MatMultBatchedStrided and MatMultBatched
+             */
+            void (*batched_strided)(int rows, int cols, int k,
+                                    const float* a, int64_t stride_a,
+                                    const float* b, int64_t stride_b,
+                                    float* c, int64_t stride_c,
+                                    size_t batch_count);
+            void (*batched)(int rows, int cols, int k,
+                            const float* const* a, const float* const* b, float* const* c,
+                            size_t batch_count);
+
+            /** c = a*b for a sparse rows x k a and dense k x n b and c, ptr/idx/values are the
+             *  compressed rows of a for sparse_csr and its compressed columns for sparse_csc.
+             *  b(i, col) is b[i*b_rs + col*b_cs]. b_packed holds k*sparse_panel floats and
+             *  c_packed rows*sparse_panel floats
+             */
+            int sparse_panel;
+            void (*sparse_csr)(int rows, int k, int n,
+                               const int* ptr, const int* idx, const float* values,
+                               const float* b, int64_t b_rs, int64_t b_cs, float* c, int64_t ldc,
+                               float* b_packed, float* c_packed);
+            void (*sparse_csc)(int rows, int k, int n,
+                               const int* ptr, const int* idx, const float* values,
+                               const float* b, int64_t b_rs, int64_t b_cs, float* c, int64_t ldc,
+                               float* b_packed, float* c_packed);
+
+            /** the loops of MatMultSimple and MatMultSimpleOptimized, c = a*b strided like gemm
+             */
+            void (*simple)(int m, int n, int k,
+                           const float* a, int64_t a_rs, int64_t a_cs,
+                           const float* b, int64_t b_rs, int64_t b_cs,
+                           float* c, int64_t ldc);
+            void (*simple_optimized)(int m, int n, int k,
+                                     const float* a, int64_t a_rs, int64_t a_cs,
+                                     const float* b, int64_t b_rs, int64_t b_cs,
+                                     float* c, int64_t ldc);
+
+            /** c += a*b over all of k for the block_height x block_width tile of c at (c_row, c_col),
+             *  a and b are the whole operands strided like gemm. tiled_tile holds the kernel of
+             *  MatMultTiled and tiled_optimized_tile the one of MatMultTiledOptimized for every
+             *  size in TiledBlockSizes, in order
+             */
+            using TileKernel = void (*)(const float* a, int64_t a_rs, int64_t a_cs,
+                                        const float* b, int64_t b_rs, int64_t b_cs, int k,
+                                        float* c, int64_t ldc, int c_row, int c_col, int block_width, int block_height);
+            const TileKernel* tiled_tile;
+            const TileKernel* tiled_optimized_tile;
+
+            /** c += a*b for a leaf of MatMultCacheObliviousOptimized, a is column major. oblivious_fixed
+             *  holds a kernel for exactly BlockSize rows for every size in CacheObliviousBlockSizes,
+             *  in order, and oblivious_ragged takes any number of rows
+             */
+            using BlockKernel = void (*)(const float* a, int64_t lda, const float* b, int64_t b_rs, int64_t b_cs,
+                                         float* c, int64_t ldc, uint64_t col_size, uint64_t k_size);
+            const BlockKernel* oblivious_fixed;
+            void (*oblivious_ragged)(const float* a, int64_t lda, const float* b, int64_t b_rs, int64_t b_cs,
+                                     float* c, int64_t ldc, uint64_t row_size, uint64_t col_size, uint64_t k_size);
+
+            /** out = x + y and out = x - y for the additions of MatMultStrassen, x and y are strided
+             *  like gemm and out may alias either of them
+             */
+            void (*matrix_add)(int rows, int cols,
+                               const float* x, int64_t x_rs, int64_t x_cs,
+                               const float* y, int64_t y_rs, int64_t y_cs,
+                               float* out, int64_t ldo);
+            void (*matrix_sub)(int rows, int cols,
+                               const float* x, int64_t x_rs, int64_t x_cs,
+                               const float* y, int64_t y_rs, int64_t y_cs,
+                               float* out, int64_t ldo);
+
+            /** peak_flops flops per iteration on registers alone, for measuring the peak flop
+             *  rate. returns a sum of the results so the work can't be dropped
+             */
+            int peak_flops;
+            float (*peak_fma)(int64_t iterations);
+        };
+
+        namespace Generic { extern const KernelTable kernel_table; }
+        namespace Sse42 { extern const KernelTable kernel_table; }
+        namespace Avx2 { extern const KernelTable kernel_table; }
+        namespace Avx512 { extern const KernelTable kernel_table; }
+
+        /** the kernels in use, the newest instruction set this processor supports
+         *  unless SelectKernels picked another one
+         */
+        const KernelTable& Kernels();
+
+        /** switches every kernel to the build for isa
+         *
+         * \param isa the instruction set to use
+         *
+         * \return false, leaving the kernels alone, if this processor doesn't support isa
+         */
+        bool SelectKernels(Util::Isa isa);
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
+
+#endif // #ifndef MATRIX_MULTIPLY_KERNELS_H
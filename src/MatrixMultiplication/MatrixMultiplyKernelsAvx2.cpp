@@ -0,0 +1,47 @@
+/*
+MatrixMultiplyKernelsAvx2.cpp the kernels built for avx2 and fma, the compile flags are set in CMakeLists.txt
+Evan Newman
+*/
+
+#define MATRIX_MULTIPLY_ISA Avx2
+
+#include "MatrixMultiplyKernels.h"
+#include "MatrixMultiplyGemmKernel.h"
+#include "MatrixMultiplyGemvKernel.h"
+#include "MatrixMultiplyBatchedKernel.h"
+#include "MatrixMultiplySparseKernel.h"
+#include "MatrixMultiplyLoopKernel.h"
+#include "MatrixMultiplyPeakKernel.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+        namespace Avx2 {
+
+            const KernelTable kernel_table = {
+                "avx2",
+                MR, NR, MC, KC, NC,
+                GemmKernel,
+                PackBKernel,
+                GemmPrepackedKernel,
+                GemvKernel,
+                RankKKernel,
+                BatchedStridedKernel,
+                BatchedKernel,
+                sparse_panel,
+                SparseCsrKernel,
+                SparseCscKernel,
+                SimpleKernel,
+                SimpleOptimizedKernel,
+                TiledTileKernels::tile,
+                TiledTileKernels::optimized_tile,
+                ObliviousFixedKernels::fixed,
+                ObliviousRaggedKernel,
+                ElementWiseKernel<false>,
+                ElementWiseKernel<true>,
+                peak_flops,
+                PeakFmaKernel
+            };
+
+        } // namespace Avx2
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
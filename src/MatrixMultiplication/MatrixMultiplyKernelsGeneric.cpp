@@ -0,0 +1,47 @@
+/*
+MatrixMultiplyKernelsGeneric.cpp the kernels built for the default target of the compiler, used when nothing newer is supported
+Evan Newman
+*/
+
+#define MATRIX_MULTIPLY_ISA Generic
+
+#include "MatrixMultiplyKernels.h"
+#include "MatrixMultiplyGemmKernel.h"
+#include "MatrixMultiplyGemvKernel.h"
+#include "MatrixMultiplyBatchedKernel.h"
+#include "MatrixMultiplySparseKernel.h"
+#include "MatrixMultiplyLoopKernel.h"
+#include "MatrixMultiplyPeakKernel.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+        namespace Generic {
+
+            const KernelTable kernel_table = {
+                "generic",
+                MR, NR, MC, KC, NC,
+                GemmKernel,
+                PackBKernel,
+                GemmPrepackedKernel,
+                GemvKernel,
+                RankKKernel,
+                BatchedStridedKernel,
+                BatchedKernel,
+                sparse_panel,
+                SparseCsrKernel,
+                SparseCscKernel,
+                SimpleKernel,
+                SimpleOptimizedKernel,
+                TiledTileKernels::tile,
+                TiledTileKernels::optimized_tile,
+                ObliviousFixedKernels::fixed,
+                ObliviousRaggedKernel,
+                ElementWiseKernel<false>,
+                ElementWiseKernel<true>,
+                peak_flops,
+                PeakFmaKernel
+            };
+
+        } // namespace Generic
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
@@ -0,0 +1,47 @@
+/*
+MatrixMultiplyKernelsSse42.cpp the kernels built for sse4.2, the compile flags are set in CMakeLists.txt
+Evan Newman
+*/
+
+#define MATRIX_MULTIPLY_ISA Sse42
+
+#include "MatrixMultiplyKernels.h"
+#include "MatrixMultiplyGemmKernel.h"
+#include "MatrixMultiplyGemvKernel.h"
+#include "MatrixMultiplyBatchedKernel.h"
+#include "MatrixMultiplySparseKernel.h"
+#include "MatrixMultiplyLoopKernel.h"
+#include "MatrixMultiplyPeakKernel.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+        namespace Sse42 {
+
+            const KernelTable kernel_table = {
+                "sse4.2",
+                MR, NR, MC, KC, NC,
+                GemmKernel,
+                PackBKernel,
+                GemmPrepackedKernel,
+                GemvKernel,
+                RankKKernel,
+                BatchedStridedKernel,
+                BatchedKernel,
+                sparse_panel,
+                SparseCsrKernel,
+                SparseCscKernel,
+                SimpleKernel,
+                SimpleOptimizedKernel,
+                TiledTileKernels::tile,
+                TiledTileKernels::optimized_tile,
+                ObliviousFixedKernels::fixed,
+                ObliviousRaggedKernel,
+                ElementWiseKernel<false>,
+                ElementWiseKernel<true>,
+                peak_flops,
+                PeakFmaKernel
+            };
+
+        } // namespace Sse42
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
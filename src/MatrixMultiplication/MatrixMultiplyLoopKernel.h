@@ -0,0 +1,258 @@
+/*
+MatrixMultiplyLoopKernel.h the loops of the simple, tiled, cache oblivious and Strassen multiplies, compiled once per instruction set
+Evan Newman
+*/
+
+/* only included by the MatrixMultiplyKernels*.cpp files, see MatrixMultiplyGemmKernel.h
+ */
+
+#ifndef MATRIX_MULTIPLY_LOOP_KERNEL_H
+#define MATRIX_MULTIPLY_LOOP_KERNEL_H
+
+#ifndef MATRIX_MULTIPLY_ISA
+#error "define MATRIX_MULTIPLY_ISA before including MatrixMultiplyLoopKernel.h"
+#endif
+
+#include <cstdint>
+#include <type_traits>
+
+#include "MatrixMultiplyKernels.h"
+#include "MatrixMultiplyAutotune.h" // TiledBlockSizes, CacheObliviousBlockSizes
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+        namespace MATRIX_MULTIPLY_ISA {
+
+            namespace {
+
+                /** the naive loop of MatMultSimple
+                 */
+                void SimpleKernel(int m, int n, int k,
+                                  const float* a, int64_t a_rs, int64_t a_cs,
+                                  const float* b, int64_t b_rs, int64_t b_cs,
+                                  float* c, int64_t ldc) {
+                    for (int c_row = 0; c_row < m; c_row++) {
+                        for (int c_col = 0; c_col < n; c_col++) {
+                            c[c_row + c_col*ldc] = 0;
+
+                            for (int i = 0; i < k; i++) c[c_row + c_col*ldc] += a[c_row*a_rs + i*a_cs]*b[i*b_rs + c_col*b_cs];
+                        }
+                    }
+                }
+
+                /** the loop of MatMultSimpleOptimized, c is walked linearly and every dot product
+                 *  is summed in a register
+                 */
+                void SimpleOptimizedKernel(int m, int n, int k,
+                                           const float* a, int64_t a_rs, int64_t a_cs,
+                                           const float* b, int64_t b_rs, int64_t b_cs,
+                                           float* c, int64_t ldc) {
+                    for (int c_col = 0; c_col < n; c_col++) {
+                        for (int c_row = 0; c_row < m; c_row++) {
+                            float sum = 0;
+
+                            const float* a_current = a + c_row*a_rs;
+                            const float* b_current = b + c_col*b_cs;
+                            for (int i = 0; i < k; i++, a_current += a_cs, b_current += b_rs) sum += (*a_current)*(*b_current);
+
+                            c[c_row + c_col*ldc] = sum;
+                        }
+                    }
+                }
+
+                /** one tile of MatMultTiled, block by block over k with every element indexed from
+                 *  the corners of a and b. full blocks have compile time sizes so their loops fully unroll
+                 */
+                template <int BlockSize>
+                void TiledTileKernel(const float* a, int64_t a_rs, int64_t a_cs,
+                                     const float* b, int64_t b_rs, int64_t b_cs, int k,
+                                     float* c, int64_t ldc, int c_row, int c_col, int block_width, int block_height) {
+
+                    auto MultiplyBlock = [&](int i, auto block_width, auto block_height, auto block_i_size) {
+                        for (int c_col_block = 0; c_col_block < block_width; c_col_block++) {
+                            for (int c_row_block = 0; c_row_block < block_height; c_row_block++) {
+                                float sum = 0;
+
+                                for (int i_block = 0; i_block < block_i_size; i_block++) {
+                                    sum += a[(c_row + c_row_block)*a_rs + (i + i_block)*a_cs]*b[(i + i_block)*b_rs + (c_col + c_col_block)*b_cs];
+                                }
+
+                                c[c_row + c_row_block + (c_col + c_col_block)*ldc] += sum;
+                            }
+                        }
+                    };
+
+                    for (int i = 0; i < k; i += BlockSize) {
+                        int block_i_size = i + BlockSize >= k ? k - i : BlockSize;
+
+                        if (block_width == BlockSize && block_height == BlockSize && block_i_size == BlockSize) {
+                            constexpr std::integral_constant<int, BlockSize> full;
+                            MultiplyBlock(i, full, full, full);
+                        } else {
+                            MultiplyBlock(i, block_width, block_height, block_i_size);
+                        }
+                    }
+                }
+
+                /** one tile of MatMultTiledOptimized and MatMultTiledParallel, the same blocks as
+                 *  TiledTileKernel with the rows of a and columns of b walked by pointer
+                 */
+                template <int BlockSize>
+                void TiledOptimizedTileKernel(const float* a, int64_t a_rs, int64_t a_cs,
+                                              const float* b, int64_t b_rs, int64_t b_cs, int k,
+                                              float* c, int64_t ldc, int c_row, int c_col, int block_width, int block_height) {
+
+                    auto MultiplyBlock = [&](int i, auto block_width, auto block_height, auto block_i_size) {
+                        for (int c_col_block = 0; c_col_block < block_width; c_col_block++) {
+                            for (int c_row_block = 0; c_row_block < block_height; c_row_block++) {
+                                float sum = 0;
+
+                                const float* a_current = a + (c_row + c_row_block)*a_rs + i*a_cs;
+                                const float* b_current = b + i*b_rs + (c_col + c_col_block)*b_cs;
+                                for (int i_block = 0; i_block < block_i_size; i_block++, a_current += a_cs, b_current += b_rs) {
+                                    sum += (*a_current)*(*b_current);
+                                }
+
+                                c[c_row + c_row_block + (c_col + c_col_block)*ldc] += sum;
+                            }
+                        }
+                    };
+
+                    for (int i = 0; i < k; i += BlockSize) {
+                        int block_i_size = i + BlockSize >= k ? k - i : BlockSize;
+
+                        if (block_width == BlockSize && block_height == BlockSize && block_i_size == BlockSize) {
+                            constexpr std::integral_constant<int, BlockSize> full;
+                            MultiplyBlock(i, full, full, full);
+                        } else {
+                            MultiplyBlock(i, block_width, block_height, block_i_size);
+                        }
+                    }
+                }
+
+                /** c += a*b for a Rows x cols block of c, with Rows known at compile time so the
+                 *  row loops fully unroll and vectorize. two columns of c are accumulated in
+                 *  registers at a time to keep enough independent FMA chains in flight
+                 */
+                template <int Rows>
+                void ObliviousFixedKernel(const float* a, int64_t lda, const float* b, int64_t b_rs, int64_t b_cs, float* c, int64_t ldc,
+                                          uint64_t col_size, uint64_t k_size) {
+                    uint64_t col = 0;
+
+                    for (; col + 2 <= col_size; col += 2) {
+                        float* c_col0 = c + col*ldc;
+                        float* c_col1 = c_col0 + ldc;
+                        const float* b_col0 = b + col*b_cs;
+                        const float* b_col1 = b_col0 + b_cs;
+
+                        float sum0[Rows];
+                        float sum1[Rows];
+                        for (int row = 0; row < Rows; row++) {
+                            sum0[row] = c_col0[row];
+                            sum1[row] = c_col1[row];
+                        }
+
+                        for (uint64_t k = 0; k < k_size; k++) {
+                            const float* a_col = a + k*lda;
+                            const float b_k0 = b_col0[k*b_rs];
+                            const float b_k1 = b_col1[k*b_rs];
+
+                            for (int row = 0; row < Rows; row++) {
+                                sum0[row] += a_col[row]*b_k0;
+                                sum1[row] += a_col[row]*b_k1;
+                            }
+                        }
+
+                        for (int row = 0; row < Rows; row++) {
+                            c_col0[row] = sum0[row];
+                            c_col1[row] = sum1[row];
+                        }
+                    }
+
+                    // odd column left over
+                    for (; col < col_size; col++) {
+                        float* c_col = c + col*ldc;
+                        const float* b_col = b + col*b_cs;
+
+                        float sum[Rows];
+                        for (int row = 0; row < Rows; row++) sum[row] = c_col[row];
+
+                        for (uint64_t k = 0; k < k_size; k++) {
+                            const float* a_col = a + k*lda;
+                            const float b_k = b_col[k*b_rs];
+                            for (int row = 0; row < Rows; row++) sum[row] += a_col[row]*b_k;
+                        }
+
+                        for (int row = 0; row < Rows; row++) c_col[row] = sum[row];
+                    }
+                }
+
+                /** c += a*b for the ragged blocks along the bottom edge of c
+                 */
+                void ObliviousRaggedKernel(const float* a, int64_t lda, const float* b, int64_t b_rs, int64_t b_cs, float* c, int64_t ldc,
+                                           uint64_t row_size, uint64_t col_size, uint64_t k_size) {
+                    for (uint64_t col = 0; col < col_size; col++) {
+                        float* c_col = c + col*ldc;
+
+                        for (uint64_t k = 0; k < k_size; k++) {
+                            const float* a_col = a + k*lda;
+                            const float b_k = b[k*b_rs + col*b_cs];
+
+                            for (uint64_t row = 0; row < row_size; row++) c_col[row] += a_col[row]*b_k;
+                        }
+                    }
+                }
+
+                /** out = x + y or x - y, the additions of MatMultStrassen. columns that are
+                 *  contiguous in both inputs get a plain loop the compiler can vectorize
+                 */
+                template <bool Subtract>
+                void ElementWiseKernel(int rows, int cols,
+                                       const float* x, int64_t x_rs, int64_t x_cs,
+                                       const float* y, int64_t y_rs, int64_t y_cs,
+                                       float* out, int64_t ldo) {
+                    for (int col = 0; col < cols; col++) {
+                        const float* x_col = x + col*x_cs;
+                        const float* y_col = y + col*y_cs;
+                        float* out_col = out + col*ldo;
+
+                        if (x_rs == 1 && y_rs == 1) {
+                            for (int row = 0; row < rows; row++) out_col[row] = Subtract ? x_col[row] - y_col[row] : x_col[row] + y_col[row];
+                        } else {
+                            for (int row = 0; row < rows; row++) {
+                                out_col[row] = Subtract ? x_col[row*x_rs] - y_col[row*y_rs] : x_col[row*x_rs] + y_col[row*y_rs];
+                            }
+                        }
+                    }
+                }
+
+                /* the kernels for every candidate block size, in the order of the lists so the
+                 * callers can index them with BlockSizeIndex
+                 */
+                template <typename List>
+                struct TiledKernels;
+
+                template <int... Sizes>
+                struct TiledKernels<BlockSizeList<Sizes...>> {
+                    static constexpr KernelTable::TileKernel tile[] = {TiledTileKernel<Sizes>...};
+                    static constexpr KernelTable::TileKernel optimized_tile[] = {TiledOptimizedTileKernel<Sizes>...};
+                };
+
+                template <typename List>
+                struct ObliviousKernels;
+
+                template <int... Sizes>
+                struct ObliviousKernels<BlockSizeList<Sizes...>> {
+                    static constexpr KernelTable::BlockKernel fixed[] = {ObliviousFixedKernel<Sizes>...};
+                };
+
+                using TiledTileKernels = TiledKernels<TiledBlockSizes>;
+                using ObliviousFixedKernels = ObliviousKernels<CacheObliviousBlockSizes>;
+
+            } // namespace
+
+        } // namespace MATRIX_MULTIPLY_ISA
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
+
+#endif // #ifndef MATRIX_MULTIPLY_LOOP_KERNEL_H
@@ -0,0 +1,95 @@
+/*
+MatrixMultiplyNuma.cpp
+Evan Newman
+*/
+
+#include "MatrixMultiplyNuma.h"
+
+// System
+#include <stdexcept>
+#include <cstdint>
+#include <algorithm>
+
+// Libraries
+#include <eigen3/Eigen/Core>
+
+// Local
+#include "MatrixMultiplyGemm.h"
+
+#include "Util/Numa.h"
+#include "Util/ThreadPool.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        namespace {
+
+            // slabs start on a multiple of this many columns, a whole number of gemm micro-panels
+            constexpr int64_t slab_alignment = 16;
+
+        } // namespace
+
+        void NumaSlab(int64_t n, unsigned queue, unsigned num_queues, int64_t& first, int64_t& count) {
+            auto Start = [&](unsigned q) {
+                int64_t start = n*q/num_queues/slab_alignment*slab_alignment;
+                return q == num_queues ? n : start;
+            };
+
+            first = Start(queue);
+            count = Start(queue + 1) - first;
+        }
+
+        void PlaceMatrix(Eigen::Ref<Eigen::MatrixXf> x, const Util::ThreadPool& pool, NumaPlacement placement) {
+            if (x.size() == 0) return;
+
+            if (placement == NumaPlacement::Interleave) {
+                Util::InterleavePages(x.data(), (x.outerStride()*(x.cols() - 1) + x.rows())*sizeof(float));
+                return;
+            }
+
+            for (unsigned queue = 0; queue < pool.NumThreads(); queue++) {
+                int64_t first, count;
+                NumaSlab(x.cols(), queue, pool.NumThreads(), first, count);
+                if (count == 0) continue;
+
+                // a slab runs from its first column to the end of its last
+                const size_t bytes = (x.outerStride()*(count - 1) + x.rows())*sizeof(float);
+                Util::BindPages(x.col(first).data(), bytes, pool.QueueNode(queue));
+            }
+        }
+
+        void MatMultNuma(const Eigen::Ref<const Eigen::MatrixXf> a,
+                         const Eigen::Ref<const Eigen::MatrixXf> b,
+                         Eigen::Ref<Eigen::MatrixXf> c,
+                         Util::ThreadPool& pool,
+                         Op op_a,
+                         Op op_b) {
+
+            const Operand a_op(a, op_a);
+            const Operand b_op(b, op_b);
+
+            // Ensure the inputs are ok for matrix multiplication
+            if (a_op.rows != c.rows()
+               || a_op.cols != b_op.rows
+               || b_op.cols != c.cols()) {
+                   throw std::invalid_argument("matrices a, b, and c have incompatible sizes");
+            }
+
+            const unsigned num_queues = pool.NumThreads();
+
+            // every slab runs on the thread owning its queue, pinned to the node its columns were placed on
+            pool.RunOnEach([&](unsigned queue) {
+                int64_t first, count;
+                NumaSlab(c.cols(), queue, num_queues, first, count);
+                if (count == 0) return;
+
+                auto c_slab = c.middleCols(first, count);
+
+                // the columns of op(b) are the rows of a transposed b
+                if (op_b == Op::None) Gemm(1.0f, a, op_a, b.middleCols(first, count), Op::None, 0.0f, c_slab);
+                else Gemm(1.0f, a, op_a, b.middleRows(first, count), Op::Transpose, 0.0f, c_slab);
+            });
+        }
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
@@ -0,0 +1,66 @@
+/*
+MatrixMultiplyNuma.h
+Evan Newman
+*/
+
+#ifndef MATRIX_MULTIPLY_NUMA_H
+#define MATRIX_MULTIPLY_NUMA_H
+
+#include <cstdint>
+
+#include <eigen3/Eigen/Core>
+
+#include "MatrixMultiplyOperand.h"
+
+#include "Util/ThreadPool.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        /** where the pages of a matrix should live
+         */
+        enum class NumaPlacement {
+            Columns,   // the columns MatMultNuma gives each queue of the pool on that queue's node
+            Interleave // round robin over every node, for an operand every thread reads
+        };
+
+        /** the columns [first, first + count) of an n column c that MatMultNuma computes on
+         *  the given queue of a pool with num_queues queues. the slabs are whole multiples of
+         *  16 columns apart from the last
+         */
+        void NumaSlab(int64_t n, unsigned queue, unsigned num_queues, int64_t& first, int64_t& count);
+
+        /** moves the pages of x where the placement says, pages already touched are migrated
+         *  and the rest go there on first touch. does nothing on machines without numa
+         *
+         * \param x the matrix to place
+         * \param pool the pool whose queues decide the nodes of the columns
+         * \param placement how to spread x over the nodes
+         */
+        void PlaceMatrix(Eigen::Ref<Eigen::MatrixXf> x, const Util::ThreadPool& pool, NumaPlacement placement);
+
+        /** Performs op(a)*op(b) = c with c split into one slab of columns per thread of the
+         *  pool (see NumaSlab), each computed by Gemm on the thread that owns its queue and
+         *  never stolen, see ThreadPool::RunOnEach. With a pool pinned with Pinning::Nodes,
+         *  c and op(b) placed by columns and a interleaved, every thread writes only memory
+         *  on its own node and reads op(b) from it too
+         *
+         * \param a the input matrix a
+         * \param b the input matrix b
+         * \param pool the thread pool to run the slabs on
+         * \param op_a whether to use a or its transpose
+         * \param op_b whether to use b or its transpose
+         *
+         * \return the resulting matrix c
+         */
+        void MatMultNuma(const Eigen::Ref<const Eigen::MatrixXf> a,
+                         const Eigen::Ref<const Eigen::MatrixXf> b,
+                         Eigen::Ref<Eigen::MatrixXf> c,
+                         Util::ThreadPool& pool,
+                         Op op_a = Op::None,
+                         Op op_b = Op::None);
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
+
+#endif // #ifndef MATRIX_MULTIPLY_NUMA_H
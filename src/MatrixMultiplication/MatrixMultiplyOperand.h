@@ -0,0 +1,58 @@
+/*
+MatrixMultiplyOperand.h
+Evan Newman
+*/
+
+#ifndef MATRIX_MULTIPLY_OPERAND_H
+#define MATRIX_MULTIPLY_OPERAND_H
+
+#include <cstdint>
+
+#include <eigen3/Eigen/Core>
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        /** what a kernel does to an input before multiplying, like the trans flags of BLAS.
+         *  a row major matrix x is the column major matrix x^T in the same memory, so passing
+         *  x.transpose() with Op::Transpose multiplies by x without copying it. blocks of a
+         *  larger matrix keep the outer stride of the larger matrix and aren't copied either
+         */
+        enum class Op {
+            None,     // use the matrix as is
+            Transpose // use its transpose
+        };
+
+        /** where the elements of op(x) live for a column major x with any outer stride,
+         *  op(x)(row, col) is data[row*row_stride + col*col_stride]. every kernel reads its
+         *  inputs through one of these so it can pack or index straight from the caller's memory
+         */
+        struct Operand {
+            Operand(const Eigen::Ref<const Eigen::MatrixXf>& x, Op op)
+                : data(x.data()),
+                  rows(op == Op::None ? x.rows() : x.cols()),
+                  cols(op == Op::None ? x.cols() : x.rows()),
+                  row_stride(op == Op::None ? 1 : x.outerStride()),
+                  col_stride(op == Op::None ? x.outerStride() : 1) {}
+
+            Operand(const float* data, int64_t rows, int64_t cols, int64_t row_stride, int64_t col_stride)
+                : data(data), rows(rows), cols(cols), row_stride(row_stride), col_stride(col_stride) {}
+
+            // the rows x cols block starting at (row, col)
+            Operand Block(int64_t row, int64_t col, int64_t block_rows, int64_t block_cols) const {
+                return Operand(data + row*row_stride + col*col_stride, block_rows, block_cols, row_stride, col_stride);
+            }
+
+            float operator()(int64_t row, int64_t col) const { return data[row*row_stride + col*col_stride]; }
+
+            const float* data;
+            int64_t rows;
+            int64_t cols;
+            int64_t row_stride;
+            int64_t col_stride;
+        };
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
+
+#endif // #ifndef MATRIX_MULTIPLY_OPERAND_H
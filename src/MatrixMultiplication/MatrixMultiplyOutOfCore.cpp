@@ -0,0 +1,343 @@
+/*
+MatrixMultiplyOutOfCore.cpp
+Evan Newman
+*/
+
+#include "MatrixMultiplyOutOfCore.h"
+
+// System
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Libraries
+#include <eigen3/Eigen/Core>
+
+// Local
+#include "MatrixMultiplyGemm.h"
+
+#include "Util/AlignedBuffer.h"
+#include "Util/MappedFile.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        namespace {
+
+            // the header as it is laid out in the file, the sizes are little endian like the cpus we run on
+            struct MatrixFileHeader {
+                char magic[8];
+                uint64_t rows;
+                uint64_t cols;
+                char padding[40];
+            };
+
+            static_assert(sizeof(MatrixFileHeader) == MatrixFile::header_size, "the matrix file header is 64 bytes");
+
+            constexpr char matrix_file_magic[8] = {'O', 'T', 'M', 'A', 'T', 'R', 'I', 'X'};
+
+            /** the bytes of a rows x cols matrix file, throws if it doesn't fit a size_t
+             */
+            size_t MatrixFileSize(uint64_t rows, uint64_t cols) {
+                const uint64_t max_elements = (std::numeric_limits<size_t>::max() - MatrixFile::header_size)/sizeof(float);
+                if (cols != 0 && rows > max_elements/cols) throw std::length_error("the matrix is too large to map");
+
+                return MatrixFile::header_size + rows*cols*sizeof(float);
+            }
+
+            /** the side of the square blocks that fit the working set, two pairs of
+             *  panels of a and b for the prefetch and one block of c
+             */
+            uint64_t OutOfCoreBlockSize(size_t working_set_bytes) {
+                uint64_t block = static_cast<uint64_t>(std::sqrt(working_set_bytes/(5.0*sizeof(float))));
+
+                // whole cache blocks of the gemm kernel
+                return std::max<uint64_t>(64, block/64*64);
+            }
+
+            /** one block product of the stream, c(row, col) += a(row, k)*b(k, col)
+             */
+            struct OutOfCoreStep {
+                uint64_t row;
+                uint64_t rows;
+                uint64_t col;
+                uint64_t cols;
+                uint64_t k;
+                uint64_t ks;
+            };
+
+            struct OutOfCorePanels {
+                Util::AlignedBuffer<float> a;
+                Util::AlignedBuffer<float> b;
+            };
+
+            /** copies the rows x cols block at (row, col) of a matrix file into a dense buffer,
+             *  then drops it from the mapping since only the copy is used from here on
+             */
+            void CopyBlock(const MatrixFile& matrix, uint64_t row, uint64_t rows, uint64_t col, uint64_t cols, float* block) {
+                matrix.WillNeedBlock(row, rows, col, cols);
+
+                const float* data = matrix.Data();
+                for (uint64_t j = 0; j < cols; j++) {
+                    std::memcpy(block + j*rows, data + row + (col + j)*matrix.Rows(), rows*sizeof(float));
+                }
+
+                matrix.DontNeedBlock(row, rows, col, cols);
+            }
+
+            /** one thread kept for the whole multiply that reads the panels of the next step
+             *  while the current one computes, rather than starting a thread every step.
+             *  the reads block on page faults, so they stay off the gemm's thread pool
+             */
+            class PanelPrefetcher {
+            public:
+                explicit PanelPrefetcher(std::function<void(size_t)> load)
+                    : _load(std::move(load)), _step(0), _pending(false), _stop(false), _thread(&PanelPrefetcher::Loop, this) {}
+
+                ~PanelPrefetcher() {
+                    {
+                        std::lock_guard<std::mutex> lock(_mutex);
+                        _stop = true;
+                    }
+                    _wake.notify_one();
+                    _thread.join();
+                }
+
+                PanelPrefetcher(const PanelPrefetcher&) = delete;
+                PanelPrefetcher& operator=(const PanelPrefetcher&) = delete;
+
+                // starts load(step) on the prefetch thread, the previous load must have been waited for
+                void Start(size_t step) {
+                    {
+                        std::lock_guard<std::mutex> lock(_mutex);
+                        _step = step;
+                        _pending = true;
+                    }
+                    _wake.notify_one();
+                }
+
+                // waits for the load started last and rethrows anything it threw
+                void Wait() {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _done.wait(lock, [this]() { return !_pending; });
+
+                    if (_error) std::rethrow_exception(std::exchange(_error, nullptr));
+                }
+
+            private:
+                void Loop() {
+                    std::unique_lock<std::mutex> lock(_mutex);
+
+                    while (true) {
+                        _wake.wait(lock, [this]() { return _stop || _pending; });
+                        if (_pending) {
+                            const size_t step = _step;
+                            lock.unlock();
+
+                            std::exception_ptr error;
+                            try {
+                                _load(step);
+                            } catch (...) {
+                                error = std::current_exception();
+                            }
+
+                            lock.lock();
+                            _error = error;
+                            _pending = false;
+                            _done.notify_one();
+                        } else {
+                            return;
+                        }
+                    }
+                }
+
+                std::function<void(size_t)> _load;
+
+                std::mutex _mutex;
+                std::condition_variable _wake;
+                std::condition_variable _done;
+                size_t _step;
+                bool _pending;
+                bool _stop;
+                std::exception_ptr _error;
+
+                std::thread _thread; // last, it starts running Loop as soon as it is constructed
+            };
+
+        } // namespace
+
+        MatrixFile::MatrixFile(const std::string& path, Util::MappedFile::Mode mode)
+            : _file(path, mode), _rows(0), _cols(0) {
+
+            MatrixFileHeader header;
+            if (_file.Size() < header_size) throw std::runtime_error(path + " is not a matrix file");
+
+            std::memcpy(&header, std::as_const(_file).Data(), header_size);
+            if (std::memcmp(header.magic, matrix_file_magic, sizeof(header.magic)) != 0) {
+                throw std::runtime_error(path + " is not a matrix file");
+            }
+
+            if (_file.Size() != MatrixFileSize(header.rows, header.cols)) {
+                throw std::runtime_error(path + " is truncated, its size doesn't match its header");
+            }
+
+            _rows = header.rows;
+            _cols = header.cols;
+        }
+
+        MatrixFile::MatrixFile(const std::string& path, uint64_t rows, uint64_t cols)
+            : _file(path, MatrixFileSize(rows, cols)), _rows(rows), _cols(cols) {
+
+            MatrixFileHeader header = {};
+            std::memcpy(header.magic, matrix_file_magic, sizeof(header.magic));
+            header.rows = rows;
+            header.cols = cols;
+
+            std::memcpy(_file.Data(), &header, header_size);
+        }
+
+        float* MatrixFile::Data() {
+            return reinterpret_cast<float*>(_file.Data() + header_size);
+        }
+
+        const float* MatrixFile::Data() const {
+            return reinterpret_cast<const float*>(_file.Data() + header_size);
+        }
+
+        Eigen::Map<Eigen::MatrixXf> MatrixFile::Matrix() {
+            return Eigen::Map<Eigen::MatrixXf>(Data(), _rows, _cols);
+        }
+
+        Eigen::Map<const Eigen::MatrixXf> MatrixFile::Matrix() const {
+            return Eigen::Map<const Eigen::MatrixXf>(Data(), _rows, _cols);
+        }
+
+        void MatrixFile::WillNeedBlock(uint64_t row, uint64_t rows, uint64_t col, uint64_t cols) const {
+            // whole columns are one contiguous range
+            if (row == 0 && rows == _rows) {
+                _file.WillNeed(header_size + col*_rows*sizeof(float), cols*_rows*sizeof(float));
+                return;
+            }
+
+            for (uint64_t j = col; j < col + cols; j++) {
+                _file.WillNeed(header_size + (row + j*_rows)*sizeof(float), rows*sizeof(float));
+            }
+        }
+
+        void MatrixFile::DontNeedBlock(uint64_t row, uint64_t rows, uint64_t col, uint64_t cols) const {
+            if (row == 0 && rows == _rows) {
+                _file.DontNeed(header_size + col*_rows*sizeof(float), cols*_rows*sizeof(float));
+                return;
+            }
+
+            for (uint64_t j = col; j < col + cols; j++) {
+                _file.DontNeed(header_size + (row + j*_rows)*sizeof(float), rows*sizeof(float));
+            }
+        }
+
+        void MatrixFile::Write(const std::string& path, const Eigen::Ref<const Eigen::MatrixXf> matrix) {
+            MatrixFile file(path, matrix.rows(), matrix.cols());
+            file.Matrix() = matrix;
+            file.Sync();
+        }
+
+        void MatMultOutOfCore(const MatrixFile& a,
+                              const MatrixFile& b,
+                              MatrixFile& c,
+                              size_t working_set_bytes) {
+
+            // Ensure the inputs are ok for matrix multiplication
+            if (a.Rows() != c.Rows()
+               || a.Cols() != b.Rows()
+               || b.Cols() != c.Cols()) {
+                   throw std::invalid_argument("matrices a, b, and c have incompatible sizes");
+            }
+
+            if (c.GetMode() != Util::MappedFile::Mode::ReadWrite) throw std::invalid_argument("matrix c is mapped read only");
+
+            const uint64_t m = c.Rows();
+            const uint64_t n = c.Cols();
+            const uint64_t k = a.Cols();
+
+            if (m == 0 || n == 0) return;
+
+            if (k == 0) {
+                std::memset(c.Data(), 0, m*n*sizeof(float));
+                return;
+            }
+
+            const uint64_t block = OutOfCoreBlockSize(working_set_bytes);
+            const uint64_t mb = std::min(block, m);
+            const uint64_t nb = std::min(block, n);
+            const uint64_t kb = std::min(block, k);
+
+            /* the tiled loops over blocks of c and the k panels feeding each, flattened so
+             * the panels of the next step can be read while the current step computes
+             */
+            std::vector<OutOfCoreStep> steps;
+            for (uint64_t col = 0; col < n; col += nb) {
+                for (uint64_t row = 0; row < m; row += mb) {
+                    for (uint64_t i = 0; i < k; i += kb) {
+                        steps.push_back({row, std::min(mb, m - row), col, std::min(nb, n - col), i, std::min(kb, k - i)});
+                    }
+                }
+            }
+
+            OutOfCorePanels panels[2];
+            for (OutOfCorePanels& panel : panels) {
+                panel.a.Resize(mb*kb);
+                panel.b.Resize(kb*nb);
+            }
+
+            Util::AlignedBuffer<float> c_block(mb*nb);
+
+            auto Load = [&](const OutOfCoreStep& step, OutOfCorePanels& panel) {
+                CopyBlock(a, step.row, step.rows, step.k, step.ks, panel.a.Data());
+                CopyBlock(b, step.k, step.ks, step.col, step.cols, panel.b.Data());
+            };
+
+            Load(steps.front(), panels[0]);
+
+            PanelPrefetcher prefetcher([&](size_t s) { Load(steps[s], panels[s % 2]); });
+
+            for (size_t s = 0; s < steps.size(); s++) {
+                const OutOfCoreStep& step = steps[s];
+                OutOfCorePanels& panel = panels[s % 2];
+
+                // read the next panels into the other buffers while this step computes
+                if (s + 1 < steps.size()) prefetcher.Start(s + 1);
+
+                Eigen::Map<const Eigen::MatrixXf> a_panel(panel.a.Data(), step.rows, step.ks);
+                Eigen::Map<const Eigen::MatrixXf> b_panel(panel.b.Data(), step.ks, step.cols);
+                Eigen::Map<Eigen::MatrixXf> c_panel(c_block.Data(), step.rows, step.cols);
+
+                // the first k panel overwrites the block of c, the rest add to it
+                Gemm(1.0f, a_panel, b_panel, step.k == 0 ? 0.0f : 1.0f, c_panel);
+
+                // the block of c is done, write it out and drop it
+                if (step.k + step.ks == k) {
+                    float* c_data = c.Data();
+                    for (uint64_t j = 0; j < step.cols; j++) {
+                        std::memcpy(c_data + step.row + (step.col + j)*m, c_block.Data() + j*step.rows, step.rows*sizeof(float));
+                    }
+
+                    c.DontNeedBlock(step.row, step.rows, step.col, step.cols);
+                }
+
+                // rethrows anything the prefetch threw
+                if (s + 1 < steps.size()) prefetcher.Wait();
+            }
+        }
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
@@ -0,0 +1,107 @@
+/*
+MatrixMultiplyOutOfCore.h
+Evan Newman
+*/
+
+#ifndef MATRIX_MULTIPLY_OUT_OF_CORE_H
+#define MATRIX_MULTIPLY_OUT_OF_CORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <eigen3/Eigen/Core>
+
+#include "Util/MappedFile.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        /** the working set MatMultOutOfCore keeps in memory when none is given
+         */
+        constexpr size_t default_out_of_core_working_set = size_t(1) << 30;
+
+        /** A float matrix stored in a file and mapped into memory. The file is a 64 byte
+         *  header, the 8 characters "OTMATRIX" followed by the rows and the columns as
+         *  little endian uint64s and zero padding, then the rows*cols floats column by
+         *  column like an Eigen::MatrixXf
+         */
+        class MatrixFile {
+        public:
+            static constexpr size_t header_size = 64;
+
+            /** maps an existing matrix file, throws if it isn't one
+             *
+             * \param path the matrix file
+             * \param mode whether the matrix may be written
+             */
+            explicit MatrixFile(const std::string& path, Util::MappedFile::Mode mode = Util::MappedFile::Mode::ReadOnly);
+
+            /** creates a rows x cols matrix file of zeros, replacing any file at path
+             *
+             * \param path the matrix file
+             * \param rows the rows of the matrix
+             * \param cols the columns of the matrix
+             */
+            MatrixFile(const std::string& path, uint64_t rows, uint64_t cols);
+
+            uint64_t Rows() const { return _rows; }
+            uint64_t Cols() const { return _cols; }
+            Util::MappedFile::Mode GetMode() const { return _file.GetMode(); }
+
+            /** the matrix for writing, throws std::logic_error if it was mapped read only
+             */
+            float* Data();
+            const float* Data() const;
+
+            /** the whole matrix, touching it pages it in. the writable one throws
+             *  std::logic_error if the file was mapped read only
+             */
+            Eigen::Map<Eigen::MatrixXf> Matrix();
+            Eigen::Map<const Eigen::MatrixXf> Matrix() const;
+
+            /** hints that the given rows of the given columns are about to be read
+             */
+            void WillNeedBlock(uint64_t row, uint64_t rows, uint64_t col, uint64_t cols) const;
+
+            /** drops the given rows of the given columns from memory, the columns are
+             *  read back from the file if touched again
+             */
+            void DontNeedBlock(uint64_t row, uint64_t rows, uint64_t col, uint64_t cols) const;
+
+            /** writes the matrix back to the file
+             */
+            void Sync() const { _file.Sync(); }
+
+            /** writes a matrix to a new matrix file at path
+             */
+            static void Write(const std::string& path, const Eigen::Ref<const Eigen::MatrixXf> matrix);
+
+        private:
+            Util::MappedFile _file;
+            uint64_t _rows;
+            uint64_t _cols;
+        };
+
+        /** Performs a*b = c on matrices stored in files, with a bounded amount of memory.
+         *  The product is blocked like MatMultTiled one level up, c is computed one block
+         *  at a time from panels of a and b copied out of the mappings, each block product
+         *  runs through Gemm. While one pair of panels is multiplied the next pair is read
+         *  in on another thread, so disk reads overlap the compute. Pages of the mappings
+         *  are dropped once their panel has been copied, keeping the resident set near
+         *  the working set however large the files are
+         *
+         * \param a the input matrix a
+         * \param b the input matrix b
+         * \param c the resulting matrix c, throws std::invalid_argument if it isn't mapped ReadWrite
+         * \param working_set_bytes the memory for the panels, both prefetch buffers and the block of c
+         */
+        void MatMultOutOfCore(const MatrixFile& a,
+                              const MatrixFile& b,
+                              MatrixFile& c,
+                              size_t working_set_bytes = default_out_of_core_working_set);
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
+
+#endif // #ifndef MATRIX_MULTIPLY_OUT_OF_CORE_H
@@ -0,0 +1,65 @@
+/*
+MatrixMultiplyPeakKernel.h a register only multiply-add loop for measuring the peak flop rate, compiled once per instruction set
+Evan Newman
+*/
+
+/* only included by the MatrixMultiplyKernels*.cpp files, see MatrixMultiplyGemmKernel.h
+ */
+
+#ifndef MATRIX_MULTIPLY_PEAK_KERNEL_H
+#define MATRIX_MULTIPLY_PEAK_KERNEL_H
+
+#ifndef MATRIX_MULTIPLY_ISA
+#error "define MATRIX_MULTIPLY_ISA before including MatrixMultiplyPeakKernel.h"
+#endif
+
+#include <cstdint>
+
+#include "MatrixMultiplyGemmKernel.h" // Vec
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+        namespace MATRIX_MULTIPLY_ISA {
+
+            namespace {
+
+                /* independent multiply-add chains, enough to cover the latency of the fma units
+                 * on every port (4 cycles x 2 ports on most cores) with room to spare
+                 */
+                constexpr int peak_chains = 12;
+
+                // flops in one iteration of PeakFmaKernel
+                constexpr int peak_flops = 2*peak_chains*Vec::width;
+
+                /** runs iterations rounds of peak_chains dependent multiply-adds that never touch
+                 *  memory. acc*x + y converges instead of overflowing, and the sum is returned so
+                 *  none of it can be optimized away
+                 */
+                float PeakFmaKernel(int64_t iterations) {
+                    Vec::Type acc[peak_chains];
+                    for (int chain = 0; chain < peak_chains; chain++) acc[chain] = Vec::Set(1.0f + chain*1e-3f);
+
+                    const Vec::Type x = Vec::Set(0.999999f);
+                    const Vec::Type y = Vec::Set(1e-6f);
+
+                    for (int64_t i = 0; i < iterations; i++) {
+                        for (int chain = 0; chain < peak_chains; chain++) acc[chain] = Vec::FmAdd(acc[chain], x, y);
+                    }
+
+                    for (int chain = 1; chain < peak_chains; chain++) acc[0] = Vec::Add(acc[0], acc[chain]);
+
+                    alignas(64) float lanes[Vec::width];
+                    Vec::StoreU(lanes, acc[0]);
+
+                    float total = 0.0f;
+                    for (int lane = 0; lane < Vec::width; lane++) total += lanes[lane];
+                    return total;
+                }
+
+            } // namespace
+
+        } // namespace MATRIX_MULTIPLY_ISA
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
+
+#endif // #ifndef MATRIX_MULTIPLY_PEAK_KERNEL_H
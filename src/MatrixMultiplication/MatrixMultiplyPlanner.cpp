@@ -0,0 +1,202 @@
+/*
+MatrixMultiplyPlanner.cpp
+Evan Newman
+*/
+
+#include "MatrixMultiplyPlanner.h"
+
+// System
+#include <stdexcept>
+#include <cstdint>
+#include <algorithm>
+
+// Libraries
+#include <eigen3/Eigen/Core>
+
+// Local
+#include "MatrixMultiplySimple.h"
+#include "MatrixMultiplyGemm.h"
+#include "MatrixMultiplyGemmContext.h"
+#include "MatrixMultiplyKernels.h"
+
+#include "Util/Arena.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        namespace {
+
+            // up to this k a rank-k update always beats packing
+            constexpr uint64_t rank_k_always = 4;
+
+            // up to this k it still does when c is tall, or too narrow to fill the gemm tile
+            constexpr uint64_t rank_k_max = 16;
+            constexpr uint64_t rank_k_tall_rows = 1024;
+            constexpr uint64_t rank_k_narrow_cols = 16;
+
+            // up to this many multiply-adds MatMultSimpleOptimized beats packing
+            constexpr uint64_t small_max_work = 8*8*8;
+
+            // each thread's plan cache has 2^plan_cache_bits slots, a stream of distinct shapes just keeps replacing entries
+            constexpr int plan_cache_bits = 6;
+            constexpr size_t plan_cache_slots = size_t(1) << plan_cache_bits;
+
+            MatMultPath Classify(uint64_t rows, uint64_t cols, uint64_t k) {
+                if (rows == 0 || cols == 0 || k == 0) return MatMultPath::Empty;
+                if (cols == 1) return MatMultPath::Gemv;
+                if (rows == 1) return MatMultPath::Gevm;
+                if (rows*cols*k <= small_max_work) return MatMultPath::Small;
+                if (k <= rank_k_always) return MatMultPath::RankK;
+                if (k <= rank_k_max && (rows >= rank_k_tall_rows || cols <= rank_k_narrow_cols)) return MatMultPath::RankK;
+                return MatMultPath::Packed;
+            }
+
+            /** the decisions of PlanMatMult, keyed by the shape and ops of the product. every thread
+             *  keeps its own direct mapped table, so a lookup is a hash and one compare with no lock,
+             *  and a shape that misses replaces whatever was in its slot
+             */
+            class PlanCache {
+            public:
+                static PlanCache& Instance() {
+                    thread_local PlanCache cache;
+                    return cache;
+                }
+
+                MatMultPath Plan(uint64_t rows, uint64_t cols, uint64_t k, Op op_a, Op op_b) {
+                    Entry& entry = _entries[Slot(rows, cols, k, op_a, op_b)];
+
+                    if (entry.valid && entry.rows == rows && entry.cols == cols && entry.k == k
+                        && entry.op_a == op_a && entry.op_b == op_b) {
+                        return entry.path;
+                    }
+
+                    entry = Entry{true, rows, cols, k, op_a, op_b, Classify(rows, cols, k)};
+                    return entry.path;
+                }
+
+            private:
+                struct Entry {
+                    bool valid;
+                    uint64_t rows;
+                    uint64_t cols;
+                    uint64_t k;
+                    Op op_a;
+                    Op op_b;
+                    MatMultPath path;
+                };
+
+                static size_t Slot(uint64_t rows, uint64_t cols, uint64_t k, Op op_a, Op op_b) {
+                    // multiplicative hashing, the top bits of the product mix every bit of the key
+                    uint64_t hash = rows;
+                    hash = (hash ^ cols)*0x9e3779b97f4a7c15ull;
+                    hash = (hash ^ k)*0x9e3779b97f4a7c15ull;
+                    hash = (hash ^ (static_cast<uint64_t>(op_a) << 1 | static_cast<uint64_t>(op_b)))*0x9e3779b97f4a7c15ull;
+                    return static_cast<size_t>(hash >> (64 - plan_cache_bits));
+                }
+
+                Entry _entries[plan_cache_slots] = {};
+            };
+
+            /** y = op(a)*x through the gemv kernel, y(i) is y[i*incy]. a strided y is
+             *  computed into a buffer and copied out
+             */
+            void RunGemv(const Operand& a_op, const float* x, int64_t incx, float* y, int64_t incy) {
+                const KernelTable& kernels = Kernels();
+
+                const bool pack_x = a_op.row_stride != 1 && incx != 1;
+                const size_t x_count = pack_x ? static_cast<size_t>(a_op.cols) : 0;
+                const size_t y_count = incy != 1 ? static_cast<size_t>(a_op.rows) : 0;
+
+                // the buffers come from the thread's gemm context so repeated products don't allocate
+                const size_t bytes = Util::Arena::Footprint<float>(x_count) + Util::Arena::Footprint<float>(y_count);
+                GemmContext::WithScratch(bytes, [&](Util::Arena& arena) {
+                    float* x_packed = arena.Allocate<float>(x_count);
+                    float* y_out = incy != 1 ? arena.Allocate<float>(y_count) : y;
+
+                    kernels.gemv(a_op.rows, a_op.cols, a_op.data, a_op.row_stride, a_op.col_stride,
+                                 x, incx, y_out, x_packed);
+
+                    if (incy != 1) {
+                        for (int64_t i = 0; i < a_op.rows; i++) y[i*incy] = y_out[i];
+                    }
+                });
+            }
+
+        } // namespace
+
+        const char* MatMultPathName(MatMultPath path) {
+            switch (path) {
+                case MatMultPath::Empty: return "empty";
+                case MatMultPath::Gemv: return "gemv";
+                case MatMultPath::Gevm: return "gevm";
+                case MatMultPath::RankK: return "rank-k";
+                case MatMultPath::Small: return "small";
+                case MatMultPath::Packed: return "packed";
+            }
+
+            return "unknown";
+        }
+
+        MatMultPath PlanMatMult(uint64_t rows, uint64_t cols, uint64_t k, Op op_a, Op op_b) {
+            return PlanCache::Instance().Plan(rows, cols, k, op_a, op_b);
+        }
+
+        void MatMult(const Eigen::Ref<const Eigen::MatrixXf> a,
+                     const Eigen::Ref<const Eigen::MatrixXf> b,
+                     Eigen::Ref<Eigen::MatrixXf> c,
+                     Op op_a,
+                     Op op_b) {
+
+            const Operand a_op(a, op_a);
+            const Operand b_op(b, op_b);
+
+            // Ensure the inputs are ok for matrix multiplication
+            if (a_op.rows != c.rows()
+               || a_op.cols != b_op.rows
+               || b_op.cols != c.cols()) {
+                   throw std::invalid_argument("matrices a, b, and c have incompatible sizes");
+            }
+
+            switch (PlanMatMult(c.rows(), c.cols(), a_op.cols, op_a, op_b)) {
+                case MatMultPath::Empty:
+                    c.setZero();
+                    return;
+
+                case MatMultPath::Gemv:
+                    // c = op(a)*(the column of op(b))
+                    RunGemv(a_op, b_op.data, b_op.row_stride, c.data(), 1);
+                    return;
+
+                case MatMultPath::Gevm: {
+                    // c^T = op(b)^T*(the row of op(a))^T
+                    const Operand b_t(b_op.data, b_op.cols, b_op.rows, b_op.col_stride, b_op.row_stride);
+                    RunGemv(b_t, a_op.data, a_op.col_stride, c.data(), c.outerStride());
+                    return;
+                }
+
+                case MatMultPath::RankK: {
+                    const KernelTable& kernels = Kernels();
+                    const int64_t a_packed_rows = std::min<int64_t>((a_op.rows + 15)/16*16, 2048);
+                    const size_t a_packed_count = static_cast<size_t>(a_packed_rows*a_op.cols);
+
+                    GemmContext::WithScratch(Util::Arena::Footprint<float>(a_packed_count), [&](Util::Arena& arena) {
+                        kernels.rank_k(c.rows(), c.cols(), a_op.cols,
+                                       a_op.data, a_op.row_stride, a_op.col_stride,
+                                       b_op.data, b_op.row_stride, b_op.col_stride,
+                                       c.data(), c.outerStride(), arena.Allocate<float>(a_packed_count));
+                    });
+                    return;
+                }
+
+                case MatMultPath::Small:
+                    MatMultSimpleOptimized(a, b, c, op_a, op_b);
+                    return;
+
+                case MatMultPath::Packed:
+                    Gemm(1.0f, a, op_a, b, op_b, 0.0f, c);
+                    return;
+            }
+        }
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
@@ -0,0 +1,65 @@
+/*
+MatrixMultiplyPlanner.h
+Evan Newman
+*/
+
+#ifndef MATRIX_MULTIPLY_PLANNER_H
+#define MATRIX_MULTIPLY_PLANNER_H
+
+#include <cstdint>
+
+#include <eigen3/Eigen/Core>
+
+#include "MatrixMultiplyOperand.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        /** the kernels MatMult picks between
+         */
+        enum class MatMultPath {
+            Empty,  // c has no elements, or k is 0 and c is zeroed
+            Gemv,   // c is a single column, a matrix vector product
+            Gevm,   // c is a single row, the matrix vector product of the transposes
+            RankK,  // k is small, c is a sum of k outer products written column by column
+            Small,  // every dimension is small, too little work to pay for packing
+            Packed  // everything else, the packed Gemm kernel
+        };
+
+        const char* MatMultPathName(MatMultPath path);
+
+        /** the path MatMult takes for an op(a)*op(b) product with c rows x cols and k columns
+         *  of op(a). the shape is classified the first time a thread sees it and the decision
+         *  is cached per thread, so repeated products of the same shape skip the classification
+         *
+         * \param rows the rows of c
+         * \param cols the columns of c
+         * \param k the columns of op(a) and rows of op(b)
+         * \param op_a whether a is used transposed
+         * \param op_b whether b is used transposed
+         */
+        MatMultPath PlanMatMult(uint64_t rows, uint64_t cols, uint64_t k, Op op_a = Op::None, Op op_b = Op::None);
+
+        /** Performs op(a)*op(b) = c with whichever kernel suits the shape, see PlanMatMult.
+         *  Matrix vector shapes (a single row or column of c) run through a dedicated gemv,
+         *  thin k through a rank-k update, tiny products through MatMultSimpleOptimized and
+         *  the rest through the packed Gemm. Empty and 1x1 shapes are fine, only sizes that
+         *  can't be multiplied throw
+         *
+         * \param a the input matrix a
+         * \param b the input matrix b
+         * \param op_a whether to use a or its transpose
+         * \param op_b whether to use b or its transpose
+         *
+         * \return the resulting matrix c
+         */
+        void MatMult(const Eigen::Ref<const Eigen::MatrixXf> a,
+                     const Eigen::Ref<const Eigen::MatrixXf> b,
+                     Eigen::Ref<Eigen::MatrixXf> c,
+                     Op op_a = Op::None,
+                     Op op_b = Op::None);
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
+
+#endif // #ifndef MATRIX_MULTIPLY_PLANNER_H
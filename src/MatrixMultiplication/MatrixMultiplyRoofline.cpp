@@ -0,0 +1,154 @@
+/*
+MatrixMultiplyRoofline.cpp
+Evan Newman
+*/
+
+#include "MatrixMultiplyRoofline.h"
+
+// System
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Local
+#include "MatrixMultiplyKernels.h"
+
+#include "Util/AlignedBuffer.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        namespace {
+
+            // the peak loop runs at least this long, so the clock and a slow start don't matter
+            constexpr double peak_seconds = 0.05;
+
+            // floats in each stream array, three 64MB arrays are far beyond any last level cache
+            constexpr size_t stream_count = size_t(16) << 20;
+
+            constexpr int passes = 3;
+
+            // runs body(thread) on threads threads at once and returns the seconds the slowest took
+            double RunThreads(unsigned threads, const std::function<void(unsigned)>& body) {
+                std::atomic<unsigned> ready(0);
+                std::vector<std::thread> workers;
+                std::chrono::steady_clock::time_point start;
+
+                for (unsigned t = 0; t < threads; t++) {
+                    workers.emplace_back([&, t]() {
+                        // every thread starts together so their runs overlap
+                        if (++ready == threads) start = std::chrono::steady_clock::now();
+                        while (ready.load() != threads) std::this_thread::yield();
+
+                        body(t);
+                    });
+                }
+                for (std::thread& worker : workers) worker.join();
+
+                std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+                return seconds.count();
+            }
+
+            double PeakGflops(unsigned threads) {
+                const KernelTable& kernels = Kernels();
+
+                // the iterations that take about peak_seconds on one thread
+                int64_t iterations = 1 << 16;
+                while (true) {
+                    auto start = std::chrono::steady_clock::now();
+                    volatile float sink = kernels.peak_fma(iterations);
+                    (void)sink;
+                    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+                    if (seconds.count() >= peak_seconds) break;
+                    iterations *= 2;
+                }
+
+                double best = 0.0;
+                for (int pass = 0; pass < passes; pass++) {
+                    double seconds = RunThreads(threads, [&](unsigned) {
+                        volatile float sink = kernels.peak_fma(iterations);
+                        (void)sink;
+                    });
+
+                    best = std::max(best, static_cast<double>(kernels.peak_flops)*iterations*threads/seconds*1e-9);
+                }
+
+                return best;
+            }
+
+            double TriadBandwidth(unsigned threads) {
+                Util::AlignedBuffer<float> a(stream_count);
+                Util::AlignedBuffer<float> b(stream_count);
+                Util::AlignedBuffer<float> c(stream_count);
+
+                auto Range = [&](unsigned t, size_t& first, size_t& last) {
+                    first = stream_count*t/threads;
+                    last = stream_count*(t + 1)/threads;
+                };
+
+                // each thread first touches the part it streams, which puts it on its numa node
+                RunThreads(threads, [&](unsigned t) {
+                    size_t first, last;
+                    Range(t, first, last);
+                    for (size_t i = first; i < last; i++) {
+                        a.Data()[i] = 0.0f;
+                        b.Data()[i] = 1.0f;
+                        c.Data()[i] = 2.0f;
+                    }
+                });
+
+                const float scalar = 3.0f;
+
+                double best = 0.0;
+                for (int pass = 0; pass < passes; pass++) {
+                    double seconds = RunThreads(threads, [&](unsigned t) {
+                        size_t first, last;
+                        Range(t, first, last);
+
+                        float* a_data = a.Data();
+                        const float* b_data = b.Data();
+                        const float* c_data = c.Data();
+                        for (size_t i = first; i < last; i++) a_data[i] = b_data[i] + scalar*c_data[i];
+                    });
+
+                    // stream counts two reads and a write per element
+                    best = std::max(best, 3.0*sizeof(float)*stream_count/seconds*1e-9);
+                }
+
+                return best;
+            }
+
+        } // namespace
+
+        double Roofline::Attainable(double intensity, bool parallel) const {
+            const double peak = parallel ? peak_gflops : peak_gflops_thread;
+            const double bandwidth = parallel ? bandwidth_gbs : bandwidth_gbs_thread;
+
+            return std::min(peak, intensity*bandwidth);
+        }
+
+        Roofline MeasureRoofline() {
+            Roofline roofline;
+
+            roofline.threads = std::max(1u, std::thread::hardware_concurrency());
+
+            roofline.peak_gflops_thread = PeakGflops(1);
+            roofline.peak_gflops = roofline.threads == 1 ? roofline.peak_gflops_thread : PeakGflops(roofline.threads);
+            roofline.bandwidth_gbs_thread = TriadBandwidth(1);
+            roofline.bandwidth_gbs = roofline.threads == 1 ? roofline.bandwidth_gbs_thread : TriadBandwidth(roofline.threads);
+
+            return roofline;
+        }
+
+        double ArithmeticIntensity(uint64_t m, uint64_t n, uint64_t k) {
+            const double bytes = sizeof(float)*(static_cast<double>(m)*k + static_cast<double>(k)*n + 2.0*m*n);
+            return bytes > 0.0 ? 2.0*m*n*k/bytes : 0.0;
+        }
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
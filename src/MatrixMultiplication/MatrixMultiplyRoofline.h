@@ -0,0 +1,50 @@
+/*
+MatrixMultiplyRoofline.h the peak flop rate and memory bandwidth of the machine, and where a product sits under them
+Evan Newman
+*/
+
+#ifndef MATRIX_MULTIPLY_ROOFLINE_H
+#define MATRIX_MULTIPLY_ROOFLINE_H
+
+#include <cstdint>
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        /** The two ceilings of the roofline model, for one thread and for every hardware thread.
+         *  A kernel doing intensity flops per byte of memory traffic can't go faster than
+         *  min(peak, intensity*bandwidth)
+         */
+        struct Roofline {
+            unsigned threads;           // the hardware threads the machine ceilings were measured with
+
+            double peak_gflops_thread;  // the multiply-add kernel of the kernels in use, one thread
+            double peak_gflops;         // the same on every thread at once
+            double bandwidth_gbs_thread; // stream triad, one thread
+            double bandwidth_gbs;        // stream triad on every thread
+
+            /** the fastest a kernel with the given intensity can run
+             *
+             * \param intensity flops per byte of memory traffic
+             * \param parallel whether to use the ceilings of the whole machine or of one thread
+             *
+             * \return the attainable rate in GFLOP/s
+             */
+            double Attainable(double intensity, bool parallel) const;
+        };
+
+        /** measures the ceilings, which takes about a second. the peak runs the peak_fma kernel
+         *  of Kernels() long enough to time reliably, the bandwidth is the best of a few passes
+         *  of a stream triad (a = b + s*c) over arrays far larger than the caches
+         */
+        Roofline MeasureRoofline();
+
+        /** the flops per byte of an m x n x k product that reads a and b and reads and writes c
+         *  exactly once, the least traffic any kernel can get away with
+         */
+        double ArithmeticIntensity(uint64_t m, uint64_t n, uint64_t k);
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
+
+#endif // #ifndef MATRIX_MULTIPLY_ROOFLINE_H
@@ -8,31 +8,41 @@ Evan Newman
 
 #include <eigen3/Eigen/Core>
 
+#include "MatrixMultiplyOperand.h"
+
 namespace OptimizationTests {
     namespace MatrixMultiply {
         
-        /** Performs a*b = c without any optimizations
+        /** Performs op(a)*op(b) = c without any optimizations
          * 
          * \param a the input matrix a
          * \param b the input matrix b
+         * \param op_a whether to use a or its transpose
+         * \param op_b whether to use b or its transpose
          * 
          * \return the resulting matrix c
          */
         void MatMultSimple(const Eigen::Ref<const Eigen::MatrixXf> a,
                            const Eigen::Ref<const Eigen::MatrixXf> b,
-                           Eigen::Ref<Eigen::MatrixXf> c);
+                           Eigen::Ref<Eigen::MatrixXf> c,
+                           Op op_a = Op::None,
+                           Op op_b = Op::None);
         
 
-        /** Performs a*b = c with linear c indexing and a cached sum
+        /** Performs op(a)*op(b) = c with linear c indexing and a cached sum
          * 
          * \param a the input matrix a
          * \param b the input matrix b
+         * \param op_a whether to use a or its transpose
+         * \param op_b whether to use b or its transpose
          * 
          * \return the resulting matrix c
          */
         void MatMultSimpleOptimized(const Eigen::Ref<const Eigen::MatrixXf> a,
                                     const Eigen::Ref<const Eigen::MatrixXf> b,
-                                    Eigen::Ref<Eigen::MatrixXf> c);
+                                    Eigen::Ref<Eigen::MatrixXf> c,
+                                    Op op_a = Op::None,
+                                    Op op_b = Op::None);
 
     } // namespace MatrixMultiply
 } // namespace OptimizationTests
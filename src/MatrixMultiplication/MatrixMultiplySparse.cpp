@@ -0,0 +1,170 @@
+/*
+MatrixMultiplySparse.cpp
+Evan Newman
+*/
+
+#include "MatrixMultiplySparse.h"
+
+// System
+#include <stdexcept>
+#include <cstdint>
+#include <limits>
+
+// Libraries
+#include <eigen3/Eigen/Core>
+
+// Local
+#include "MatrixMultiplyKernels.h"
+
+#include "Util/AlignedBuffer.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        namespace {
+
+            // the compressed indices are ints, like the kernels' sizes
+            void CheckNonZeros(size_t non_zeros) {
+                if (non_zeros > static_cast<size_t>(std::numeric_limits<int>::max())) {
+                    throw std::length_error("too many nonzeros for a sparse matrix");
+                }
+            }
+
+            double DensityOf(size_t non_zeros, int rows, int cols) {
+                if (rows == 0 || cols == 0) return 0.0;
+                return static_cast<double>(non_zeros)/(static_cast<double>(rows)*cols);
+            }
+
+            /** the size check and packing buffers shared by both formats, only the compressed
+             *  columns kernel needs a panel of c
+             */
+            template <typename Kernel>
+            void RunSparse(int a_rows, int a_cols, bool pack_c,
+                           const Operand& b_op, Eigen::Ref<Eigen::MatrixXf>& c,
+                           Kernel kernel) {
+
+                // Ensure the inputs are ok for matrix multiplication
+                if (a_rows != c.rows()
+                   || a_cols != b_op.rows
+                   || b_op.cols != c.cols()) {
+                       throw std::invalid_argument("matrices a, b, and c have incompatible sizes");
+                }
+
+                if (c.rows() == 0 || c.cols() == 0) return;
+
+                const KernelTable& kernels = Kernels();
+                const size_t panel = kernels.sparse_panel;
+
+                Util::AlignedBuffer<float> b_packed(static_cast<size_t>(a_cols)*panel);
+                Util::AlignedBuffer<float> c_packed(pack_c ? static_cast<size_t>(a_rows)*panel : 0);
+
+                kernel(kernels, b_packed.Data(), c_packed.Data());
+            }
+
+        } // namespace
+
+        CsrMatrix::CsrMatrix() : _rows(0), _cols(0), _row_ptr(1, 0) {}
+
+        CsrMatrix::CsrMatrix(const Eigen::Ref<const Eigen::MatrixXf> dense)
+            : _rows(dense.rows()), _cols(dense.cols()) {
+
+            _row_ptr.reserve(_rows + 1);
+            _row_ptr.push_back(0);
+
+            // walks the column major matrix across its rows, it is only done once per matrix
+            for (int row = 0; row < _rows; row++) {
+                for (int col = 0; col < _cols; col++) {
+                    float value = dense(row, col);
+                    if (value == 0.0f) continue;
+
+                    _col_idx.push_back(col);
+                    _values.push_back(value);
+                }
+
+                CheckNonZeros(_values.size());
+                _row_ptr.push_back(_values.size());
+            }
+        }
+
+        double CsrMatrix::Density() const {
+            return DensityOf(NonZeros(), _rows, _cols);
+        }
+
+        Eigen::MatrixXf CsrMatrix::ToDense() const {
+            Eigen::MatrixXf dense = Eigen::MatrixXf::Zero(_rows, _cols);
+
+            for (int row = 0; row < _rows; row++) {
+                for (int p = _row_ptr[row]; p < _row_ptr[row + 1]; p++) dense(row, _col_idx[p]) = _values[p];
+            }
+
+            return dense;
+        }
+
+        CscMatrix::CscMatrix() : _rows(0), _cols(0), _col_ptr(1, 0) {}
+
+        CscMatrix::CscMatrix(const Eigen::Ref<const Eigen::MatrixXf> dense)
+            : _rows(dense.rows()), _cols(dense.cols()) {
+
+            _col_ptr.reserve(_cols + 1);
+            _col_ptr.push_back(0);
+
+            for (int col = 0; col < _cols; col++) {
+                for (int row = 0; row < _rows; row++) {
+                    float value = dense(row, col);
+                    if (value == 0.0f) continue;
+
+                    _row_idx.push_back(row);
+                    _values.push_back(value);
+                }
+
+                CheckNonZeros(_values.size());
+                _col_ptr.push_back(_values.size());
+            }
+        }
+
+        double CscMatrix::Density() const {
+            return DensityOf(NonZeros(), _rows, _cols);
+        }
+
+        Eigen::MatrixXf CscMatrix::ToDense() const {
+            Eigen::MatrixXf dense = Eigen::MatrixXf::Zero(_rows, _cols);
+
+            for (int col = 0; col < _cols; col++) {
+                for (int p = _col_ptr[col]; p < _col_ptr[col + 1]; p++) dense(_row_idx[p], col) = _values[p];
+            }
+
+            return dense;
+        }
+
+        void MatMultSparse(const CsrMatrix& a,
+                           const Eigen::Ref<const Eigen::MatrixXf> b,
+                           Eigen::Ref<Eigen::MatrixXf> c,
+                           Op op_b) {
+
+            const Operand b_op(b, op_b);
+
+            RunSparse(a.Rows(), a.Cols(), false, b_op, c, [&](const KernelTable& kernels, float* b_packed, float* c_packed) {
+                kernels.sparse_csr(a.Rows(), a.Cols(), c.cols(),
+                                   a.RowPtr().data(), a.ColIdx().data(), a.Values().data(),
+                                   b_op.data, b_op.row_stride, b_op.col_stride, c.data(), c.outerStride(),
+                                   b_packed, c_packed);
+            });
+        }
+
+        void MatMultSparse(const CscMatrix& a,
+                           const Eigen::Ref<const Eigen::MatrixXf> b,
+                           Eigen::Ref<Eigen::MatrixXf> c,
+                           Op op_b) {
+
+            const Operand b_op(b, op_b);
+
+            RunSparse(a.Rows(), a.Cols(), true, b_op, c, [&](const KernelTable& kernels, float* b_packed, float* c_packed) {
+                kernels.sparse_csc(a.Rows(), a.Cols(), c.cols(),
+                                   a.ColPtr().data(), a.RowIdx().data(), a.Values().data(),
+                                   b_op.data, b_op.row_stride, b_op.col_stride, c.data(), c.outerStride(),
+                                   b_packed, c_packed);
+            });
+        }
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
@@ -0,0 +1,118 @@
+/*
+MatrixMultiplySparse.h
+Evan Newman
+*/
+
+#ifndef MATRIX_MULTIPLY_SPARSE_H
+#define MATRIX_MULTIPLY_SPARSE_H
+
+#include <cstddef>
+#include <vector>
+
+#include <eigen3/Eigen/Core>
+
+#include "MatrixMultiplyOperand.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        /** A sparse matrix in compressed sparse row form. the nonzeros of row r are
+         *  Values()[p] at column ColIdx()[p] for p from RowPtr()[r] to RowPtr()[r + 1]
+         */
+        class CsrMatrix {
+        public:
+            CsrMatrix();
+
+            /** compresses the nonzeros of a dense matrix, row by row
+             */
+            explicit CsrMatrix(const Eigen::Ref<const Eigen::MatrixXf> dense);
+
+            int Rows() const { return _rows; }
+            int Cols() const { return _cols; }
+            size_t NonZeros() const { return _values.size(); }
+
+            // the fraction of the elements that are nonzero
+            double Density() const;
+
+            const std::vector<int>& RowPtr() const { return _row_ptr; }
+            const std::vector<int>& ColIdx() const { return _col_idx; }
+            const std::vector<float>& Values() const { return _values; }
+
+            Eigen::MatrixXf ToDense() const;
+
+        private:
+            int _rows;
+            int _cols;
+
+            std::vector<int> _row_ptr;
+            std::vector<int> _col_idx;
+            std::vector<float> _values;
+        };
+
+        /** A sparse matrix in compressed sparse column form. the nonzeros of column c are
+         *  Values()[p] at row RowIdx()[p] for p from ColPtr()[c] to ColPtr()[c + 1]
+         */
+        class CscMatrix {
+        public:
+            CscMatrix();
+
+            /** compresses the nonzeros of a dense matrix, column by column
+             */
+            explicit CscMatrix(const Eigen::Ref<const Eigen::MatrixXf> dense);
+
+            int Rows() const { return _rows; }
+            int Cols() const { return _cols; }
+            size_t NonZeros() const { return _values.size(); }
+
+            // the fraction of the elements that are nonzero
+            double Density() const;
+
+            const std::vector<int>& ColPtr() const { return _col_ptr; }
+            const std::vector<int>& RowIdx() const { return _row_idx; }
+            const std::vector<float>& Values() const { return _values; }
+
+            Eigen::MatrixXf ToDense() const;
+
+        private:
+            int _rows;
+            int _cols;
+
+            std::vector<int> _col_ptr;
+            std::vector<int> _row_idx;
+            std::vector<float> _values;
+        };
+
+        /** Performs a*op(b) = c for a sparse a in compressed rows and a dense b. b and c are
+         *  processed in panels of a few columns, the panel of b is packed row major so
+         *  every nonzero of a is one vectorized multiply-add into a row of c held in registers.
+         *  The work is proportional to the nonzeros of a instead of its size
+         *
+         * \param a the sparse input matrix a
+         * \param b the input matrix b
+         * \param op_b whether to use b or its transpose
+         *
+         * \return the resulting matrix c
+         */
+        void MatMultSparse(const CsrMatrix& a,
+                           const Eigen::Ref<const Eigen::MatrixXf> b,
+                           Eigen::Ref<Eigen::MatrixXf> c,
+                           Op op_b = Op::None);
+
+        /** Performs a*op(b) = c for a sparse a in compressed columns and a dense b, like the
+         *  CsrMatrix version except every nonzero scatters into a packed panel of c
+         *
+         * \param a the sparse input matrix a
+         * \param b the input matrix b
+         * \param op_b whether to use b or its transpose
+         *
+         * \return the resulting matrix c
+         */
+        void MatMultSparse(const CscMatrix& a,
+                           const Eigen::Ref<const Eigen::MatrixXf> b,
+                           Eigen::Ref<Eigen::MatrixXf> c,
+                           Op op_b = Op::None);
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
+
+#endif // #ifndef MATRIX_MULTIPLY_SPARSE_H
@@ -0,0 +1,125 @@
+/*
+MatrixMultiplySparseKernel.h the sparse times dense kernels, compiled once per instruction set
+Evan Newman
+*/
+
+/* only included by the MatrixMultiplyKernels*.cpp files, see MatrixMultiplyGemmKernel.h
+ */
+
+#ifndef MATRIX_MULTIPLY_SPARSE_KERNEL_H
+#define MATRIX_MULTIPLY_SPARSE_KERNEL_H
+
+#ifndef MATRIX_MULTIPLY_ISA
+#error "define MATRIX_MULTIPLY_ISA before including MatrixMultiplySparseKernel.h"
+#endif
+
+#include <cstdint>
+
+#include "MatrixMultiplyKernels.h"
+#include "MatrixMultiplyGemmKernel.h" // Vec
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+        namespace MATRIX_MULTIPLY_ISA {
+
+            namespace {
+
+                /* both kernels work on a panel of sparse_panel columns of b and c at a time. the
+                 * panel of b is packed row major so every nonzero of a is a multiply-add of whole
+                 * vectors with one contiguous row of it
+                 */
+                constexpr int sparse_panel = 16;
+                constexpr int sparse_vectors = sparse_panel/Vec::width;
+
+                static_assert(sparse_panel % Vec::width == 0, "the sparse panel must hold whole vectors");
+
+                int SparseMin(int x, int y) { return x < y ? x : y; }
+
+                /** packs the k x cols block of b starting at column first into rows of
+                 *  sparse_panel floats, columns past cols are zero padded
+                 */
+                void PackSparsePanel(const float* b, int64_t b_rs, int64_t b_cs, int k, int first, int cols, float* b_packed) {
+                    for (int i = 0; i < k; i++) {
+                        float* b_row = b_packed + i*sparse_panel;
+                        const float* b_elem = b + i*b_rs + first*b_cs;
+
+                        int col = 0;
+                        for (; col < cols; col++) b_row[col] = b_elem[col*b_cs];
+                        for (; col < sparse_panel; col++) b_row[col] = 0.0f;
+                    }
+                }
+
+                /** c = a*b with a in compressed sparse rows. each row of c is the sum of the rows
+                 *  of the packed panel picked out by the nonzeros of the same row of a
+                 */
+                void SparseCsrKernel(int rows, int k, int n,
+                                     const int* row_ptr, const int* col_idx, const float* values,
+                                     const float* b, int64_t b_rs, int64_t b_cs, float* c, int64_t ldc,
+                                     float* b_packed, float* /* c_packed, unused */) {
+                    for (int first = 0; first < n; first += sparse_panel) {
+                        const int cols = SparseMin(sparse_panel, n - first);
+                        PackSparsePanel(b, b_rs, b_cs, k, first, cols, b_packed);
+
+                        float* c_panel = c + first*ldc;
+
+                        for (int row = 0; row < rows; row++) {
+                            // the row of c stays in registers over the whole row of a
+                            Vec::Type sum[sparse_vectors];
+                            for (int v = 0; v < sparse_vectors; v++) sum[v] = Vec::Zero();
+
+                            for (int p = row_ptr[row]; p < row_ptr[row + 1]; p++) {
+                                const Vec::Type a_elem = Vec::Set(values[p]);
+                                const float* b_row = b_packed + col_idx[p]*sparse_panel;
+
+                                for (int v = 0; v < sparse_vectors; v++) sum[v] = Vec::FmAdd(a_elem, Vec::Load(b_row + v*Vec::width), sum[v]);
+                            }
+
+                            alignas(64) float c_row[sparse_panel];
+                            for (int v = 0; v < sparse_vectors; v++) Vec::StoreU(c_row + v*Vec::width, sum[v]);
+
+                            for (int col = 0; col < cols; col++) c_panel[row + col*ldc] = c_row[col];
+                        }
+                    }
+                }
+
+                /** c = a*b with a in compressed sparse columns. every nonzero a(row, i) adds a(row, i)
+                 *  times row i of the packed panel to row row of a row major copy of the panel of c,
+                 *  which is copied out once the panel is done
+                 */
+                void SparseCscKernel(int rows, int k, int n,
+                                     const int* col_ptr, const int* row_idx, const float* values,
+                                     const float* b, int64_t b_rs, int64_t b_cs, float* c, int64_t ldc,
+                                     float* b_packed, float* c_packed) {
+                    for (int first = 0; first < n; first += sparse_panel) {
+                        const int cols = SparseMin(sparse_panel, n - first);
+                        PackSparsePanel(b, b_rs, b_cs, k, first, cols, b_packed);
+
+                        for (int elem = 0; elem < rows*sparse_panel; elem++) c_packed[elem] = 0.0f;
+
+                        for (int i = 0; i < k; i++) {
+                            const float* b_row = b_packed + i*sparse_panel;
+
+                            for (int p = col_ptr[i]; p < col_ptr[i + 1]; p++) {
+                                const Vec::Type a_elem = Vec::Set(values[p]);
+                                float* c_row = c_packed + row_idx[p]*sparse_panel;
+
+                                for (int v = 0; v < sparse_vectors; v++) {
+                                    Vec::StoreU(c_row + v*Vec::width, Vec::FmAdd(a_elem, Vec::Load(b_row + v*Vec::width), Vec::Load(c_row + v*Vec::width)));
+                                }
+                            }
+                        }
+
+                        float* c_panel = c + first*ldc;
+                        for (int col = 0; col < cols; col++) {
+                            for (int row = 0; row < rows; row++) c_panel[row + col*ldc] = c_packed[col + row*sparse_panel];
+                        }
+                    }
+                }
+
+            } // namespace
+
+        } // namespace MATRIX_MULTIPLY_ISA
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
+
+#endif // #ifndef MATRIX_MULTIPLY_SPARSE_KERNEL_H
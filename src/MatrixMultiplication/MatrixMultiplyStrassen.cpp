@@ -0,0 +1,311 @@
+/*
+MatrixMultiplyStrassen.cpp
+Evan Newman
+*/
+
+#include "MatrixMultiplyStrassen.h"
+
+// System
+#include <stdexcept>
+#include <cstdint>
+#include <algorithm>
+
+// Libraries
+#include <eigen3/Eigen/Core>
+
+// Local
+#include "MatrixMultiplyFastest.h"
+#include "MatrixMultiplyAutotune.h"
+#include "MatrixMultiplyGemmContext.h"
+#include "MatrixMultiplyKernels.h"
+
+#include "Util/Arena.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        namespace {
+
+            using ConstView = Eigen::Map<const Eigen::MatrixXf, 0, Eigen::OuterStride<>>;
+            using View = Eigen::Map<Eigen::MatrixXf, 0, Eigen::OuterStride<>>;
+
+            // every allocation from the arena starts on a cache line
+            constexpr size_t arena_granularity = Util::Arena::alignment/sizeof(float);
+
+            size_t RoundToGranularity(size_t count) {
+                return (count + arena_granularity - 1)/arena_granularity*arena_granularity;
+            }
+
+            /** a bump allocator over one preallocated buffer. the recursion takes its
+             *  temporaries on the way down and releases them on the way back up
+             */
+            class ScratchArena {
+            public:
+                ScratchArena(float* data, size_t size) : _data(data), _size(size), _used(0) {}
+
+                float* Allocate(size_t count) {
+                    count = RoundToGranularity(count);
+                    if (_used + count > _size) throw std::logic_error("Strassen scratch arena is too small");
+
+                    float* ptr = _data + _used;
+                    _used += count;
+                    return ptr;
+                }
+
+                size_t Mark() const { return _used; }
+                void Release(size_t mark) { _used = mark; }
+
+            private:
+                float* _data;
+                size_t _size;
+                size_t _used;
+            };
+
+            /** out = combine(x, y) elementwise over a block the size of x, out may alias x or y.
+             *  combine is the matrix_add or matrix_sub of the KernelTable in use
+             */
+            template <typename Combine>
+            void ElementWise(const Operand& x, const Operand& y, float* out, int64_t ldo, Combine combine) {
+                combine(x.rows, x.cols, x.data, x.row_stride, x.col_stride, y.data, y.row_stride, y.col_stride, out, ldo);
+            }
+
+            bool StopRecursion(uint64_t rows, uint64_t cols, uint64_t k, int crossover) {
+                uint64_t limit = static_cast<uint64_t>(crossover);
+                return rows <= limit || cols <= limit || k <= limit;
+            }
+
+            /** an operand as an eigen matrix and the op that turns it back into the operand.
+             *  the operands here are column major blocks or their transposes, so one of the
+             *  strides is always 1
+             */
+            struct OperandView {
+                ConstView matrix;
+                Op op;
+            };
+
+            OperandView ToView(const Operand& x) {
+                if (x.row_stride == 1) return {ConstView(x.data, x.rows, x.cols, Eigen::OuterStride<>(x.col_stride)), Op::None};
+                return {ConstView(x.data, x.cols, x.rows, Eigen::OuterStride<>(x.row_stride)), Op::Transpose};
+            }
+
+            /** c = a*b for op(a) and op(b) given as operands
+             */
+            void StrassenRecursive(const Operand& a, const Operand& b, float* c, int64_t ldc,
+                                   int crossover, ScratchArena& arena) {
+
+                const uint64_t rows = a.rows;
+                const uint64_t cols = b.cols;
+                const uint64_t k = a.cols;
+
+                /* base case, hand the block to the dense kernel */
+                if (StopRecursion(rows, cols, k, crossover)) {
+                    const OperandView a_view = ToView(a);
+                    const OperandView b_view = ToView(b);
+
+                    View c_view(c, rows, cols, Eigen::OuterStride<>(ldc));
+                    MatMultFastest(a_view.matrix, b_view.matrix, c_view, a_view.op, b_view.op);
+                    return;
+                }
+
+                /* Strassen-Winograd on the even part of each dimension, the odd row,
+                 * column and k slice left over are fixed up at the end
+                 */
+                const uint64_t rows_half = rows/2;
+                const uint64_t cols_half = cols/2;
+                const uint64_t k_half = k/2;
+
+                const Operand a_11 = a.Block(0, 0, rows_half, k_half);
+                const Operand a_21 = a.Block(rows_half, 0, rows_half, k_half);
+                const Operand a_12 = a.Block(0, k_half, rows_half, k_half);
+                const Operand a_22 = a.Block(rows_half, k_half, rows_half, k_half);
+
+                const Operand b_11 = b.Block(0, 0, k_half, cols_half);
+                const Operand b_21 = b.Block(k_half, 0, k_half, cols_half);
+                const Operand b_12 = b.Block(0, cols_half, k_half, cols_half);
+                const Operand b_22 = b.Block(k_half, cols_half, k_half, cols_half);
+
+                float* c_11 = c;
+                float* c_21 = c + rows_half;
+                float* c_12 = c + cols_half*ldc;
+                float* c_22 = c + rows_half + cols_half*ldc;
+
+                // temporaries for the sums of a (x), the sums of b (y) and the product a_11*b_11 (z)
+                size_t mark = arena.Mark();
+
+                float* x = arena.Allocate(rows_half*k_half);
+                float* y = arena.Allocate(k_half*cols_half);
+                float* z = arena.Allocate(rows_half*cols_half);
+
+                const int64_t ldx = rows_half;
+                const int64_t ldy = k_half;
+                const int64_t ldz = rows_half;
+
+                // the temporaries and quadrants of c read back as operands
+                const Operand x_op(x, rows_half, k_half, 1, ldx);
+                const Operand y_op(y, k_half, cols_half, 1, ldy);
+                const Operand z_op(z, rows_half, cols_half, 1, ldz);
+
+                auto C = [&](float* quadrant) { return Operand(quadrant, rows_half, cols_half, 1, ldc); };
+
+                auto Multiply = [&](const Operand& lhs, const Operand& rhs, float* out, int64_t ld_out) {
+                    StrassenRecursive(lhs, rhs, out, ld_out, crossover, arena);
+                };
+
+                auto SumA = [&](const Operand& lhs, const Operand& rhs, auto combine) {
+                    ElementWise(lhs, rhs, x, ldx, combine);
+                };
+
+                auto SumB = [&](const Operand& lhs, const Operand& rhs, auto combine) {
+                    ElementWise(lhs, rhs, y, ldy, combine);
+                };
+
+                auto SumC = [&](const Operand& lhs, const Operand& rhs, float* out, auto combine) {
+                    ElementWise(lhs, rhs, out, ldc, combine);
+                };
+
+                const auto add = Kernels().matrix_add;
+                const auto sub = Kernels().matrix_sub;
+
+                /* the Winograd form of Strassen, scheduled so the 7 products and 15 additions
+                 * only need x, y and z on top of the quadrants of c (Douglas et al. 1994)
+                 *
+                 * s1 = a_21 + a_22   t1 = b_12 - b_11   p1 = a_11*b_11   p5 = s1*t1
+                 * s2 = s1 - a_11     t2 = b_22 - t1     p2 = a_12*b_21   p6 = s2*t2
+                 * s3 = a_11 - a_21   t3 = b_22 - b_12   p3 = s4*b_22     p7 = s3*t3
+                 * s4 = a_12 - s2     t4 = t2 - b_21     p4 = a_22*t4
+                 *
+                 * c_11 = p1 + p2
+                 * c_12 = p1 + p6 + p5 + p3
+                 * c_21 = p1 + p6 + p7 - p4
+                 * c_22 = p1 + p6 + p7 + p5
+                 */
+                SumA(a_11, a_21, sub);                           // x = s3
+                SumB(b_22, b_12, sub);                           // y = t3
+                Multiply(x_op, y_op, c_21, ldc);                 // c_21 = p7
+
+                SumA(a_21, a_22, add);                           // x = s1
+                SumB(b_12, b_11, sub);                           // y = t1
+                Multiply(x_op, y_op, c_22, ldc);                 // c_22 = p5
+
+                SumA(x_op, a_11, sub);                           // x = s2
+                SumB(b_22, y_op, sub);                           // y = t2
+                Multiply(x_op, y_op, c_12, ldc);                 // c_12 = p6
+
+                SumA(a_12, x_op, sub);                           // x = s4
+                Multiply(x_op, b_22, c_11, ldc);                 // c_11 = p3
+
+                Multiply(a_11, b_11, z, ldz);                    // z = p1
+
+                SumC(z_op, C(c_12), c_12, add);                  // c_12 = p1 + p6
+                SumC(C(c_12), C(c_21), c_21, add);               // c_21 = p1 + p6 + p7
+                SumC(C(c_12), C(c_22), c_12, add);               // c_12 = p1 + p6 + p5
+                SumC(C(c_21), C(c_22), c_22, add);               // c_22 = p1 + p6 + p7 + p5, done
+                SumC(C(c_12), C(c_11), c_12, add);               // c_12 = p1 + p6 + p5 + p3, done
+
+                SumB(y_op, b_21, sub);                           // y = t4
+                Multiply(a_22, y_op, c_11, ldc);                 // c_11 = p4
+                SumC(C(c_21), C(c_11), c_21, sub);               // c_21 = p1 + p6 + p7 - p4, done
+
+                Multiply(a_12, b_21, c_11, ldc);                 // c_11 = p2
+                SumC(C(c_11), z_op, c_11, add);                  // c_11 = p2 + p1, done
+
+                arena.Release(mark);
+
+                /* dynamic peeling, fix up whatever the even split left out */
+                const uint64_t rows_even = 2*rows_half;
+                const uint64_t cols_even = 2*cols_half;
+
+                // odd k, add the rank-1 product of the last column of a and last row of b
+                if (k % 2 != 0) {
+                    for (uint64_t col = 0; col < cols_even; col++) {
+                        const float b_k = b(k - 1, col);
+                        float* c_col = c + col*ldc;
+
+                        for (uint64_t row = 0; row < rows_even; row++) c_col[row] += a(row, k - 1)*b_k;
+                    }
+                }
+
+                // odd cols, the last column of c is a matrix vector product
+                if (cols % 2 != 0) {
+                    float* c_col = c + (cols - 1)*ldc;
+
+                    for (uint64_t row = 0; row < rows_even; row++) c_col[row] = 0;
+
+                    for (uint64_t i = 0; i < k; i++) {
+                        const float b_i = b(i, cols - 1);
+                        for (uint64_t row = 0; row < rows_even; row++) c_col[row] += a(row, i)*b_i;
+                    }
+                }
+
+                // odd rows, the last row of c is a vector matrix product
+                if (rows % 2 != 0) {
+                    for (uint64_t col = 0; col < cols; col++) {
+                        float sum = 0;
+                        for (uint64_t i = 0; i < k; i++) sum += a(rows - 1, i)*b(i, col);
+
+                        c[(rows - 1) + col*ldc] = sum;
+                    }
+                }
+            }
+
+        } // namespace
+
+        size_t StrassenScratchSize(uint64_t rows, uint64_t cols, uint64_t k, int crossover) {
+            size_t size = 0;
+
+            // the sub-products of a level run one after another, so each level only adds its own x, y and z
+            while (!StopRecursion(rows, cols, k, crossover)) {
+                rows /= 2;
+                cols /= 2;
+                k /= 2;
+
+                size += RoundToGranularity(rows*k) + RoundToGranularity(k*cols) + RoundToGranularity(rows*cols);
+            }
+
+            return size;
+        }
+
+        void MatMultStrassen(const Eigen::Ref<const Eigen::MatrixXf> a,
+                             const Eigen::Ref<const Eigen::MatrixXf> b,
+                             Eigen::Ref<Eigen::MatrixXf> c,
+                             int crossover,
+                             Op op_a,
+                             Op op_b) {
+
+            const Operand a_op(a, op_a);
+            const Operand b_op(b, op_b);
+
+            // Ensure the inputs are ok for matrix multiplication
+            if (a_op.rows != c.rows()
+               || a_op.cols != b_op.rows
+               || b_op.cols != c.cols()) {
+                   throw std::invalid_argument("matrices a, b, and c have incompatible sizes");
+            }
+
+            if (crossover < 1) {
+                throw std::invalid_argument("the Strassen crossover must be at least 1");
+            }
+
+            // the whole recursion shares one block of the thread's gemm context, reused from call to call
+            const size_t scratch_size = StrassenScratchSize(a_op.rows, b_op.cols, a_op.cols, crossover);
+            GemmContext::WithScratch(Util::Arena::Footprint<float>(scratch_size), [&](Util::Arena& scratch) {
+                ScratchArena arena(scratch.Allocate<float>(scratch_size), scratch_size);
+                StrassenRecursive(a_op, b_op, c.data(), c.outerStride(), crossover, arena);
+            });
+        }
+
+        void MatMultStrassen(const Eigen::Ref<const Eigen::MatrixXf> a,
+                             const Eigen::Ref<const Eigen::MatrixXf> b,
+                             Eigen::Ref<Eigen::MatrixXf> c,
+                             Op op_a,
+                             Op op_b) {
+
+            const Operand a_op(a, op_a);
+            const Operand b_op(b, op_b);
+
+            int crossover = TuningCache::Instance().BlockSize(TunedKernel::Strassen, a_op.rows, b_op.cols, a_op.cols, default_strassen_crossover);
+            MatMultStrassen(a, b, c, crossover, op_a, op_b);
+        }
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
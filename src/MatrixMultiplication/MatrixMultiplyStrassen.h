@@ -0,0 +1,70 @@
+/*
+MatrixMultiplyStrassen.h
+Evan Newman
+*/
+
+#ifndef MATRIX_MULTIPLY_STRASSEN_H
+#define MATRIX_MULTIPLY_STRASSEN_H
+
+#include <cstdint>
+
+#include <eigen3/Eigen/Core>
+
+#include "MatrixMultiplyOperand.h"
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        /** the crossover used when none has been tuned, products whose smallest
+         *  dimension is at or below it go straight to the dense kernel
+         */
+        constexpr int default_strassen_crossover = 1024;
+
+        /** the number of floats of scratch MatMultStrassen needs for a rows x cols x k product
+         *
+         * \param crossover the dimension at or below which the recursion stops
+         */
+        size_t StrassenScratchSize(uint64_t rows, uint64_t cols, uint64_t k, int crossover);
+
+        /** Performs op(a)*op(b) = c with the Strassen-Winograd algorithm on the quadrant decomposition
+         *  of MatMultCacheOblivious, doing 7 sub-multiplications per level instead of 8.
+         *  Odd dimensions are peeled off and fixed up with rank-1 and vector products.
+         *  The recursion stops at the crossover and finishes with MatMultFastest. All
+         *  temporaries come from one scratch arena allocated before the recursion starts.
+         *  Strassen trades accuracy for speed, the error grows with every level
+         *
+         * \param a the input matrix a
+         * \param b the input matrix b
+         * \param crossover the dimension at or below which the dense kernel is used
+         * \param op_a whether to use a or its transpose
+         * \param op_b whether to use b or its transpose
+         *
+         * \return the resulting matrix c
+         */
+        void MatMultStrassen(const Eigen::Ref<const Eigen::MatrixXf> a,
+                             const Eigen::Ref<const Eigen::MatrixXf> b,
+                             Eigen::Ref<Eigen::MatrixXf> c,
+                             int crossover,
+                             Op op_a = Op::None,
+                             Op op_b = Op::None);
+
+        /** Performs MatMultStrassen with the tuned crossover for this cpu and shape,
+         *  or default_strassen_crossover if it has not been tuned
+         *
+         * \param a the input matrix a
+         * \param b the input matrix b
+         * \param op_a whether to use a or its transpose
+         * \param op_b whether to use b or its transpose
+         *
+         * \return the resulting matrix c
+         */
+        void MatMultStrassen(const Eigen::Ref<const Eigen::MatrixXf> a,
+                             const Eigen::Ref<const Eigen::MatrixXf> b,
+                             Eigen::Ref<Eigen::MatrixXf> c,
+                             Op op_a = Op::None,
+                             Op op_b = Op::None);
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
+
+#endif // #ifndef MATRIX_MULTIPLY_STRASSEN_H
@@ -3,111 +3,284 @@ MatrixMultiplyTiled.cpp
 Evan Newman
 */
 
+#include "MatrixMultiplyTiled.h"
+
+#include <stdexcept>
+#include <vector>
+#include <utility>
+
 #include <eigen3/Eigen/Core>
 
+#include "MatrixMultiplyAutotune.h"
+#include "MatrixMultiplyKernels.h"
+#include "Util/ThreadPool.h"
+#include "Util/Trace.h"
+
 namespace OptimizationTests {
     namespace MatrixMultiply {
 
-        void MatMultTiled(const Eigen::Ref<const Eigen::MatrixXf> a,
-                          const Eigen::Ref<const Eigen::MatrixXf> b,
-                          Eigen::Ref<Eigen::MatrixXf> c) {
+        namespace {
+
+            /** the tile kernel of the KernelTable in use for BlockSize
+             */
+            template <int BlockSize>
+            KernelTable::TileKernel TileKernelFor(const KernelTable::TileKernel* kernels) {
+                constexpr int index = BlockSizeIndex(TiledBlockSizes(), BlockSize);
+                static_assert(index >= 0, "BlockSize is not one of the TiledBlockSizes");
+                return kernels[index];
+            }
+
+            template <int BlockSize>
+            void MatMultTiledParallelBlocked(const Operand& a_op,
+                                             const Operand& b_op,
+                                             Eigen::Ref<Eigen::MatrixXf>& c,
+                                             Util::ThreadPool& pool) {
+
+                TRACE_ZONE("MatMultTiledParallel");
+
+                // grab the data pointer and leading dimension of c from eigen
+                float* c_raw = c.data();
+                const int64_t ldc = c.outerStride();
+
+                const KernelTable::TileKernel tile_kernel = TileKernelFor<BlockSize>(Kernels().tiled_optimized_tile);
+
+                /* list the tiles of c with every full tile ahead of the ragged edge tiles.
+                 * the edges are smaller so they fill in around the end of the run
+                 * instead of leaving a serial tail
+                 */
+                const int full_rows = c.rows()/BlockSize*BlockSize;
+                const int full_cols = c.cols()/BlockSize*BlockSize;
+
+                std::vector<std::pair<int, int>> tiles; // (c_row, c_col) of each tile
+                for (int c_col = 0; c_col < full_cols; c_col += BlockSize) {
+                    for (int c_row = 0; c_row < full_rows; c_row += BlockSize) {
+                        tiles.emplace_back(c_row, c_col);
+                    }
+                }
+
+                for (int c_col = 0; c_col < c.cols(); c_col += BlockSize) {
+                    for (int c_row = 0; c_row < c.rows(); c_row += BlockSize) {
+                        if (c_row >= full_rows || c_col >= full_cols) tiles.emplace_back(c_row, c_col);
+                    }
+                }
+
+                pool.ParallelFor(tiles.size(), [&](size_t tile) {
+                    const int c_row = tiles[tile].first;
+                    const int c_col = tiles[tile].second;
+
+                    int block_width = c_col + BlockSize >= c.cols() ? c.cols() - c_col : BlockSize;
+                    int block_height = c_row + BlockSize >= c.rows() ? c.rows() - c_row : BlockSize;
+
+                    TRACE_ZONE(block_width == BlockSize && block_height == BlockSize ? "tile" : "edge tile");
+
+                    // each task owns its tile of c, so it is zeroed here rather than in a serial pass
+                    {
+                        TRACE_ZONE("zero c");
 
-            const int block_size = 10;
+                        for (int c_col_block = 0; c_col_block < block_width; c_col_block++) {
+                            for (int c_row_block = 0; c_row_block < block_height; c_row_block++) {
+                                c_raw[c_row + c_row_block + (c_col + c_col_block)*ldc] = 0;
+                            }
+                        }
+                    }
+
+                    tile_kernel(a_op.data, a_op.row_stride, a_op.col_stride, b_op.data, b_op.row_stride, b_op.col_stride, a_op.cols,
+                                c_raw, ldc, c_row, c_col, block_width, block_height);
+                });
+            }
+
+        } // namespace
+
+        template <int BlockSize>
+        void MatMultTiledBlocked(const Eigen::Ref<const Eigen::MatrixXf> a,
+                                 const Eigen::Ref<const Eigen::MatrixXf> b,
+                                 Eigen::Ref<Eigen::MatrixXf> c,
+                                 Op op_a,
+                                 Op op_b) {
+
+            const Operand a_op(a, op_a);
+            const Operand b_op(b, op_b);
 
             // Ensure the inpus are ok for matrix multiplication
-            if (a.rows() != c.rows()
-               || a.cols() != b.rows()
-               || b.cols() != c.cols()) {
+            if (a_op.rows != c.rows()
+               || a_op.cols != b_op.rows
+               || b_op.cols != c.cols()) {
                    throw std::invalid_argument("matrices a, b, and c have incompatible sizes");
             }
 
-            // grab the data pointers from eigen
-            const float* a_raw = a.data();
-            const float* b_raw = b.data();
+            // grab the data pointer and leading dimension of c from eigen
             float* c_raw = c.data();
+            const int64_t ldc = c.outerStride();
+
+            // the multiply of each tile, built for every instruction set in MatrixMultiplyLoopKernel.h
+            const KernelTable::TileKernel tile_kernel = TileKernelFor<BlockSize>(Kernels().tiled_tile);
 
-            for (uint64_t i = 0; i < c.rows()*c.cols(); i++) c_raw[i] = 0;
+            TRACE_ZONE("MatMultTiled");
+
+            {
+                TRACE_ZONE("zero c");
+                c.setZero();
+            }
 
             /* use submatrix tiling */
-            for (int c_col = 0; c_col < c.cols(); c_col += block_size) { // for every column in c, incremented by block_size
-                // if a block_size width block goes past the end of the columns,
+            for (int c_col = 0; c_col < c.cols(); c_col += BlockSize) { // for every column in c, incremented by BlockSize
+                // if a BlockSize width block goes past the end of the columns,
                 // set the block width equal to the remaining number of columns to the end
                 // otherwise the block with is just the block size
-                int block_width = c_col + block_size >= c.cols() ? c.cols() - c_col : block_size;
-                
-                for (int c_row = 0; c_row < c.rows(); c_row += block_size) {
+                int block_width = c_col + BlockSize >= c.cols() ? c.cols() - c_col : BlockSize;
+
+                for (int c_row = 0; c_row < c.rows(); c_row += BlockSize) {
                     // same scheme as for the columns and block_width
-                    int block_height = c_row + block_size >= c.rows() ? c.rows() - c_row : block_size; 
-                    
-                    for (int i = 0; i < a.cols(); i += block_size) { // for every column of a / row of c
-                        // same scheme as for the columns and block_width
-                        int block_i_size = i + block_size >= a.cols() ? a.cols() - i : block_size;
-
-                        // multiply the a and b submatrices together and put the result in c
-                        for (int c_col_block = 0; c_col_block < block_width; c_col_block++) { // for every column of the block
-                            for (int c_row_block = 0; c_row_block < block_height; c_row_block++) { // for every row of the block
-                                float sum = 0;
-                                
-                                for (int i_block = 0; i_block < block_i_size; i_block++) { // for every inner block dimension yadda yadda
-                                    sum += a_raw[c_row + c_row_block + (i + i_block)*a.rows()]*b_raw[i + i_block + (c_col + c_col_block)*b.rows()];
-                                }
-
-                                c_raw[c_row + c_row_block + (c_col + c_col_block)*c.rows()] += sum;
-                            }
-                        }
-                    }
+                    int block_height = c_row + BlockSize >= c.rows() ? c.rows() - c_row : BlockSize;
+
+                    TRACE_ZONE(block_width == BlockSize && block_height == BlockSize ? "tile" : "edge tile");
+
+                    // multiply the a and b submatrices together over all of k and put the result in c
+                    tile_kernel(a_op.data, a_op.row_stride, a_op.col_stride, b_op.data, b_op.row_stride, b_op.col_stride, a_op.cols,
+                                c_raw, ldc, c_row, c_col, block_width, block_height);
                 }
             }
         }
 
+        template <int BlockSize>
+        void MatMultTiledOptimizedBlocked(const Eigen::Ref<const Eigen::MatrixXf> a,
+                                          const Eigen::Ref<const Eigen::MatrixXf> b,
+                                          Eigen::Ref<Eigen::MatrixXf> c,
+                                          Op op_a,
+                                          Op op_b) {
 
-        void MatMultTiledOptimized(const Eigen::Ref<const Eigen::MatrixXf> a,
-                                   const Eigen::Ref<const Eigen::MatrixXf> b,
-                                   Eigen::Ref<Eigen::MatrixXf> c) {
-
-            const int block_size = 50; // my machine performed best with this 
+            const Operand a_op(a, op_a);
+            const Operand b_op(b, op_b);
 
             // Ensure the inpus are ok for matrix multiplication
-            if (a.rows() != c.rows()
-               || a.cols() != b.rows()
-               || b.cols() != c.cols()) {
+            if (a_op.rows != c.rows()
+               || a_op.cols != b_op.rows
+               || b_op.cols != c.cols()) {
                    throw std::invalid_argument("matrices a, b, and c have incompatible sizes");
             }
 
-            // grab the data pointers from eigen
-            const float* a_raw = a.data();
-            const float* b_raw = b.data();
+            // grab the data pointer and leading dimension of c from eigen
             float* c_raw = c.data();
+            const int64_t ldc = c.outerStride();
 
-            for (uint64_t i = 0; i < c.rows()*c.cols(); i++) c_raw[i] = 0;
+            const KernelTable::TileKernel tile_kernel = TileKernelFor<BlockSize>(Kernels().tiled_optimized_tile);
+
+            TRACE_ZONE("MatMultTiledOptimized");
+
+            {
+                TRACE_ZONE("zero c");
+                c.setZero();
+            }
 
             /* use submatrix tiling with better indexing */
-            for (int c_col = 0; c_col < c.cols(); c_col += block_size) {
-                int block_width = c_col + block_size >= c.cols() ? c.cols() - c_col : block_size;
-                
-                for (int c_row = 0; c_row < c.rows(); c_row += block_size) {
-                    int block_height = c_row + block_size >= c.rows() ? c.rows() - c_row : block_size; 
-
-                    for (int i = 0; i < a.cols(); i += block_size) {
-                        int block_i_size = i + block_size >= a.cols() ? a.cols() - i : block_size;
- 
-                        for (int c_col_block = 0; c_col_block < block_width; c_col_block++) {
-                            for (int c_row_block = 0; c_row_block < block_height; c_row_block++) {
-                                float sum = 0;
-                                
-                                const float* a_raw_current = a_raw + c_row + c_row_block + i*a.rows();
-                                const float* b_raw_current = b_raw + i + (c_col + c_col_block)*b.rows();
-                                for (int i_block = 0; i_block < block_i_size; i_block++, a_raw_current += a.rows(), b_raw_current++) {
-                                    sum += (*a_raw_current)*(*b_raw_current);
-                                }
-
-                                c_raw[c_row + c_row_block + (c_col + c_col_block)*c.rows()] += sum;
-                            }
-                        }
-                    }
+            for (int c_col = 0; c_col < c.cols(); c_col += BlockSize) {
+                int block_width = c_col + BlockSize >= c.cols() ? c.cols() - c_col : BlockSize;
+
+                for (int c_row = 0; c_row < c.rows(); c_row += BlockSize) {
+                    int block_height = c_row + BlockSize >= c.rows() ? c.rows() - c_row : BlockSize;
+
+                    TRACE_ZONE(block_width == BlockSize && block_height == BlockSize ? "tile" : "edge tile");
+                    tile_kernel(a_op.data, a_op.row_stride, a_op.col_stride, b_op.data, b_op.row_stride, b_op.col_stride, a_op.cols,
+                                c_raw, ldc, c_row, c_col, block_width, block_height);
                 }
             }
         }
 
+        // one instantiation per candidate in TiledBlockSizes so the autotuner can time each of them
+        template void MatMultTiledBlocked<10>(const Eigen::Ref<const Eigen::MatrixXf>, const Eigen::Ref<const Eigen::MatrixXf>, Eigen::Ref<Eigen::MatrixXf>, Op, Op);
+        template void MatMultTiledBlocked<16>(const Eigen::Ref<const Eigen::MatrixXf>, const Eigen::Ref<const Eigen::MatrixXf>, Eigen::Ref<Eigen::MatrixXf>, Op, Op);
+        template void MatMultTiledBlocked<32>(const Eigen::Ref<const Eigen::MatrixXf>, const Eigen::Ref<const Eigen::MatrixXf>, Eigen::Ref<Eigen::MatrixXf>, Op, Op);
+        template void MatMultTiledBlocked<50>(const Eigen::Ref<const Eigen::MatrixXf>, const Eigen::Ref<const Eigen::MatrixXf>, Eigen::Ref<Eigen::MatrixXf>, Op, Op);
+        template void MatMultTiledBlocked<64>(const Eigen::Ref<const Eigen::MatrixXf>, const Eigen::Ref<const Eigen::MatrixXf>, Eigen::Ref<Eigen::MatrixXf>, Op, Op);
+        template void MatMultTiledBlocked<100>(const Eigen::Ref<const Eigen::MatrixXf>, const Eigen::Ref<const Eigen::MatrixXf>, Eigen::Ref<Eigen::MatrixXf>, Op, Op);
+        template void MatMultTiledBlocked<128>(const Eigen::Ref<const Eigen::MatrixXf>, const Eigen::Ref<const Eigen::MatrixXf>, Eigen::Ref<Eigen::MatrixXf>, Op, Op);
+
+        template void MatMultTiledOptimizedBlocked<10>(const Eigen::Ref<const Eigen::MatrixXf>, const Eigen::Ref<const Eigen::MatrixXf>, Eigen::Ref<Eigen::MatrixXf>, Op, Op);
+        template void MatMultTiledOptimizedBlocked<16>(const Eigen::Ref<const Eigen::MatrixXf>, const Eigen::Ref<const Eigen::MatrixXf>, Eigen::Ref<Eigen::MatrixXf>, Op, Op);
+        template void MatMultTiledOptimizedBlocked<32>(const Eigen::Ref<const Eigen::MatrixXf>, const Eigen::Ref<const Eigen::MatrixXf>, Eigen::Ref<Eigen::MatrixXf>, Op, Op);
+        template void MatMultTiledOptimizedBlocked<50>(const Eigen::Ref<const Eigen::MatrixXf>, const Eigen::Ref<const Eigen::MatrixXf>, Eigen::Ref<Eigen::MatrixXf>, Op, Op);
+        template void MatMultTiledOptimizedBlocked<64>(const Eigen::Ref<const Eigen::MatrixXf>, const Eigen::Ref<const Eigen::MatrixXf>, Eigen::Ref<Eigen::MatrixXf>, Op, Op);
+        template void MatMultTiledOptimizedBlocked<100>(const Eigen::Ref<const Eigen::MatrixXf>, const Eigen::Ref<const Eigen::MatrixXf>, Eigen::Ref<Eigen::MatrixXf>, Op, Op);
+        template void MatMultTiledOptimizedBlocked<128>(const Eigen::Ref<const Eigen::MatrixXf>, const Eigen::Ref<const Eigen::MatrixXf>, Eigen::Ref<Eigen::MatrixXf>, Op, Op);
+
+        void MatMultTiled(const Eigen::Ref<const Eigen::MatrixXf> a,
+                          const Eigen::Ref<const Eigen::MatrixXf> b,
+                          Eigen::Ref<Eigen::MatrixXf> c,
+                          Op op_a,
+                          Op op_b) {
+
+            const int default_block_size = 10;
+
+            // tuned on the shape of the product, whichever way round the operands are stored
+            const Operand a_op(a, op_a);
+            const Operand b_op(b, op_b);
+
+            int block_size = TuningCache::Instance().BlockSize(TunedKernel::Tiled, a_op.rows, b_op.cols, a_op.cols, default_block_size);
+
+            bool dispatched = DispatchBlockSize(TiledBlockSizes(), block_size, [&](auto size) {
+                MatMultTiledBlocked<decltype(size)::value>(a, b, c, op_a, op_b);
+            });
+
+            if (!dispatched) MatMultTiledBlocked<default_block_size>(a, b, c, op_a, op_b);
+        }
+
+        void MatMultTiledOptimized(const Eigen::Ref<const Eigen::MatrixXf> a,
+                                   const Eigen::Ref<const Eigen::MatrixXf> b,
+                                   Eigen::Ref<Eigen::MatrixXf> c,
+                                   Op op_a,
+                                   Op op_b) {
+
+            const int default_block_size = 50; // my machine performed best with this, the autotuner overrides it per cpu
+
+            // tuned on the shape of the product, whichever way round the operands are stored
+            const Operand a_op(a, op_a);
+            const Operand b_op(b, op_b);
+
+            int block_size = TuningCache::Instance().BlockSize(TunedKernel::TiledOptimized, a_op.rows, b_op.cols, a_op.cols, default_block_size);
+
+            bool dispatched = DispatchBlockSize(TiledBlockSizes(), block_size, [&](auto size) {
+                MatMultTiledOptimizedBlocked<decltype(size)::value>(a, b, c, op_a, op_b);
+            });
+
+            if (!dispatched) MatMultTiledOptimizedBlocked<default_block_size>(a, b, c, op_a, op_b);
+        }
+
+        void MatMultTiledParallel(const Eigen::Ref<const Eigen::MatrixXf> a,
+                                  const Eigen::Ref<const Eigen::MatrixXf> b,
+                                  Eigen::Ref<Eigen::MatrixXf> c,
+                                  Util::ThreadPool& pool,
+                                  Op op_a,
+                                  Op op_b) {
+
+            const int default_block_size = 50;
+
+            const Operand a_op(a, op_a);
+            const Operand b_op(b, op_b);
+
+            // Ensure the inpus are ok for matrix multiplication
+            if (a_op.rows != c.rows()
+               || a_op.cols != b_op.rows
+               || b_op.cols != c.cols()) {
+                   throw std::invalid_argument("matrices a, b, and c have incompatible sizes");
+            }
+
+            // same tiling as MatMultTiledOptimized, so it shares the tuned block size
+            int block_size = TuningCache::Instance().BlockSize(TunedKernel::TiledOptimized, a_op.rows, b_op.cols, a_op.cols, default_block_size);
+
+            bool dispatched = DispatchBlockSize(TiledBlockSizes(), block_size, [&](auto size) {
+                MatMultTiledParallelBlocked<decltype(size)::value>(a_op, b_op, c, pool);
+            });
+
+            if (!dispatched) MatMultTiledParallelBlocked<default_block_size>(a_op, b_op, c, pool);
+        }
+
+        void MatMultTiledParallel(const Eigen::Ref<const Eigen::MatrixXf> a,
+                                  const Eigen::Ref<const Eigen::MatrixXf> b,
+                                  Eigen::Ref<Eigen::MatrixXf> c,
+                                  Op op_a,
+                                  Op op_b) {
+            MatMultTiledParallel(a, b, c, Util::ThreadPool::Default(), op_a, op_b);
+        }
+
     } // namespace MatrixMultiply
-} // namespace OptimizationTests
\ No newline at end of file
+} // namespace OptimizationTests
@@ -8,32 +8,114 @@ Evan Newman
 
 #include <eigen3/Eigen/Core>
 
+#include "MatrixMultiplyOperand.h"
+#include "Util/ThreadPool.h"
+
 namespace OptimizationTests {
     namespace MatrixMultiply {
 
-        /** Performs a*b = c with submatrix tiling
+        /** Performs op(a)*op(b) = c with submatrix tiling of a fixed block size.
+         *  Instantiated for every size in TiledBlockSizes
+         * 
+         * \tparam BlockSize the edge length of the square tiles
+         * \param a the input matrix a
+         * \param b the input matrix b
+         * \param op_a whether to use a or its transpose
+         * \param op_b whether to use b or its transpose
+         * 
+         * \return the resulting matrix c
+         */
+        template <int BlockSize>
+        void MatMultTiledBlocked(const Eigen::Ref<const Eigen::MatrixXf> a,
+                                 const Eigen::Ref<const Eigen::MatrixXf> b,
+                                 Eigen::Ref<Eigen::MatrixXf> c,
+                                 Op op_a = Op::None,
+                                 Op op_b = Op::None);
+
+        /** Performs MatMultTiledOptimized with a fixed block size.
+         *  Instantiated for every size in TiledBlockSizes
+         * 
+         * \tparam BlockSize the edge length of the square tiles
+         * \param a the input matrix a
+         * \param b the input matrix b
+         * \param op_a whether to use a or its transpose
+         * \param op_b whether to use b or its transpose
+         * 
+         * \return the resulting matrix c
+         */
+        template <int BlockSize>
+        void MatMultTiledOptimizedBlocked(const Eigen::Ref<const Eigen::MatrixXf> a,
+                                          const Eigen::Ref<const Eigen::MatrixXf> b,
+                                          Eigen::Ref<Eigen::MatrixXf> c,
+                                          Op op_a = Op::None,
+                                          Op op_b = Op::None);
+
+        /** Performs op(a)*op(b) = c with submatrix tiling, using the tuned block size
+         *  for this cpu and shape or 10 if it has not been tuned
          * 
          * \param a the input matrix a
          * \param b the input matrix b
+         * \param op_a whether to use a or its transpose
+         * \param op_b whether to use b or its transpose
          * 
          * \return the resulting matrix c
          */
         void MatMultTiled(const Eigen::Ref<const Eigen::MatrixXf> a,
                       const Eigen::Ref<const Eigen::MatrixXf> b,
-                      Eigen::Ref<Eigen::MatrixXf> c);
+                      Eigen::Ref<Eigen::MatrixXf> c,
+                      Op op_a = Op::None,
+                      Op op_b = Op::None);
 
-        /** Performs a*b = c with submatrix tiling and better 
-         *  indexing in the inner loop. A manual search
-         *  was performed to optimize the block size
+        /** Performs op(a)*op(b) = c with submatrix tiling and better 
+         *  indexing in the inner loop. The block size comes from
+         *  the autotuner, falling back on 50 from a manual search
          * 
          * \param a the input matrix a
          * \param b the input matrix b
+         * \param op_a whether to use a or its transpose
+         * \param op_b whether to use b or its transpose
          * 
          * \return the resulting matrix c
          */
         void MatMultTiledOptimized(const Eigen::Ref<const Eigen::MatrixXf> a,
                                    const Eigen::Ref<const Eigen::MatrixXf> b,
-                                   Eigen::Ref<Eigen::MatrixXf> c);
+                                   Eigen::Ref<Eigen::MatrixXf> c,
+                                   Op op_a = Op::None,
+                                   Op op_b = Op::None);
+
+        /** Performs op(a)*op(b) = c with the tiling of MatMultTiledOptimized, where every tile
+         *  of c is an independent task on a work-stealing thread pool. Full tiles are
+         *  scheduled before the smaller ragged edge tiles
+         * 
+         * \param a the input matrix a
+         * \param b the input matrix b
+         * \param pool the thread pool to run the tiles on
+         * \param op_a whether to use a or its transpose
+         * \param op_b whether to use b or its transpose
+         * 
+         * \return the resulting matrix c
+         */
+        void MatMultTiledParallel(const Eigen::Ref<const Eigen::MatrixXf> a,
+                                  const Eigen::Ref<const Eigen::MatrixXf> b,
+                                  Eigen::Ref<Eigen::MatrixXf> c,
+                                  Util::ThreadPool& pool,
+                                  Op op_a = Op::None,
+                                  Op op_b = Op::None);
+
+        /** Performs MatMultTiledParallel on the default thread pool
+         * 
+         * \param a the input matrix a
+         * \param b the input matrix b
+         * \param op_a whether to use a or its transpose
+         * \param op_b whether to use b or its transpose
+         * 
+         * \return the resulting matrix c
+         */
+        void MatMultTiledParallel(const Eigen::Ref<const Eigen::MatrixXf> a,
+                                  const Eigen::Ref<const Eigen::MatrixXf> b,
+                                  Eigen::Ref<Eigen::MatrixXf> c,
+                                  Op op_a = Op::None,
+                                  Op op_b = Op::None);
 
     } // namespace MatrixMultiply
 } // namespace OptimizationTests
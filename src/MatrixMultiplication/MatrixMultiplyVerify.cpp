@@ -0,0 +1,119 @@
+/*
+MatrixMultiplyVerify.cpp
+Evan Newman
+*/
+
+#include "MatrixMultiplyVerify.h"
+
+// System
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+
+// Libraries
+#include <eigen3/Eigen/Core>
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        namespace {
+
+            // the unit roundoff of float
+            constexpr double float_roundoff = 1.0/(1 << 24);
+
+            /** y = m*x in double for a thin x, a column of m at a time so m is read once for
+             *  every vector and never copied
+             */
+            void MultiplyThin(const Eigen::Ref<const Eigen::MatrixXf> m, const Eigen::MatrixXd& x, Eigen::MatrixXd& y) {
+                y.setZero(m.rows(), x.cols());
+                for (Eigen::Index col = 0; col < m.cols(); col++) y.noalias() += m.col(col).cast<double>()*x.row(col);
+            }
+
+        } // namespace
+
+        const char* VerifyModeName(VerifyMode mode) {
+            switch (mode) {
+                case VerifyMode::Freivalds: return "freivalds";
+                case VerifyMode::Reference: return "reference";
+            }
+
+            return "unknown";
+        }
+
+        bool ParseVerifyMode(const std::string& text, VerifyMode& mode) {
+            if (text == "freivalds") mode = VerifyMode::Freivalds;
+            else if (text == "reference") mode = VerifyMode::Reference;
+            else return false;
+
+            return true;
+        }
+
+        Verification VerifyFreivalds(const Eigen::Ref<const Eigen::MatrixXf> a,
+                                     const Eigen::Ref<const Eigen::MatrixXf> b,
+                                     const Eigen::Ref<const Eigen::MatrixXf> c,
+                                     int vectors,
+                                     double tolerance) {
+            Verification verification;
+            if (c.size() == 0) return verification;
+
+            // an empty k makes a*b zero
+            if (a.cols() == 0) {
+                verification.ok = c.isZero(0.0f);
+                verification.relative_error = verification.ok ? 0.0 : 1.0;
+                return verification;
+            }
+
+            // the allowed error of every row of c*r, see the header
+            Eigen::VectorXd row_bound = Eigen::VectorXd::Zero(a.rows());
+            for (Eigen::Index col = 0; col < a.cols(); col++) row_bound += a.col(col).cast<double>().cwiseAbs2();
+
+            const double b_norm = b.cast<double>().norm();
+            row_bound = tolerance*float_roundoff*std::sqrt(static_cast<double>(a.cols()))*b_norm*row_bound.cwiseSqrt();
+
+            std::mt19937_64 generator(0xf4e1);
+            std::bernoulli_distribution coin;
+
+            // every vector at once, so each matrix is streamed through once
+            Eigen::MatrixXd r(c.cols(), vectors);
+            for (Eigen::Index i = 0; i < r.size(); i++) r.data()[i] = coin(generator) ? 1.0 : -1.0;
+
+            Eigen::MatrixXd br, abr, cr;
+            MultiplyThin(b, r, br);
+            MultiplyThin(a, br, abr);
+            MultiplyThin(c, r, cr);
+
+            const Eigen::MatrixXd error = cr - abr;
+
+            // nan in c fails every comparison, so it is caught as well
+            for (Eigen::Index v = 0; v < vectors; v++) {
+                for (Eigen::Index row = 0; row < error.rows(); row++) {
+                    if (!(std::abs(error(row, v)) <= row_bound(row))) verification.ok = false;
+                }
+            }
+
+            // for r of +-1 the expected squared norm of e*r is the squared frobenius norm of e
+            const double error_squares = error.squaredNorm();
+            const double product_squares = abr.squaredNorm();
+
+            verification.relative_error = product_squares > 0.0 ? std::sqrt(error_squares/product_squares)
+                                                                 : std::sqrt(error_squares/vectors);
+            return verification;
+        }
+
+        Verification VerifyReference(const Eigen::Ref<const Eigen::MatrixXf> c,
+                                     const Eigen::Ref<const Eigen::MatrixXf> c_reference) {
+            Verification verification;
+            if (c_reference.size() == 0) return verification;
+
+            const double norm = c_reference.norm();
+            const double error = (c - c_reference).norm();
+
+            verification.relative_error = norm > 0.0 ? error/norm : error;
+            verification.ok = c.isApprox(c_reference, 1e-4f);
+
+            return verification;
+        }
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
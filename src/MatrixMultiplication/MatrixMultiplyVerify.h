@@ -0,0 +1,61 @@
+/*
+MatrixMultiplyVerify.h checking the result of a matrix multiply
+Evan Newman
+*/
+
+#ifndef MATRIX_MULTIPLY_VERIFY_H
+#define MATRIX_MULTIPLY_VERIFY_H
+
+#include <string>
+
+#include <eigen3/Eigen/Core>
+
+namespace OptimizationTests {
+    namespace MatrixMultiply {
+
+        enum class VerifyMode {
+            Freivalds, // O(n^2), c*r against a*(b*r) for a few random vectors r
+            Reference  // O(n^3), c against a full product by eigen
+        };
+
+        const char* VerifyModeName(VerifyMode mode);
+
+        /** parses freivalds or reference
+         *
+         * \return false if text is neither
+         */
+        bool ParseVerifyMode(const std::string& text, VerifyMode& mode);
+
+        /** whether c = a*b, and how far off it is
+         */
+        struct Verification {
+            bool ok = true;
+            double relative_error = 0.0; // ||c - a*b||/||a*b|| in the frobenius norm, estimated by Freivalds
+        };
+
+        /** checks c = a*b with Freivalds' algorithm, in O(mk + kn + mn) instead of the O(mnk)
+         *  of computing a*b. for each of vectors random vectors r of +-1, c*r and a*(b*r) are
+         *  computed in double and every row has to agree to within the rounding a float product
+         *  can pick up: tolerance*2^-24*sqrt(k)*||row of a||*||b||, the typical error of k float
+         *  multiply-adds bounded through Cauchy-Schwarz. a wrong element is missed by each
+         *  vector with probability at most 1/2, so 8 vectors miss it with at most 1/256. the
+         *  vectors come from a fixed seed, the same inputs always give the same answer
+         *
+         * \param tolerance the multiple of the typical rounding error allowed, the default leaves
+         *                  room for the extra error of Strassen
+         */
+        Verification VerifyFreivalds(const Eigen::Ref<const Eigen::MatrixXf> a,
+                                     const Eigen::Ref<const Eigen::MatrixXf> b,
+                                     const Eigen::Ref<const Eigen::MatrixXf> c,
+                                     int vectors = 8,
+                                     double tolerance = 16.0);
+
+        /** checks c against a product computed some other way, like eigen's a*b
+         */
+        Verification VerifyReference(const Eigen::Ref<const Eigen::MatrixXf> c,
+                                     const Eigen::Ref<const Eigen::MatrixXf> c_reference);
+
+    } // namespace MatrixMultiply
+} // namespace OptimizationTests
+
+#endif // #ifndef MATRIX_MULTIPLY_VERIFY_H
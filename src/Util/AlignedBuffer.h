@@ -0,0 +1,75 @@
+/*
+AlignedBuffer.h a cache line aligned heap buffer
+Evan Newman
+*/
+
+#ifndef ALIGNED_BUFFER_H
+#define ALIGNED_BUFFER_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+namespace OptimizationTests {
+    namespace Util {
+
+        /** An uninitialized buffer of trivial elements aligned to a cache line,
+         *  used for packing buffers and scratch space in the kernels
+         */
+        template <typename T>
+        class AlignedBuffer {
+        public:
+            static constexpr size_t alignment = 64;
+
+            AlignedBuffer() : _data(nullptr), _size(0) {}
+
+            explicit AlignedBuffer(size_t size) : AlignedBuffer() { Resize(size); }
+
+            ~AlignedBuffer() { std::free(_data); }
+
+            AlignedBuffer(const AlignedBuffer&) = delete;
+            AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+            AlignedBuffer(AlignedBuffer&& other) noexcept : _data(other._data), _size(other._size) {
+                other._data = nullptr;
+                other._size = 0;
+            }
+
+            AlignedBuffer& operator=(AlignedBuffer&& other) noexcept {
+                std::swap(_data, other._data);
+                std::swap(_size, other._size);
+                return *this;
+            }
+
+            /** makes room for at least size elements. the buffer is only reallocated
+             *  when it grows and the old contents are not kept
+             */
+            void Resize(size_t size) {
+                if (size <= _size) return;
+
+                // aligned_alloc requires the size to be a multiple of the alignment
+                size_t bytes = (size*sizeof(T) + alignment - 1)/alignment*alignment;
+
+                T* data = static_cast<T*>(std::aligned_alloc(alignment, bytes));
+                if (data == nullptr) throw std::bad_alloc();
+
+                std::free(_data);
+                _data = data;
+                _size = size;
+            }
+
+            T* Data() { return _data; }
+            const T* Data() const { return _data; }
+
+            size_t Size() const { return _size; }
+
+        private:
+            T* _data;
+            size_t _size;
+        };
+
+    } // namespace Util
+} // namespace OptimizationTests
+
+#endif // ALIGNED_BUFFER_H
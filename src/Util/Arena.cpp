@@ -0,0 +1,90 @@
+/*
+Arena.cpp
+Evan Newman
+*/
+
+#include "Arena.h"
+
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#include <sys/mman.h>
+
+namespace OptimizationTests {
+    namespace Util {
+
+        Arena::Arena() : _data(nullptr), _capacity(0), _used(0), _huge_pages(false) {}
+
+        Arena::Arena(size_t bytes) : Arena() { Reserve(bytes); }
+
+        Arena::~Arena() { Unmap(); }
+
+        Arena::Arena(Arena&& other) noexcept
+            : _data(other._data), _capacity(other._capacity), _used(other._used), _huge_pages(other._huge_pages) {
+            other._data = nullptr;
+            other._capacity = 0;
+            other._used = 0;
+            other._huge_pages = false;
+        }
+
+        Arena& Arena::operator=(Arena&& other) noexcept {
+            std::swap(_data, other._data);
+            std::swap(_capacity, other._capacity);
+            std::swap(_used, other._used);
+            std::swap(_huge_pages, other._huge_pages);
+            return *this;
+        }
+
+        void Arena::Reserve(size_t bytes) {
+            if (bytes <= _capacity) return;
+
+            // anything big enough to want huge pages is rounded up to whole ones, the rest to cache lines
+            const bool huge = bytes >= huge_page_size;
+            const size_t granule = huge ? huge_page_size : alignment;
+            const size_t size = (bytes + granule - 1)/granule*granule;
+
+            /* mmap hands out whole pages, so the block is at least cache line aligned. a huge
+             * page can only back a huge page aligned range, so a huge block is mapped one huge
+             * page larger and the ends on either side of the aligned range are unmapped again
+             */
+            const size_t mapped = huge ? size + huge_page_size : size;
+
+            void* mapping = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mapping == MAP_FAILED) throw std::bad_alloc();
+
+            char* data = static_cast<char*>(mapping);
+            bool huge_pages = false;
+
+            if (huge) {
+                const uintptr_t address = reinterpret_cast<uintptr_t>(mapping);
+                const size_t head = (huge_page_size - address % huge_page_size) % huge_page_size;
+
+                data += head;
+                if (head != 0) munmap(mapping, head);
+                munmap(data + size, mapped - head - size);
+
+                // only a hint, without transparent huge pages the block is backed by regular pages
+#ifdef MADV_HUGEPAGE
+                huge_pages = madvise(data, size, MADV_HUGEPAGE) == 0;
+#endif
+            }
+
+            Unmap();
+            _data = data;
+            _capacity = size;
+            _used = 0;
+            _huge_pages = huge_pages;
+        }
+
+        void Arena::Unmap() {
+            if (_data != nullptr) munmap(_data, _capacity);
+
+            _data = nullptr;
+            _capacity = 0;
+            _used = 0;
+            _huge_pages = false;
+        }
+
+    } // namespace Util
+} // namespace OptimizationTests
@@ -0,0 +1,90 @@
+/*
+Arena.h a huge page backed scratch arena
+Evan Newman
+*/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <new>
+
+namespace OptimizationTests {
+    namespace Util {
+
+        /** A block of anonymous memory handed out by bumping a pointer, for scratch space
+         *  that is reused call after call. Blocks of 2MB or more are rounded up to whole
+         *  huge pages and asked to be backed by them, so a packed operand doesn't spend
+         *  its TLB entries on 4KB pages. Every allocation is aligned to a cache line.
+         *
+         *  Reserve the whole size up front, then Allocate pieces of it and Reset once the
+         *  pieces are no longer needed. nothing is freed until the arena is destroyed
+         */
+        class Arena {
+        public:
+            static constexpr size_t alignment = 64;
+            static constexpr size_t huge_page_size = size_t(2) << 20;
+
+            Arena();
+
+            explicit Arena(size_t bytes);
+
+            ~Arena();
+
+            Arena(const Arena&) = delete;
+            Arena& operator=(const Arena&) = delete;
+
+            Arena(Arena&& other) noexcept;
+            Arena& operator=(Arena&& other) noexcept;
+
+            /** makes room for at least bytes, counting the alignment padding of every
+             *  allocation. the block is only remapped when it grows, which invalidates
+             *  everything allocated from it, so only call this after a Reset
+             */
+            void Reserve(size_t bytes);
+
+            /** count uninitialized elements of a trivial type, cache line aligned
+             *
+             * \return a pointer into the arena, valid until the next Reset or Reserve
+             *
+             * throws std::bad_alloc when the reserved block is used up
+             */
+            template <typename T>
+            T* Allocate(size_t count) {
+                size_t bytes = (count*sizeof(T) + alignment - 1)/alignment*alignment;
+                if (bytes > _capacity - _used) throw std::bad_alloc();
+
+                T* data = reinterpret_cast<T*>(_data + _used);
+                _used += bytes;
+                return data;
+            }
+
+            /** hands the whole block out again
+             */
+            void Reset() { _used = 0; }
+
+            size_t Capacity() const { return _capacity; }
+            size_t Used() const { return _used; }
+
+            // whether the kernel was asked to back the block with huge pages
+            bool HugePages() const { return _huge_pages; }
+
+            /** the bytes an allocation of count elements of T takes out of an arena,
+             *  for adding up what to Reserve
+             */
+            template <typename T>
+            static size_t Footprint(size_t count) { return (count*sizeof(T) + alignment - 1)/alignment*alignment; }
+
+        private:
+            void Unmap();
+
+            char* _data;
+            size_t _capacity;
+            size_t _used;
+            bool _huge_pages;
+        };
+
+    } // namespace Util
+} // namespace OptimizationTests
+
+#endif // ARENA_H
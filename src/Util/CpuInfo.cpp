@@ -0,0 +1,79 @@
+/*
+CpuInfo.cpp
+Evan Newman
+*/
+
+#include "CpuInfo.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace OptimizationTests {
+    namespace Util {
+
+        std::string CpuModelName() {
+#if defined(__x86_64__) || defined(__i386__)
+            unsigned int max_leaf = __get_cpuid_max(0x80000000, nullptr);
+            if (max_leaf < 0x80000004) return "unknown";
+
+            // the brand string is spread over the registers of leaves 0x80000002 to 0x80000004
+            unsigned int regs[12];
+            for (unsigned int leaf = 0; leaf < 3; leaf++) {
+                __get_cpuid(0x80000002 + leaf, &regs[4*leaf], &regs[4*leaf + 1], &regs[4*leaf + 2], &regs[4*leaf + 3]);
+            }
+
+            char brand[sizeof(regs) + 1];
+            std::memcpy(brand, regs, sizeof(regs));
+            brand[sizeof(regs)] = '\0';
+
+            std::string name(brand);
+            size_t first = name.find_first_not_of(' ');
+            size_t last = name.find_last_not_of(' ');
+            if (first == std::string::npos) return "unknown";
+
+            return name.substr(first, last - first + 1);
+#else
+            return "unknown";
+#endif
+        }
+
+        Isa DetectIsa() {
+#if defined(__x86_64__) || defined(__i386__)
+            // __builtin_cpu_supports also checks that the os saves the wider registers
+            __builtin_cpu_init();
+
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+                if (__builtin_cpu_supports("avx512f")) return Isa::Avx512;
+                return Isa::Avx2;
+            }
+
+            if (__builtin_cpu_supports("sse4.2")) return Isa::Sse42;
+#endif
+            return Isa::Generic;
+        }
+
+        const char* IsaName(Isa isa) {
+            switch (isa) {
+                case Isa::Generic: return "generic";
+                case Isa::Sse42: return "sse4.2";
+                case Isa::Avx2: return "avx2";
+                case Isa::Avx512: return "avx512";
+            }
+            return "unknown";
+        }
+
+        bool ParseIsa(const std::string& name, Isa& isa) {
+            for (Isa candidate : {Isa::Generic, Isa::Sse42, Isa::Avx2, Isa::Avx512}) {
+                if (name == IsaName(candidate)) {
+                    isa = candidate;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    } // namespace Util
+} // namespace OptimizationTests
@@ -0,0 +1,49 @@
+/*
+CpuInfo.h queries about the processor the program is running on
+Evan Newman
+*/
+
+#ifndef CPU_INFO_H
+#define CPU_INFO_H
+
+#include <string>
+
+namespace OptimizationTests {
+    namespace Util {
+
+        /** the instruction sets kernels are built for, in increasing order so a processor
+         *  supporting one supports every one before it
+         */
+        enum class Isa {
+            Generic,  // whatever the compiler targets by default, sse2 on x86-64
+            Sse42,
+            Avx2,     // avx2 and fma
+            Avx512    // avx512f on top of avx2 and fma
+        };
+
+        /** the processor brand string reported by cpuid, ie "Intel(R) Xeon(R) Processor",
+         *  or "unknown" on processors without one
+         */
+        std::string CpuModelName();
+
+        /** the newest instruction set both the processor and the operating system support
+         */
+        Isa DetectIsa();
+
+        /** the name of an instruction set, ie "avx2"
+         */
+        const char* IsaName(Isa isa);
+
+        /** parses a name returned by IsaName
+         *
+         * \param name the name of the instruction set
+         * \param isa set to the instruction set if the name is known
+         *
+         * \return whether the name is known
+         */
+        bool ParseIsa(const std::string& name, Isa& isa);
+
+    } // namespace Util
+} // namespace OptimizationTests
+
+#endif // CPU_INFO_H
@@ -0,0 +1,137 @@
+/*
+MappedFile.cpp
+Evan Newman
+*/
+
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace OptimizationTests {
+    namespace Util {
+
+        namespace {
+
+            std::runtime_error SystemError(const std::string& what, const std::string& path) {
+                return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+            }
+
+            size_t PageSize() {
+                static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+                return page_size;
+            }
+
+        } // namespace
+
+        MappedFile::MappedFile() : _data(nullptr), _size(0), _mode(Mode::ReadOnly) {}
+
+        MappedFile::MappedFile(const std::string& path, Mode mode) : MappedFile() {
+            int fd = open(path.c_str(), mode == Mode::ReadOnly ? O_RDONLY : O_RDWR);
+            if (fd < 0) throw SystemError("couldn't open", path);
+
+            struct stat info;
+            if (fstat(fd, &info) != 0) {
+                close(fd);
+                throw SystemError("couldn't stat", path);
+            }
+
+            Map(fd, static_cast<size_t>(info.st_size), mode, path);
+        }
+
+        MappedFile::MappedFile(const std::string& path, size_t size) : MappedFile() {
+            int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) throw SystemError("couldn't create", path);
+
+            if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+                close(fd);
+                throw SystemError("couldn't resize", path);
+            }
+
+            Map(fd, size, Mode::ReadWrite, path);
+        }
+
+        MappedFile::~MappedFile() {
+            Unmap();
+        }
+
+        MappedFile::MappedFile(MappedFile&& other) noexcept : _data(other._data), _size(other._size), _mode(other._mode) {
+            other._data = nullptr;
+            other._size = 0;
+        }
+
+        MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+            std::swap(_data, other._data);
+            std::swap(_size, other._size);
+            std::swap(_mode, other._mode);
+            return *this;
+        }
+
+        char* MappedFile::Data() {
+            if (_mode != Mode::ReadWrite) throw std::logic_error("the file is mapped read only, it can't be written");
+            return _data;
+        }
+
+        void MappedFile::Map(int fd, size_t size, Mode mode, const std::string& path) {
+            _mode = mode;
+
+            // an empty file can't be mapped, it just has no data
+            if (size == 0) {
+                close(fd);
+                return;
+            }
+
+            int protection = mode == Mode::ReadOnly ? PROT_READ : PROT_READ | PROT_WRITE;
+            void* data = mmap(nullptr, size, protection, MAP_SHARED, fd, 0);
+
+            // the mapping keeps the file alive on its own
+            close(fd);
+
+            if (data == MAP_FAILED) throw SystemError("couldn't map", path);
+
+            _data = static_cast<char*>(data);
+            _size = size;
+        }
+
+        void MappedFile::Unmap() {
+            if (_data != nullptr) munmap(_data, _size);
+
+            _data = nullptr;
+            _size = 0;
+        }
+
+        void MappedFile::WillNeed(size_t offset, size_t length) const {
+            if (_data == nullptr || length == 0) return;
+
+            // round out to whole pages, madvise wants a page aligned start
+            size_t begin = offset/PageSize()*PageSize();
+            size_t end = std::min(offset + length, _size);
+
+            madvise(_data + begin, end - begin, MADV_WILLNEED);
+        }
+
+        void MappedFile::DontNeed(size_t offset, size_t length) const {
+            if (_data == nullptr) return;
+
+            // round in to whole pages so neighbouring data in use isn't dropped
+            size_t begin = (offset + PageSize() - 1)/PageSize()*PageSize();
+            size_t end = std::min(offset + length, _size)/PageSize()*PageSize();
+            if (end <= begin) return;
+
+            madvise(_data + begin, end - begin, MADV_DONTNEED);
+        }
+
+        void MappedFile::Sync() const {
+            if (_data != nullptr) msync(_data, _size, MS_SYNC);
+        }
+
+    } // namespace Util
+} // namespace OptimizationTests
@@ -0,0 +1,85 @@
+/*
+MappedFile.h a file mapped into memory
+Evan Newman
+*/
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace OptimizationTests {
+    namespace Util {
+
+        /** A whole file mapped shared into the address space with mmap, so writes go
+         *  back to the file. Pages are read in on first touch and the advice functions
+         *  tell the kernel which ranges are about to be used or are done with
+         */
+        class MappedFile {
+        public:
+            enum class Mode {
+                ReadOnly,
+                ReadWrite
+            };
+
+            MappedFile();
+
+            /** maps an existing file
+             *
+             * \param path the file to map
+             * \param mode whether the mapping may be written
+             */
+            MappedFile(const std::string& path, Mode mode);
+
+            /** creates the file, or truncates an existing one, with size bytes of zeros
+             *  and maps it for reading and writing
+             *
+             * \param path the file to create
+             * \param size the size of the file in bytes
+             */
+            MappedFile(const std::string& path, size_t size);
+
+            ~MappedFile();
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            MappedFile(MappedFile&& other) noexcept;
+            MappedFile& operator=(MappedFile&& other) noexcept;
+
+            /** the mapping for writing, throws std::logic_error if it was mapped read only
+             */
+            char* Data();
+            const char* Data() const { return _data; }
+
+            size_t Size() const { return _size; }
+            Mode GetMode() const { return _mode; }
+
+            /** starts reading the pages covering [offset, offset + length) in the background
+             */
+            void WillNeed(size_t offset, size_t length) const;
+
+            /** drops the pages that lie entirely inside [offset, offset + length) from this
+             *  process, they are read back in if touched again and written pages still reach
+             *  the file
+             */
+            void DontNeed(size_t offset, size_t length) const;
+
+            /** writes every modified page back to the file and waits for it
+             */
+            void Sync() const;
+
+        private:
+            void Map(int fd, size_t size, Mode mode, const std::string& path);
+            void Unmap();
+
+            char* _data;
+            size_t _size;
+            Mode _mode;
+        };
+
+    } // namespace Util
+} // namespace OptimizationTests
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,268 @@
+/*
+Numa.cpp
+Evan Newman
+*/
+
+#include "Numa.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AlignedBuffer.h"
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace OptimizationTests {
+    namespace Util {
+
+        namespace {
+
+            // from linux/mempolicy.h, the syscalls are used directly so nothing needs libnuma
+            constexpr int mpol_bind = 2;
+            constexpr int mpol_interleave = 3;
+            constexpr unsigned mpol_mf_move = 1 << 1;
+
+            constexpr int max_nodes = 1024;
+
+            /** parses a list like "0-3,8,10-11"
+             */
+            std::vector<int> ParseList(const std::string& text) {
+                std::vector<int> values;
+
+                std::stringstream stream(text);
+                std::string range;
+                while (std::getline(stream, range, ',')) {
+                    if (range.empty() || range == "\n") continue;
+
+                    size_t dash = range.find('-');
+                    int first = std::stoi(range.substr(0, dash));
+                    int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+
+                    for (int value = first; value <= last; value++) values.push_back(value);
+                }
+
+                return values;
+            }
+
+            std::string ReadFile(const std::string& path) {
+                std::ifstream file(path);
+                std::stringstream contents;
+                contents << file.rdbuf();
+                return contents.str();
+            }
+
+            std::vector<NumaNode> ReadNodes() {
+                std::vector<NumaNode> nodes;
+
+#ifdef __linux__
+                const std::string root = "/sys/devices/system/node/";
+
+                for (int id : ParseList(ReadFile(root + "has_cpu"))) {
+                    NumaNode node{id, ParseList(ReadFile(root + "node" + std::to_string(id) + "/cpulist"))};
+                    if (!node.cpus.empty()) nodes.push_back(node);
+                }
+#endif
+
+                if (nodes.empty()) {
+                    NumaNode node{0, {}};
+                    unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+                    for (unsigned cpu = 0; cpu < cpus; cpu++) node.cpus.push_back(static_cast<int>(cpu));
+                    nodes.push_back(node);
+                }
+
+                return nodes;
+            }
+
+            // the nodes with memory as the bit mask mbind takes
+            std::vector<unsigned long> MemoryNodeMask() {
+                std::vector<unsigned long> mask(max_nodes/(8*sizeof(unsigned long)), 0);
+
+#ifdef __linux__
+                for (int id : ParseList(ReadFile("/sys/devices/system/node/has_memory"))) {
+                    if (id < max_nodes) mask[id/(8*sizeof(unsigned long))] |= 1ul << (id % (8*sizeof(unsigned long)));
+                }
+#endif
+
+                return mask;
+            }
+
+            // the page aligned range covering [data, data + bytes)
+            void PageRange(const void* data, size_t bytes, uintptr_t& first, size_t& length) {
+#ifdef __linux__
+                const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+#else
+                const uintptr_t page = 4096;
+#endif
+                const uintptr_t begin = reinterpret_cast<uintptr_t>(data);
+                first = begin/page*page;
+                length = (begin + bytes + page - 1)/page*page - first;
+            }
+
+            bool SetPolicy(void* data, size_t bytes, int mode, const std::vector<unsigned long>& mask) {
+#ifdef __linux__
+                if (bytes == 0) return true;
+
+                uintptr_t first;
+                size_t length;
+                PageRange(data, bytes, first, length);
+
+                return syscall(SYS_mbind, first, length, mode, mask.data(), max_nodes, mpol_mf_move) == 0;
+#else
+                (void)data; (void)bytes; (void)mode; (void)mask;
+                return false;
+#endif
+            }
+
+        } // namespace
+
+        const std::vector<NumaNode>& NumaNodes() {
+            static const std::vector<NumaNode> nodes = ReadNodes();
+            return nodes;
+        }
+
+        int CurrentNumaNode() {
+#ifdef __linux__
+            unsigned cpu = 0;
+            unsigned node = 0;
+            if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) return static_cast<int>(node);
+#endif
+            return 0;
+        }
+
+        bool PinThisThread(const std::vector<int>& cpus) {
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu : cpus) {
+                if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+            }
+
+            return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+            (void)cpus;
+            return false;
+#endif
+        }
+
+        std::vector<int> ThisThreadCpus() {
+            std::vector<int> cpus;
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (sched_getaffinity(0, sizeof(set), &set) != 0) return cpus;
+
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+            }
+#endif
+            return cpus;
+        }
+
+        bool BindPages(void* data, size_t bytes, int node) {
+            if (node < 0 || node >= max_nodes) return false;
+
+            std::vector<unsigned long> mask(max_nodes/(8*sizeof(unsigned long)), 0);
+            mask[node/(8*sizeof(unsigned long))] = 1ul << (node % (8*sizeof(unsigned long)));
+
+            return SetPolicy(data, bytes, mpol_bind, mask);
+        }
+
+        bool InterleavePages(void* data, size_t bytes) {
+            return SetPolicy(data, bytes, mpol_interleave, MemoryNodeMask());
+        }
+
+        std::vector<size_t> PagesPerNode(const void* data, size_t bytes) {
+            std::vector<size_t> counts;
+
+#ifdef __linux__
+            uintptr_t first;
+            size_t length;
+            PageRange(data, bytes, first, length);
+
+            const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            const size_t num_pages = length/page;
+
+            // move_pages with no target nodes only reports where each page is
+            std::vector<void*> pages(num_pages);
+            std::vector<int> status(num_pages, -1);
+            for (size_t i = 0; i < num_pages; i++) pages[i] = reinterpret_cast<void*>(first + i*page);
+
+            if (num_pages == 0 || syscall(SYS_move_pages, 0, num_pages, pages.data(), nullptr, status.data(), 0) != 0) return counts;
+
+            for (int node : status) {
+                if (node < 0) continue; // not touched yet, or not a page at all
+                if (static_cast<size_t>(node) >= counts.size()) counts.resize(node + 1, 0);
+                counts[node]++;
+            }
+#else
+            (void)data; (void)bytes;
+#endif
+
+            return counts;
+        }
+
+        double ReadBandwidth(int cpu_node, int memory_node, size_t bytes) {
+            const NumaNode* node = nullptr;
+            for (const NumaNode& candidate : NumaNodes()) {
+                if (candidate.id == cpu_node) node = &candidate;
+            }
+            if (node == nullptr) return 0.0;
+
+            const size_t count = bytes/sizeof(float);
+            AlignedBuffer<float> buffer(count);
+
+            // placed before the first touch, so every page starts out on memory_node
+            BindPages(buffer.Data(), count*sizeof(float), memory_node);
+            std::fill(buffer.Data(), buffer.Data() + count, 1.0f);
+
+            const size_t num_threads = node->cpus.size();
+            std::vector<float> sums(num_threads*16, 0.0f); // a cache line per thread
+
+            auto ReadAll = [&]() {
+                std::vector<std::thread> threads;
+                for (size_t t = 0; t < num_threads; t++) {
+                    threads.emplace_back([&, t]() {
+                        PinThisThread({node->cpus[t]});
+
+                        const size_t first = count*t/num_threads;
+                        const size_t last = count*(t + 1)/num_threads;
+
+                        // several sums so the adds don't wait on each other
+                        float sum[8] = {};
+                        size_t i = first;
+                        for (; i + 8 <= last; i += 8) {
+                            for (int j = 0; j < 8; j++) sum[j] += buffer.Data()[i + j];
+                        }
+                        for (; i < last; i++) sum[0] += buffer.Data()[i];
+
+                        for (int j = 0; j < 8; j++) sums[t*16] += sum[j];
+                    });
+                }
+                for (std::thread& thread : threads) thread.join();
+            };
+
+            // includes starting the threads, which is small next to reading the buffer
+            double best = 0.0;
+            for (int pass = 0; pass < 5; pass++) {
+                auto start = std::chrono::steady_clock::now();
+                ReadAll();
+                std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+                best = std::max(best, count*sizeof(float)/seconds.count()*1e-9);
+            }
+
+            return best;
+        }
+
+    } // namespace Util
+} // namespace OptimizationTests
@@ -0,0 +1,73 @@
+/*
+Numa.h the numa nodes of the machine, thread pinning and page placement
+Evan Newman
+*/
+
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <cstddef>
+#include <vector>
+
+namespace OptimizationTests {
+    namespace Util {
+
+        /** a node with processors, a machine without numa (or not running linux) looks like
+         *  one node holding every processor
+         */
+        struct NumaNode {
+            int id;
+            std::vector<int> cpus;
+        };
+
+        /** the nodes with processors, read from /sys/devices/system/node once
+         */
+        const std::vector<NumaNode>& NumaNodes();
+
+        /** the node the calling thread is running on right now, 0 if it can't be told
+         */
+        int CurrentNumaNode();
+
+        /** restricts the calling thread to the given processors
+         *
+         * \param cpus the processors the thread may run on
+         *
+         * \return whether the operating system allowed it
+         */
+        bool PinThisThread(const std::vector<int>& cpus);
+
+        /** the processors the calling thread may run on, empty if it can't be told
+         */
+        std::vector<int> ThisThreadCpus();
+
+        /** moves the pages covering [data, data + bytes) to the node and keeps any page
+         *  first touched later there. pages are whole, so the ends of the range share their
+         *  pages with whatever is next to it
+         *
+         * \return whether the operating system allowed it, always false without numa
+         */
+        bool BindPages(void* data, size_t bytes, int node);
+
+        /** spreads the pages covering [data, data + bytes) round robin over every node
+         *  with memory, for data every thread reads
+         *
+         * \return whether the operating system allowed it, always false without numa
+         */
+        bool InterleavePages(void* data, size_t bytes);
+
+        /** how many of the pages covering [data, data + bytes) sit on each node, indexed
+         *  by node id. pages that were never touched aren't counted anywhere
+         */
+        std::vector<size_t> PagesPerNode(const void* data, size_t bytes);
+
+        /** how fast the processors of cpu_node read memory on memory_node, one thread per
+         *  processor of cpu_node summing its share of a bytes large buffer
+         *
+         * \return the bandwidth in GB/s, the best of a few passes
+         */
+        double ReadBandwidth(int cpu_node, int memory_node, size_t bytes);
+
+    } // namespace Util
+} // namespace OptimizationTests
+
+#endif // NUMA_H
@@ -0,0 +1,146 @@
+/*
+PerfCounters.cpp
+Evan Newman
+*/
+
+#include "PerfCounters.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace OptimizationTests {
+    namespace Util {
+
+        namespace {
+
+#ifdef __linux__
+            // sets the type and config perf_event_open takes for each event
+            void EventConfig(PerfEvent event, perf_event_attr& attr) {
+                // cache events are (cache, operation << 8, result << 16)
+                auto Cache = [](uint64_t cache) {
+                    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                };
+
+                uint32_t type = PERF_TYPE_HARDWARE;
+                uint64_t config = 0;
+
+                switch (event) {
+                    case PerfEvent::Cycles: config = PERF_COUNT_HW_CPU_CYCLES; break;
+                    case PerfEvent::Instructions: config = PERF_COUNT_HW_INSTRUCTIONS; break;
+                    case PerfEvent::L1dMisses: type = PERF_TYPE_HW_CACHE; config = Cache(PERF_COUNT_HW_CACHE_L1D); break;
+                    case PerfEvent::LlcMisses: config = PERF_COUNT_HW_CACHE_MISSES; break;
+                    case PerfEvent::DtlbMisses: type = PERF_TYPE_HW_CACHE; config = Cache(PERF_COUNT_HW_CACHE_DTLB); break;
+                    case PerfEvent::BranchMisses: config = PERF_COUNT_HW_BRANCH_MISSES; break;
+                    case PerfEvent::Count: break;
+                }
+
+                attr.type = type;
+                attr.config = config;
+            }
+#endif
+
+        } // namespace
+
+        const char* PerfEventName(PerfEvent event) {
+            switch (event) {
+                case PerfEvent::Cycles: return "cycles";
+                case PerfEvent::Instructions: return "instructions";
+                case PerfEvent::L1dMisses: return "l1d_misses";
+                case PerfEvent::LlcMisses: return "llc_misses";
+                case PerfEvent::DtlbMisses: return "dtlb_misses";
+                case PerfEvent::BranchMisses: return "branch_misses";
+                case PerfEvent::Count: break;
+            }
+
+            return "unknown";
+        }
+
+        PerfCounters::PerfCounters() {
+            _fds.fill(-1);
+
+#ifdef __linux__
+            for (size_t i = 0; i < num_perf_events; i++) {
+                perf_event_attr attr;
+                std::memset(&attr, 0, sizeof(attr));
+
+                attr.size = sizeof(attr);
+                EventConfig(static_cast<PerfEvent>(i), attr);
+                attr.disabled = 1;
+                attr.inherit = 1;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+                // this thread, any cpu, no group
+                _fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+
+                if (_fds[i] < 0 && _error.empty()) {
+                    _error = std::string("couldn't open ") + PerfEventName(static_cast<PerfEvent>(i)) + ": " + std::strerror(errno);
+                }
+            }
+#else
+            _error = "performance counters need linux";
+#endif
+        }
+
+        PerfCounters::~PerfCounters() {
+#ifdef __linux__
+            for (int fd : _fds) {
+                if (fd >= 0) close(fd);
+            }
+#endif
+        }
+
+        bool PerfCounters::Available() const {
+            for (int fd : _fds) {
+                if (fd >= 0) return true;
+            }
+            return false;
+        }
+
+        void PerfCounters::Start() {
+#ifdef __linux__
+            for (int fd : _fds) {
+                if (fd < 0) continue;
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+        PerfSample PerfCounters::Stop() {
+            PerfSample sample;
+
+#ifdef __linux__
+            for (int fd : _fds) {
+                if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+
+            for (size_t i = 0; i < num_perf_events; i++) {
+                if (_fds[i] < 0) continue;
+
+                uint64_t values[3]; // count, time enabled, time running
+                if (read(_fds[i], values, sizeof(values)) != static_cast<ssize_t>(sizeof(values))) continue;
+
+                // a counter that never ran (all the hardware counters were taken) has no count to scale
+                if (values[2] == 0) continue;
+
+                sample.values[i] = static_cast<double>(values[0])*values[1]/values[2];
+                sample.valid[i] = true;
+            }
+#endif
+
+            return sample;
+        }
+
+    } // namespace Util
+} // namespace OptimizationTests
@@ -0,0 +1,87 @@
+/*
+PerfCounters.h hardware performance counters around a piece of code, through perf_event_open
+Evan Newman
+*/
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <array>
+#include <cstddef>
+#include <string>
+
+namespace OptimizationTests {
+    namespace Util {
+
+        /** the counters PerfCounters opens
+         */
+        enum class PerfEvent {
+            Cycles,
+            Instructions,
+            L1dMisses,    // l1 data cache read misses
+            LlcMisses,    // last level cache misses
+            DtlbMisses,   // data tlb read misses
+            BranchMisses,
+            Count         // the number of events, not an event
+        };
+
+        constexpr size_t num_perf_events = static_cast<size_t>(PerfEvent::Count);
+
+        /** the name of an event, ie "l1d_misses"
+         */
+        const char* PerfEventName(PerfEvent event);
+
+        /** the counts of one measurement. an event that couldn't be opened isn't valid. when
+         *  there were more events than hardware counters the kernel took turns counting them
+         *  and the counts are scaled up to the whole measurement
+         */
+        struct PerfSample {
+            std::array<double, num_perf_events> values = {};
+            std::array<bool, num_perf_events> valid = {};
+
+            double Value(PerfEvent event) const { return values[static_cast<size_t>(event)]; }
+            bool Valid(PerfEvent event) const { return valid[static_cast<size_t>(event)]; }
+        };
+
+        /** Counts the events in user space on the calling thread, and on threads it starts
+         *  after the counters were opened. Threads that already exist, like the workers of a
+         *  thread pool made earlier, aren't counted. Every event is opened on its own, so
+         *  whichever ones the processor, the kernel or perf_event_paranoid allow are counted
+         *  and the rest are left out, on other systems nothing is
+         */
+        class PerfCounters {
+        public:
+            PerfCounters();
+            ~PerfCounters();
+
+            PerfCounters(const PerfCounters&) = delete;
+            PerfCounters& operator=(const PerfCounters&) = delete;
+
+            /** whether any event could be opened
+             */
+            bool Available() const;
+            bool Available(PerfEvent event) const { return _fds[static_cast<size_t>(event)] >= 0; }
+
+            /** why the first event that couldn't be opened failed, empty if all of them opened
+             */
+            const std::string& Error() const { return _error; }
+
+            /** zeroes and starts every open counter
+             */
+            void Start();
+
+            /** stops the counters
+             *
+             * \return the counts since Start()
+             */
+            PerfSample Stop();
+
+        private:
+            std::array<int, num_perf_events> _fds;
+            std::string _error;
+        };
+
+    } // namespace Util
+} // namespace OptimizationTests
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,136 @@
+/*
+Stats.cpp
+Evan Newman
+*/
+
+#include "Stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace OptimizationTests {
+    namespace Util {
+
+        double Percentile(const std::vector<double>& sorted, double p) {
+            const double rank = p/100.0*(sorted.size() - 1);
+            const size_t below = static_cast<size_t>(std::floor(rank));
+            const size_t above = std::min(below + 1, sorted.size() - 1);
+
+            return sorted[below] + (rank - below)*(sorted[above] - sorted[below]);
+        }
+
+        SampleStats Summarize(std::vector<double> samples) {
+            SampleStats stats;
+            if (samples.empty()) return stats;
+
+            std::sort(samples.begin(), samples.end());
+
+            stats.count = samples.size();
+            stats.min = samples.front();
+            stats.max = samples.back();
+
+            double sum = 0.0;
+            for (double sample : samples) sum += sample;
+            stats.mean = sum/samples.size();
+
+            if (samples.size() > 1) {
+                double squares = 0.0;
+                for (double sample : samples) squares += (sample - stats.mean)*(sample - stats.mean);
+                stats.stddev = std::sqrt(squares/(samples.size() - 1));
+            }
+
+            stats.median = Percentile(samples, 50.0);
+            stats.p90 = Percentile(samples, 90.0);
+            stats.p99 = Percentile(samples, 99.0);
+
+            return stats;
+        }
+
+        RankSumTest MannWhitneyU(const std::vector<double>& a, const std::vector<double>& b) {
+            RankSumTest test;
+            if (a.empty() || b.empty()) return test;
+
+            // (value, from b) of both sets in increasing order
+            std::vector<std::pair<double, bool>> pooled;
+            pooled.reserve(a.size() + b.size());
+            for (double sample : a) pooled.emplace_back(sample, false);
+            for (double sample : b) pooled.emplace_back(sample, true);
+            std::sort(pooled.begin(), pooled.end());
+
+            const double n_a = a.size();
+            const double n_b = b.size();
+            const double n = pooled.size();
+
+            // ties share the mean of their ranks, and shrink the variance
+            double rank_sum_b = 0.0;
+            double ties = 0.0;
+
+            for (size_t first = 0; first < pooled.size();) {
+                size_t last = first;
+                while (last + 1 < pooled.size() && pooled[last + 1].first == pooled[first].first) last++;
+
+                const double rank = (first + last)/2.0 + 1.0;
+                for (size_t i = first; i <= last; i++) {
+                    if (pooled[i].second) rank_sum_b += rank;
+                }
+
+                const double tied = last - first + 1;
+                ties += tied*tied*tied - tied;
+
+                first = last + 1;
+            }
+
+            test.u = rank_sum_b - n_b*(n_b + 1.0)/2.0;
+
+            const double mean = n_a*n_b/2.0;
+            const double variance = n_a*n_b/12.0*((n + 1.0) - ties/(n*(n - 1.0)));
+            if (variance <= 0.0) return test;
+
+            const double sd = std::sqrt(variance);
+            test.z = (test.u - mean)/sd;
+
+            // each tail with its own continuity correction
+            test.p_greater = std::min(1.0, 0.5*std::erfc((test.u - mean - 0.5)/sd/std::sqrt(2.0)));
+            test.p_less = std::min(1.0, 0.5*std::erfc(-(test.u - mean + 0.5)/sd/std::sqrt(2.0)));
+
+            return test;
+        }
+
+        Interval BootstrapMedianRatio(const std::vector<double>& a, const std::vector<double>& b,
+                                      double confidence, int resamples) {
+            if (a.empty() || b.empty() || resamples < 1) return {NAN, NAN};
+
+            std::mt19937_64 generator(0x5eed);
+            std::vector<double> resample;
+
+            auto ResampledMedian = [&](const std::vector<double>& samples) {
+                std::uniform_int_distribution<size_t> pick(0, samples.size() - 1);
+
+                resample.resize(samples.size());
+                for (double& sample : resample) sample = samples[pick(generator)];
+
+                std::sort(resample.begin(), resample.end());
+                return Percentile(resample, 50.0);
+            };
+
+            std::vector<double> ratios;
+            ratios.reserve(resamples);
+
+            for (int i = 0; i < resamples; i++) {
+                const double median_a = ResampledMedian(a);
+                const double median_b = ResampledMedian(b);
+                ratios.push_back(median_b/median_a);
+            }
+
+            std::sort(ratios.begin(), ratios.end());
+
+            const double tail = (1.0 - confidence)/2.0*100.0;
+            return {Percentile(ratios, tail), Percentile(ratios, 100.0 - tail)};
+        }
+
+    } // namespace Util
+} // namespace OptimizationTests
@@ -0,0 +1,79 @@
+/*
+Stats.h summary statistics and comparisons of timing samples
+Evan Newman
+*/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstddef>
+#include <vector>
+
+namespace OptimizationTests {
+    namespace Util {
+
+        /** the distribution of a set of samples, in the samples' unit
+         */
+        struct SampleStats {
+            size_t count = 0;
+            double min = 0.0;
+            double max = 0.0;
+            double mean = 0.0;
+            double stddev = 0.0; // sample standard deviation, 0 for fewer than two samples
+            double median = 0.0;
+            double p90 = 0.0;
+            double p99 = 0.0;
+        };
+
+        /** the p-th percentile of sorted samples, linearly interpolated between the two
+         *  closest ranks like numpy's default
+         *
+         * \param sorted the samples in increasing order, not empty
+         * \param p the percentile in [0, 100]
+         */
+        double Percentile(const std::vector<double>& sorted, double p);
+
+        /** summarizes the samples, an empty set gives all zeros
+         */
+        SampleStats Summarize(std::vector<double> samples);
+
+        /** the result of a Mann-Whitney U test of whether the samples b tend to be larger than a
+         */
+        struct RankSumTest {
+            double u = 0.0;         // the pairs (a_i, b_j) with b_j > a_i, ties counting half
+            double z = 0.0;         // u standardized, positive when b tends to be larger
+            double p_greater = 1.0; // the chance of a z at least this large if both came from one distribution
+            double p_less = 1.0;    // the same for a z at least this small
+        };
+
+        /** the Mann-Whitney U (Wilcoxon rank sum) test of b against a. it only compares the
+         *  order of the samples, so it makes no assumption about their distribution and a few
+         *  outliers can't swing it. uses the normal approximation with the tie and continuity
+         *  corrections, which is close from about 8 samples each
+         *
+         * \return p values of 1 if either set is empty or every sample is equal
+         */
+        RankSumTest MannWhitneyU(const std::vector<double>& a, const std::vector<double>& b);
+
+        /** a confidence interval
+         */
+        struct Interval {
+            double low = 0.0;
+            double high = 0.0;
+        };
+
+        /** a percentile bootstrap confidence interval of median(b)/median(a). both sets are
+         *  resampled with replacement resamples times with a fixed seed, so the same samples
+         *  always give the same interval
+         *
+         * \param confidence the coverage of the interval, in (0, 1)
+         *
+         * \return an interval of nans if either set is empty
+         */
+        Interval BootstrapMedianRatio(const std::vector<double>& a, const std::vector<double>& b,
+                                      double confidence = 0.95, int resamples = 2000);
+
+    } // namespace Util
+} // namespace OptimizationTests
+
+#endif // STATS_H
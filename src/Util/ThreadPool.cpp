@@ -0,0 +1,246 @@
+/*
+ThreadPool.cpp
+Evan Newman
+*/
+
+#include "ThreadPool.h"
+
+#include <exception>
+#include <string>
+#include <utility>
+
+#include "Numa.h"
+#include "Trace.h"
+
+namespace OptimizationTests {
+    namespace Util {
+
+        namespace {
+            // identifies which pool and queue the current thread belongs to
+            thread_local const ThreadPool* t_pool = nullptr;
+            thread_local unsigned t_queue = 0;
+        }
+
+        ThreadPool::ThreadPool(unsigned num_threads, Pinning pinning) : _stop(false), _queued(0) {
+            if (num_threads == 0) num_threads = std::thread::hardware_concurrency();
+            if (num_threads == 0) num_threads = 1;
+
+            for (unsigned i = 0; i < num_threads; i++) {
+                _queues.push_back(std::make_unique<WorkQueue>());
+            }
+
+            _queue_nodes.assign(num_threads, 0);
+            _queue_cpus.assign(num_threads, -1);
+
+            if (pinning == Pinning::Nodes) {
+                const std::vector<NumaNode>& nodes = NumaNodes();
+
+                // consecutive queues share a node, so the low task indices of ParallelFor land on the first node
+                std::vector<unsigned> used(nodes.size(), 0);
+                for (unsigned i = 0; i < num_threads; i++) {
+                    const size_t node = static_cast<size_t>(i)*nodes.size()/num_threads;
+                    const std::vector<int>& cpus = nodes[node].cpus;
+
+                    _queue_nodes[i] = nodes[node].id;
+                    _queue_cpus[i] = cpus[used[node]++ % cpus.size()];
+                }
+            }
+
+            // queue 0 belongs to whichever thread submits work
+            for (unsigned i = 1; i < num_threads; i++) {
+                _workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+            }
+        }
+
+        ThreadPool::~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(_sleep_mutex);
+                _stop = true;
+            }
+            _wake.notify_all();
+
+            for (std::thread& worker : _workers) worker.join();
+        }
+
+        ThreadPool& ThreadPool::Default() {
+            static ThreadPool pool;
+            return pool;
+        }
+
+        void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& body) {
+            if (count == 0) return;
+
+            if (NumThreads() == 1 || count == 1) {
+                for (size_t i = 0; i < count; i++) body(i);
+                return;
+            }
+
+            Completion done(count);
+
+            // push in reverse so each owner pops its lowest index first from the back
+            // while thieves take the highest indices, which callers use for the ragged edges
+            for (size_t i = count; i-- > 0;) {
+                Push(static_cast<unsigned>(i % NumThreads()), Task{[&body, i]() { body(i); }, &done});
+            }
+
+            WaitFor(done.pending);
+            done.Rethrow();
+        }
+
+        void ThreadPool::RunOnEach(const std::function<void(unsigned)>& body) {
+            Completion done(NumThreads() - 1);
+
+            for (unsigned queue = 1; queue < NumThreads(); queue++) {
+                RunOn(queue, Task{[&body, queue]() { body(queue); }, &done});
+            }
+
+            // the calling thread owns queue 0, it moves to that queue's processor for its share
+            std::vector<int> caller_cpus;
+            if (_queue_cpus[0] >= 0) {
+                caller_cpus = ThisThreadCpus();
+                PinThisThread({_queue_cpus[0]});
+            }
+
+            // the other queues' tasks still use body and done, so they have to finish before this unwinds
+            try {
+                body(0);
+            } catch (...) {
+                done.Fail(std::current_exception());
+            }
+
+            if (!caller_cpus.empty()) PinThisThread(caller_cpus);
+
+            WaitFor(done.pending);
+            done.Rethrow();
+        }
+
+        void ThreadPool::Completion::Fail(std::exception_ptr exception) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) error = std::move(exception);
+        }
+
+        void ThreadPool::Completion::Rethrow() {
+            std::exception_ptr exception;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                std::swap(exception, error);
+            }
+
+            if (exception) std::rethrow_exception(exception);
+        }
+
+        void ThreadPool::TaskGroup::Run(std::function<void()> func) {
+            _done.pending++;
+            _pool.Push(_pool.CurrentQueue(), Task{std::move(func), &_done});
+        }
+
+        void ThreadPool::TaskGroup::Wait() {
+            _pool.WaitFor(_done.pending);
+            _done.Rethrow();
+        }
+
+        void ThreadPool::Push(unsigned queue, Task task) {
+            // count the task before it becomes visible so the counter never underflows
+            _queued++;
+            {
+                std::lock_guard<std::mutex> lock(_queues[queue]->mutex);
+                _queues[queue]->tasks.push_back(std::move(task));
+            }
+
+            // take the sleep lock so a worker can't miss the wake between its check and its wait
+            { std::lock_guard<std::mutex> lock(_sleep_mutex); }
+            _wake.notify_one();
+        }
+
+        void ThreadPool::RunOn(unsigned queue, Task task) {
+            {
+                std::lock_guard<std::mutex> lock(_queues[queue]->mutex);
+                _queues[queue]->owned.push_back(std::move(task));
+                _queues[queue]->owned_queued++;
+            }
+
+            // only one worker may run it, so wake all of them rather than whichever is first
+            { std::lock_guard<std::mutex> lock(_sleep_mutex); }
+            _wake.notify_all();
+        }
+
+        bool ThreadPool::Pop(unsigned queue, Task& task) {
+            std::lock_guard<std::mutex> lock(_queues[queue]->mutex);
+
+            if (!_queues[queue]->owned.empty()) {
+                task = std::move(_queues[queue]->owned.front());
+                _queues[queue]->owned.pop_front();
+                _queues[queue]->owned_queued--;
+                return true;
+            }
+
+            if (_queues[queue]->tasks.empty()) return false;
+
+            task = std::move(_queues[queue]->tasks.back());
+            _queues[queue]->tasks.pop_back();
+            _queued--;
+            return true;
+        }
+
+        bool ThreadPool::Steal(unsigned thief, Task& task) {
+            for (unsigned offset = 1; offset < NumThreads(); offset++) {
+                WorkQueue& victim = *_queues[(thief + offset) % NumThreads()];
+
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (victim.tasks.empty()) continue;
+
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                _queued--;
+                return true;
+            }
+
+            return false;
+        }
+
+        bool ThreadPool::RunOne(unsigned queue) {
+            Task task;
+            if (!Pop(queue, task) && !Steal(queue, task)) return false;
+
+            // a throw is handed to whoever waits for the task, it must not unwind this thread past the
+            // other tasks it may be waiting for, or end a worker
+            try {
+                task.func();
+            } catch (...) {
+                task.done->Fail(std::current_exception());
+            }
+
+            task.done->pending.fetch_sub(1, std::memory_order_release);
+            return true;
+        }
+
+        void ThreadPool::WaitFor(const std::atomic<size_t>& pending) {
+            unsigned queue = CurrentQueue();
+
+            while (pending.load(std::memory_order_acquire) != 0) {
+                if (!RunOne(queue)) std::this_thread::yield();
+            }
+        }
+
+        unsigned ThreadPool::CurrentQueue() const {
+            return t_pool == this ? t_queue : 0;
+        }
+
+        void ThreadPool::WorkerLoop(unsigned queue) {
+            t_pool = this;
+            t_queue = queue;
+
+            if (_queue_cpus[queue] >= 0) PinThisThread({_queue_cpus[queue]});
+            if (trace_compiled_in) NameTraceThread("pool worker " + std::to_string(queue));
+
+            while (true) {
+                if (RunOne(queue)) continue;
+
+                std::unique_lock<std::mutex> lock(_sleep_mutex);
+                _wake.wait(lock, [this, queue]() { return _stop || _queued > 0 || _queues[queue]->owned_queued > 0; });
+                if (_stop) return;
+            }
+        }
+
+    } // namespace Util
+} // namespace OptimizationTests
@@ -0,0 +1,177 @@
+/*
+ThreadPool.h a work-stealing thread pool with one task deque per worker
+Evan Newman
+*/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace OptimizationTests {
+    namespace Util {
+
+        /** A fixed size pool of worker threads. Every worker owns a deque of tasks,
+         *  it pops work from the back of its own deque and steals from the front of
+         *  the other deques when it runs dry. The thread that submits work always
+         *  takes part in running it, so a pool of N threads starts N-1 workers.
+         *  An exception thrown by a task is kept until every task of the same
+         *  ParallelFor, RunOnEach or TaskGroup has finished, then the first one is
+         *  rethrown on the thread waiting for them
+         */
+        class ThreadPool {
+        public:
+            /** where the workers may run
+             */
+            enum class Pinning {
+                None,  // anywhere, up to the operating system
+                Nodes  // each on one processor, spread evenly over the numa nodes, see QueueNode
+            };
+
+            /** \param num_threads the total number of threads including the caller,
+             *                     0 uses std::thread::hardware_concurrency()
+             *  \param pinning whether to pin the workers to processors
+             */
+            explicit ThreadPool(unsigned num_threads = 0, Pinning pinning = Pinning::None);
+            ~ThreadPool();
+
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+
+            /** the number of threads that run tasks, including the calling thread
+             */
+            unsigned NumThreads() const { return static_cast<unsigned>(_queues.size()); }
+
+            /** the numa node the thread owning a queue runs on. queue 0 belongs to whichever
+             *  thread submits work, it counts as being on the first node and RunOnEach pins
+             *  the submitting thread there. all 0 for a pool that isn't pinned
+             */
+            int QueueNode(unsigned queue) const { return _queue_nodes[queue]; }
+
+            /** runs body(i) for every i in [0, count) and returns once all of them finished.
+             *  the indices are dealt round robin over the worker deques, lower indices are
+             *  run first by their owner and idle workers steal from the other end
+             *
+             * \param count the number of tasks
+             * \param body the function to run for each task index
+             */
+            void ParallelFor(size_t count, const std::function<void(size_t)>& body);
+
+            /** runs body(queue) once for every queue, each on the thread that owns the queue.
+             *  none of them can be stolen, so work placed by QueueNode stays on its node.
+             *  the calling thread runs queue 0's share, pinned to that queue's processor
+             *  while it does on a pinned pool. call it from outside the pool
+             *
+             * \param body the function to run for each queue
+             */
+            void RunOnEach(const std::function<void(unsigned)>& body);
+
+            /** a pool shared by the whole program, sized to the hardware
+             */
+            static ThreadPool& Default();
+
+        private:
+            /** the tasks of one ParallelFor, RunOnEach or TaskGroup that haven't finished,
+             *  and the first exception any of them threw
+             */
+            struct Completion {
+                explicit Completion(size_t count = 0) : pending(count) {}
+
+                /** keeps exception unless an earlier task already threw
+                 */
+                void Fail(std::exception_ptr exception);
+
+                /** rethrows the kept exception, if any, and forgets it
+                 */
+                void Rethrow();
+
+                std::atomic<size_t> pending;
+                std::mutex mutex;
+                std::exception_ptr error;
+            };
+
+        public:
+            /** fork-join over the pool. Run() queues a task on the calling thread's own
+             *  deque and Wait() keeps running queued or stolen tasks until every task of
+             *  the group has finished, so recursive algorithms can fork at each level.
+             *  Wait() rethrows the first exception of the group's tasks, the destructor
+             *  only waits for them
+             */
+            class TaskGroup {
+            public:
+                explicit TaskGroup(ThreadPool& pool) : _pool(pool) {}
+                ~TaskGroup() { _pool.WaitFor(_done.pending); }
+
+                TaskGroup(const TaskGroup&) = delete;
+                TaskGroup& operator=(const TaskGroup&) = delete;
+
+                void Run(std::function<void()> func);
+                void Wait();
+
+            private:
+                ThreadPool& _pool;
+                Completion _done;
+            };
+
+        private:
+            struct Task {
+                std::function<void()> func;
+                Completion* done; // counted down once func has run or thrown
+            };
+
+            struct WorkQueue {
+                std::mutex mutex;
+                std::deque<Task> tasks;
+                std::deque<Task> owned;             // only the owner runs these, see RunOn
+                std::atomic<size_t> owned_queued{0};
+            };
+
+            void Push(unsigned queue, Task task);
+
+            /** queues a task that only the thread owning the queue may run
+             */
+            void RunOn(unsigned queue, Task task);
+
+            bool Pop(unsigned queue, Task& task);
+            bool Steal(unsigned thief, Task& task);
+
+            /** runs one task from the given queue or stolen from another,
+             *  returns false if there was no work anywhere
+             */
+            bool RunOne(unsigned queue);
+
+            /** runs tasks until pending reaches 0
+             */
+            void WaitFor(const std::atomic<size_t>& pending);
+
+            /** the queue owned by the calling thread, queue 0 for threads outside the pool
+             */
+            unsigned CurrentQueue() const;
+
+            void WorkerLoop(unsigned queue);
+
+            std::vector<std::unique_ptr<WorkQueue>> _queues;
+            std::vector<int> _queue_nodes;
+            std::vector<int> _queue_cpus; // -1 when the queue's thread isn't pinned
+            std::vector<std::thread> _workers;
+
+            std::atomic<bool> _stop;
+            std::atomic<size_t> _queued; // tasks sitting in any deque that can be stolen
+
+            std::mutex _sleep_mutex;
+            std::condition_variable _wake;
+        };
+
+    } // namespace Util
+} // namespace OptimizationTests
+
+#endif // THREAD_POOL_H
@@ -7,16 +7,28 @@ Evan Newman
 #define TIMER_H
 
 #include <chrono>
+#include <limits>
+#include <sstream>
 #include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "PerfCounters.h"
 
 namespace OptimizationTests {
     namespace Util {
 
         class Timer {
         public:
-            Timer() : _has_started(false), _min(std::numeric_limits<double>::max()), _max(0.0), _sum(0.0), _count(0.0) {}
+            Timer() : _has_started(false), _counters(nullptr), _min(std::numeric_limits<double>::max()), _max(0.0), _sum(0.0), _count(0.0) {}
+
+            /** also reads the counters around every Start() and Stop(), nullptr to stop.
+             *  the counters aren't owned and must outlive their use here
+             */
+            void AttachCounters(PerfCounters* counters) { _counters = counters; }
 
             void Start() {
+                if (_counters != nullptr) _counters->Start();
                 _t0 = std::chrono::steady_clock::now();
 
                 if (_has_started) throw std::logic_error("Cannot start an already started timer");
@@ -44,6 +56,9 @@ namespace OptimizationTests {
                 _sum += dt_ms;
                 _count++;
 
+                _samples.push_back(dt_ms);
+                if (_counters != nullptr) _counter_samples.push_back(_counters->Stop());
+
                 return dt_ms;
             }
 
@@ -67,21 +82,35 @@ namespace OptimizationTests {
                 return msg.str(); 
             }
 
+            /** every time measured by Stop() since the last Reset(), in ms
+             */
+            const std::vector<double>& Samples() const { return _samples; }
+
+            /** the counts of every Stop() since the last Reset() that had counters attached
+             */
+            const std::vector<PerfSample>& CounterSamples() const { return _counter_samples; }
+
             void Reset() {
                 _min = std::numeric_limits<double>::max();
                 _max = 0.0;
                 _sum = 0.0;
                 _count = 0;
+                _samples.clear();
+                _counter_samples.clear();
             }
 
         private:
             bool _has_started;
             std::chrono::steady_clock::time_point _t0;
+            PerfCounters* _counters;
 
             double _min;
             double _max;
             double _sum;
             int _count;
+
+            std::vector<double> _samples;
+            std::vector<PerfSample> _counter_samples;
         };
 
     } // namespace Util
@@ -0,0 +1,214 @@
+/*
+Trace.cpp
+Evan Newman
+*/
+
+#include "Trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace OptimizationTests {
+    namespace Util {
+
+        namespace {
+
+            struct TraceEvent {
+                const char* name;
+                uint64_t begin;
+                uint64_t end;
+            };
+
+            // a thread's events live in chunks that are never moved, so a writer never
+            // has to wait for the thread recording into them
+            constexpr size_t chunk_events = size_t(1) << 14;
+            constexpr size_t max_chunks = 256; // 4M zones per thread, the rest are dropped
+
+            /** the events of one thread. only that thread appends, count is published with
+             *  release so everything below it can be read from another thread
+             */
+            struct ThreadTrace {
+                std::string name;
+                uint64_t generation = 0; // of the trace the events belong to
+                std::atomic<size_t> count{0};
+                std::atomic<size_t> dropped{0};
+                std::unique_ptr<TraceEvent[]> chunks[max_chunks];
+            };
+
+            std::atomic<bool> g_running{false};
+            std::atomic<uint64_t> g_generation{0};
+
+            // every thread that ever recorded, kept after the thread exits so its zones can still be written
+            std::mutex g_threads_mutex;
+            std::vector<std::unique_ptr<ThreadTrace>> g_threads;
+
+            // the clock at StartTrace, to turn ticks into microseconds
+            uint64_t g_start_ticks = 0;
+            std::chrono::steady_clock::time_point g_start_time;
+
+            thread_local ThreadTrace* t_trace = nullptr;
+            thread_local std::string t_name;
+
+            /** the time stamp counter where there is one, it is much cheaper to read than
+             *  steady_clock and constant rate on anything recent
+             */
+            uint64_t Ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+                return __rdtsc();
+#else
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+            }
+
+            ThreadTrace& ThisThread() {
+                if (t_trace != nullptr) return *t_trace;
+
+                std::lock_guard<std::mutex> lock(g_threads_mutex);
+
+                g_threads.push_back(std::make_unique<ThreadTrace>());
+                t_trace = g_threads.back().get();
+                t_trace->name = t_name.empty() ? "thread " + std::to_string(g_threads.size() - 1) : t_name;
+
+                return *t_trace;
+            }
+
+            void Record(const char* name, uint64_t begin, uint64_t end) {
+                ThreadTrace& trace = ThisThread();
+
+                // the first zone of a new trace drops the thread's old one
+                const uint64_t generation = g_generation.load(std::memory_order_acquire);
+                if (trace.generation != generation) {
+                    trace.generation = generation;
+                    trace.count.store(0, std::memory_order_release);
+                    trace.dropped.store(0, std::memory_order_relaxed);
+                }
+
+                const size_t index = trace.count.load(std::memory_order_relaxed);
+                const size_t chunk = index/chunk_events;
+
+                if (chunk == max_chunks) {
+                    trace.dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+
+                if (trace.chunks[chunk] == nullptr) trace.chunks[chunk] = std::make_unique<TraceEvent[]>(chunk_events);
+
+                trace.chunks[chunk][index%chunk_events] = {name, begin, end};
+                trace.count.store(index + 1, std::memory_order_release);
+            }
+
+            /** writes a json string, zone and thread names are plain text but could hold a quote
+             */
+            void WriteJsonString(const std::string& text, std::ostream& out) {
+                out << '"';
+                for (char ch : text) {
+                    if (ch == '"' || ch == '\\') out << '\\';
+                    if (static_cast<unsigned char>(ch) >= 0x20) out << ch;
+                }
+                out << '"';
+            }
+
+        } // namespace
+
+        void StartTrace() {
+            g_running.store(false, std::memory_order_release);
+
+            g_start_time = std::chrono::steady_clock::now();
+            g_start_ticks = Ticks();
+
+            g_generation.fetch_add(1, std::memory_order_acq_rel);
+            g_running.store(true, std::memory_order_release);
+        }
+
+        void StopTrace() {
+            g_running.store(false, std::memory_order_release);
+        }
+
+        bool TraceRunning() {
+            return g_running.load(std::memory_order_relaxed);
+        }
+
+        void NameTraceThread(const std::string& name) {
+            t_name = name;
+
+            if (t_trace != nullptr) {
+                std::lock_guard<std::mutex> lock(g_threads_mutex);
+                t_trace->name = name;
+            }
+        }
+
+        size_t WriteChromeTrace(std::ostream& out) {
+            // the tick rate over the whole trace, so a steady clock is all the calibration needed
+            const uint64_t end_ticks = Ticks();
+            const double elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - g_start_time).count();
+            const double us_per_tick = end_ticks > g_start_ticks && elapsed_us > 0.0 ? elapsed_us/(end_ticks - g_start_ticks) : 0.0;
+
+            const uint64_t generation = g_generation.load(std::memory_order_acquire);
+
+            std::lock_guard<std::mutex> lock(g_threads_mutex);
+
+            out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+            size_t written = 0;
+            bool first = true;
+
+            for (size_t thread = 0; thread < g_threads.size(); thread++) {
+                const ThreadTrace& trace = *g_threads[thread];
+                if (trace.generation != generation) continue;
+
+                const size_t count = trace.count.load(std::memory_order_acquire);
+                if (count == 0) continue;
+
+                out << (first ? "" : ",") << std::endl
+                    << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << thread << ", \"args\": {\"name\": ";
+                WriteJsonString(trace.name, out);
+                out << "}}";
+                first = false;
+
+                for (size_t i = 0; i < count; i++) {
+                    const TraceEvent& event = trace.chunks[i/chunk_events][i%chunk_events];
+
+                    // zones from before StartTrace that ended after it start at 0
+                    const uint64_t begin = event.begin > g_start_ticks ? event.begin - g_start_ticks : 0;
+                    const uint64_t end = event.end > g_start_ticks ? event.end - g_start_ticks : 0;
+
+                    out << "," << std::endl << "{\"name\": ";
+                    WriteJsonString(event.name, out);
+                    out << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << thread
+                        << ", \"ts\": " << begin*us_per_tick << ", \"dur\": " << (end - begin)*us_per_tick << "}";
+                }
+
+                const size_t dropped = trace.dropped.load(std::memory_order_relaxed);
+                if (dropped != 0) {
+                    out << "," << std::endl << "{\"name\": \"dropped zones\", \"ph\": \"i\", \"s\": \"t\", \"pid\": 1, \"tid\": " << thread
+                        << ", \"ts\": 0, \"args\": {\"count\": " << dropped << "}}";
+                }
+
+                written += count;
+            }
+
+            out << std::endl << "]}" << std::endl;
+
+            return written;
+        }
+
+        TraceZone::TraceZone(const char* name) : _name(name), _begin(0) {
+            if (g_running.load(std::memory_order_relaxed)) _begin = Ticks();
+        }
+
+        TraceZone::~TraceZone() {
+            if (_begin != 0 && g_running.load(std::memory_order_relaxed)) Record(_name, _begin, Ticks());
+        }
+
+    } // namespace Util
+} // namespace OptimizationTests
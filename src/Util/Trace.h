@@ -0,0 +1,87 @@
+/*
+Trace.h scoped timing zones recorded per thread and written as a chrome trace
+Evan Newman
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/* zones are only compiled in when the build sets OPTIMIZATION_TESTS_TRACE (cmake
+ * -DOPTIMIZATION_TESTS_TRACE=ON), otherwise TRACE_ZONE expands to nothing. compiled in, a
+ * zone costs two calls and a flag check while no trace is running, and two timestamps and an
+ * append to a buffer of its own thread while one is
+ *
+ *     void PackA(...) {
+ *         TRACE_ZONE("pack a");
+ *         ...
+ *     }
+ *
+ * zones nest, every zone ends when its scope does. the name has to outlive the trace, in
+ * practice a string literal
+ */
+#if defined(OPTIMIZATION_TESTS_TRACE)
+#define TRACE_CONCAT_INNER(x, y) x##y
+#define TRACE_CONCAT(x, y) TRACE_CONCAT_INNER(x, y)
+#define TRACE_ZONE(name) ::OptimizationTests::Util::TraceZone TRACE_CONCAT(trace_zone_, __LINE__)(name)
+#else
+#define TRACE_ZONE(name) static_cast<void>(0)
+#endif
+
+namespace OptimizationTests {
+    namespace Util {
+
+        // whether this build records TRACE_ZONE at all
+#if defined(OPTIMIZATION_TESTS_TRACE)
+        constexpr bool trace_compiled_in = true;
+#else
+        constexpr bool trace_compiled_in = false;
+#endif
+
+        /** drops whatever was recorded and starts recording zones on every thread
+         */
+        void StartTrace();
+
+        /** stops recording, what was recorded is kept for WriteChromeTrace
+         */
+        void StopTrace();
+
+        bool TraceRunning();
+
+        /** the name this thread gets in the trace, ie "pool 2 worker 3". threads that aren't
+         *  named are called "thread" and the order they first recorded a zone in
+         */
+        void NameTraceThread(const std::string& name);
+
+        /** writes every zone recorded since StartTrace as chrome trace event json, which
+         *  chrome://tracing and ui.perfetto.dev open, one track per thread in microseconds.
+         *  zones still open aren't written. call it after StopTrace, or at least while no
+         *  zone is being recorded
+         *
+         * \return the zones written
+         */
+        size_t WriteChromeTrace(std::ostream& out);
+
+        /** one zone, see TRACE_ZONE. nothing is inline, so the kernels compiled once per
+         *  instruction set can use it as well, see MatrixMultiplyGemmKernel.h
+         */
+        class TraceZone {
+        public:
+            explicit TraceZone(const char* name);
+            ~TraceZone();
+
+            TraceZone(const TraceZone&) = delete;
+            TraceZone& operator=(const TraceZone&) = delete;
+
+        private:
+            const char* _name;
+            uint64_t _begin; // 0 while no trace is running
+        };
+
+    } // namespace Util
+} // namespace OptimizationTests
+
+#endif // TRACE_H
@@ -3,17 +3,299 @@ main.cpp its the main
 Evan Newman
 */
 
+#include <array>
+#include <cstdint>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include <eigen3/Eigen/Core> // Eigen stuff
 
+#include "Fft/FftKernels.h"
+#include "Fft/FftTests.h"
+
 #include "MatrixMultiplication/MatrixMultiply.h"
+#include "MatrixMultiplication/MatrixMultiplyAutotune.h"
+#include "MatrixMultiplication/MatrixMultiplyBaseline.h"
+#include "MatrixMultiplication/MatrixMultiplyBenchmark.h"
+#include "MatrixMultiplication/MatrixMultiplyKernels.h"
+#include "MatrixMultiplication/MatrixMultiplyVerify.h"
+
+#include "Util/CpuInfo.h"
+#include "Util/Trace.h"
 
 using namespace OptimizationTests;
 
+// the exit code of a benchmark that ran fine but got slower than its baseline
+static constexpr int regression_exit_code = 2;
+
+// the exit code of a benchmark where a kernel computed a wrong result
+static constexpr int verification_exit_code = 3;
+
+static void PrintUsage(const char* program) {
+    std::cout << "usage: " << program << " [--isa name] [--tuning-file path] [--trace path] [--autotune [shapes ...]]" << std::endl
+              << "       " << program << " --fft [--wisdom-file path]" << std::endl
+              << "       " << program << " --bench [--shapes shapes] [--kernels names] [--warmup n] [--iterations n]" << std::endl
+              << "       " << std::string(std::string(program).size(), ' ') << " [--counters] [--roofline] [--verify freivalds|reference]" << std::endl
+              << "       " << std::string(std::string(program).size(), ' ') << " [--format text|csv|json] [--output path] [--save-baseline path]" << std::endl
+              << "       " << std::string(std::string(program).size(), ' ') << " [--baseline path [--alpha p] [--threshold fraction]]" << std::endl
+              << "  --isa name          run the kernels built for generic, sse4.2, avx2 or avx512 instead of" << std::endl
+              << "                      the newest one this processor supports" << std::endl
+              << "  --tuning-file path  the block size tuning file to load and save (default "
+              << MatrixMultiply::default_tuning_file << ")" << std::endl
+              << "  --trace path        record where the time goes inside the kernels of the tests or the benchmark" << std::endl
+              << "                      and write it as a chrome trace, needs -DOPTIMIZATION_TESTS_TRACE=ON" << std::endl
+              << "  --fft               only run the fft tests, timed against fftw when it was found at build time" << std::endl
+              << "  --wisdom-file path  the fftw wisdom file to load and save (default "
+              << Fft::default_wisdom_file << ")" << std::endl
+              << "  --autotune          time every candidate block size on the given shapes" << std::endl
+              << "                      (default 750x750x750) and save the fastest to the tuning file" << std::endl
+              << "  --bench             time the kernels on a sweep of shapes instead of running the tests" << std::endl
+              << "  --shapes shapes     mxnxk shapes separated by commas, each dimension a number or a range" << std::endl
+              << "                      first:last:step, or first:last:*step to multiply (default 750x750x750)" << std::endl
+              << "  --kernels names     the kernels to time separated by commas, see --list-kernels" << std::endl
+              << "  --list-kernels      print the kernel names, * marks the ones timed by default" << std::endl
+              << "  --warmup n          untimed runs before timing (default 3)" << std::endl
+              << "  --iterations n      timed runs, the percentiles are over these (default 20)" << std::endl
+              << "  --counters          also read the hardware performance counters around every timed run" << std::endl
+              << "                      and report ipc and cache and tlb misses per flop, where available" << std::endl
+              << "  --roofline          measure the peak flop rate and memory bandwidth first and report how close" << std::endl
+              << "                      every result gets to what its arithmetic intensity allows" << std::endl
+              << "  --verify mode       check every result with freivalds, a few O(n^2) products with random" << std::endl
+              << "                      vectors, or against eigen's full product with reference (default freivalds)." << std::endl
+              << "                      exits with " << verification_exit_code << " if any result is wrong" << std::endl
+              << "  --format format     text, csv or json (default text)" << std::endl
+              << "  --output path       also write the results to a file" << std::endl
+              << "  --save-baseline path" << std::endl
+              << "                      save every sample to a baseline file to compare later runs against" << std::endl
+              << "  --baseline path     compare the results with a baseline file and exit with "
+              << regression_exit_code << " if any got slower" << std::endl
+              << "  --alpha p           the p value a change has to beat (default 0.01)" << std::endl
+              << "  --threshold fraction" << std::endl
+              << "                      the smallest change of the median that counts (default 0.05)" << std::endl;
+}
+
+/** parses a count of at least minimum
+ */
+static bool ParseCount(const std::string& text, int minimum, int& count) {
+    std::istringstream stream(text);
+    stream >> count;
+    return !stream.fail() && stream.eof() && count >= minimum;
+}
+
+/** parses a number in [minimum, maximum)
+ */
+static bool ParseFraction(const std::string& text, double minimum, double maximum, double& value) {
+    std::istringstream stream(text);
+    stream >> value;
+    return !stream.fail() && stream.eof() && value >= minimum && value < maximum;
+}
+
+/** splits a comma separated list
+ */
+static std::vector<std::string> SplitList(const std::string& text) {
+    std::vector<std::string> items;
+    std::istringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
 int main(int argc, char** argv) {
 
-    MatrixMultiply::RunMatrixMultiplyTests();
+    std::string tuning_file = MatrixMultiply::default_tuning_file;
+    std::string wisdom_file = Fft::default_wisdom_file;
+    bool fft_only = false;
+    std::string trace_file;
+    bool autotune = false;
+    std::vector<std::array<uint64_t, 3>> autotune_shapes;
+
+    bool bench = false;
+    MatrixMultiply::BenchmarkOptions bench_options;
+    std::string bench_output;
+    std::string save_baseline;
+    std::string baseline;
+    MatrixMultiply::BaselineOptions baseline_options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        Util::Isa isa;
+
+        if (arg == "--tuning-file" && has_value) {
+            tuning_file = argv[++i];
+        } else if (arg == "--wisdom-file" && has_value) {
+            wisdom_file = argv[++i];
+        } else if (arg == "--fft") {
+            fft_only = true;
+        } else if (arg == "--trace" && has_value) {
+            trace_file = argv[++i];
+        } else if (arg == "--isa" && has_value && Util::ParseIsa(argv[i + 1], isa)) {
+            i++;
+            if (!MatrixMultiply::SelectKernels(isa)) {
+                std::cout << "this processor doesn't support " << Util::IsaName(isa) << std::endl;
+                return 1;
+            }
+
+            // the fft has the same four butterfly builds, so it follows the matrix multiply kernels
+            Fft::SelectKernels(isa);
+        } else if (arg == "--autotune") {
+            autotune = true;
+        } else if (autotune && MatrixMultiply::ParseShapes(arg, autotune_shapes)) {
+            // the shapes were added
+        } else if (arg == "--bench") {
+            bench = true;
+        } else if (arg == "--shapes" && has_value && MatrixMultiply::ParseShapes(argv[i + 1], bench_options.shapes)) {
+            i++;
+        } else if (arg == "--kernels" && has_value) {
+            bench_options.kernels = SplitList(argv[++i]);
+        } else if (arg == "--warmup" && has_value && ParseCount(argv[i + 1], 0, bench_options.warmup)) {
+            i++;
+        } else if (arg == "--iterations" && has_value && ParseCount(argv[i + 1], 1, bench_options.iterations)) {
+            i++;
+        } else if (arg == "--format" && has_value && MatrixMultiply::ParseBenchmarkFormat(argv[i + 1], bench_options.format)) {
+            i++;
+        } else if (arg == "--counters") {
+            bench_options.counters = true;
+        } else if (arg == "--roofline") {
+            bench_options.roofline = true;
+        } else if (arg == "--verify" && has_value && MatrixMultiply::ParseVerifyMode(argv[i + 1], bench_options.verify)) {
+            i++;
+        } else if (arg == "--output" && has_value) {
+            bench_output = argv[++i];
+        } else if (arg == "--save-baseline" && has_value) {
+            save_baseline = argv[++i];
+        } else if (arg == "--baseline" && has_value) {
+            baseline = argv[++i];
+        } else if (arg == "--alpha" && has_value && ParseFraction(argv[i + 1], 0.0, 1.0, baseline_options.alpha)) {
+            i++;
+        } else if (arg == "--threshold" && has_value && ParseFraction(argv[i + 1], 0.0, 1.0, baseline_options.threshold)) {
+            i++;
+        } else if (arg == "--list-kernels") {
+            for (const MatrixMultiply::BenchmarkKernel& kernel : MatrixMultiply::BenchmarkKernels()) {
+                std::cout << kernel.name << (kernel.by_default ? " *" : "") << std::endl;
+            }
+            return 0;
+        } else {
+            PrintUsage(argv[0]);
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+    }
+
+    // tuned block sizes from earlier runs, a missing file just means the defaults are used
+    try {
+        MatrixMultiply::TuningCache::Instance().Load(tuning_file);
+    } catch (const std::runtime_error& error) {
+        std::cout << error.what() << std::endl;
+        return 1;
+    }
+
+    if (!trace_file.empty() && !Util::trace_compiled_in) {
+        std::cout << "this build has no tracing zones, configure it with -DOPTIMIZATION_TESTS_TRACE=ON" << std::endl;
+        return 1;
+    }
+
+    // the trace is written however the run ends, as long as it gets to the end
+    auto WriteTrace = [&trace_file]() {
+        if (trace_file.empty()) return true;
+
+        Util::StopTrace();
+
+        std::ofstream trace(trace_file);
+        size_t zones = Util::WriteChromeTrace(trace);
+
+        if (!trace) {
+            std::cout << "couldn't write " << trace_file << std::endl;
+            return false;
+        }
+
+        std::cout << "wrote " << zones << " zones to " << trace_file << std::endl;
+        return true;
+    };
+
+    if (autotune) {
+        if (autotune_shapes.empty()) autotune_shapes.push_back({750, 750, 750});
+
+        MatrixMultiply::Autotune(autotune_shapes, 5);
+        MatrixMultiply::TuningCache::Instance().Save(tuning_file);
+
+        std::cout << "saved tuning to " << tuning_file << std::endl;
+        return 0;
+    }
+
+    if (bench) {
+        if (bench_options.shapes.empty()) bench_options.shapes.push_back({750, 750, 750});
+
+        // read first, a baseline that can't be compared shouldn't cost a whole benchmark run
+        std::vector<MatrixMultiply::BaselineEntry> baseline_entries;
+        try {
+            if (!baseline.empty()) baseline_entries = MatrixMultiply::LoadBaseline(baseline);
+        } catch (const std::runtime_error& error) {
+            std::cout << error.what() << std::endl;
+            return 1;
+        }
+
+        MatrixMultiply::BenchmarkReport report;
+        try {
+            if (!trace_file.empty()) Util::StartTrace();
+            report = MatrixMultiply::RunBenchmark(bench_options, &std::cout);
+        } catch (const std::invalid_argument& error) {
+            std::cout << error.what() << std::endl;
+            return 1;
+        }
+
+        if (!WriteTrace()) return 1;
+
+        if (!bench_output.empty()) {
+            std::ofstream output(bench_output);
+            MatrixMultiply::WriteBenchmarkReport(report, bench_options.format, output);
+
+            if (!output) {
+                std::cout << "couldn't write " << bench_output << std::endl;
+                return 1;
+            }
+        }
+
+        if (!save_baseline.empty()) {
+            try {
+                MatrixMultiply::SaveBaseline(report, save_baseline);
+            } catch (const std::runtime_error& error) {
+                std::cout << error.what() << std::endl;
+                return 1;
+            }
+        }
+
+        std::vector<MatrixMultiply::BaselineComparison> comparisons;
+        if (!baseline.empty()) {
+            comparisons = MatrixMultiply::CompareToBaseline(report, baseline_entries, baseline_options);
+            MatrixMultiply::WriteBaselineComparison(comparisons, std::cout);
+        }
+
+        // a wrong result outranks a slow one, the outputs above are still written so it can be looked at
+        for (const MatrixMultiply::BenchmarkResult& result : report.results) {
+            if (!result.ok) {
+                std::cout << result.kernel << " computed a wrong result for " << result.m << "x" << result.n << "x" << result.k << std::endl;
+                return verification_exit_code;
+            }
+        }
+
+        for (const MatrixMultiply::BaselineComparison& comparison : comparisons) {
+            if (comparison.verdict == MatrixMultiply::BaselineVerdict::Slower) return regression_exit_code;
+        }
+
+        return 0;
+    }
+
+    if (!trace_file.empty()) Util::StartTrace();
+    if (!fft_only) MatrixMultiply::RunMatrixMultiplyTests();
+    Fft::RunFftTests(wisdom_file);
+    if (!WriteTrace()) return 1;
 
     // uint64_t dim = 6;
 
@@ -34,4 +316,4 @@ int main(int argc, char** argv) {
     // MatrixMultiply::MatMult6(a, b, c);
 
     return 0;
-}
\ No newline at end of file
+}